@@ -1,8 +1,14 @@
 #include <render/ray.h>
+#include <render/ray_trace_camera.h>
 #include <render/renderer.h>
 #include <volume/gradient_volume.h>
 #include <volume/volume.h>
+#include <atomic>
+#include <glm/common.hpp>
+#include <iterator>
+#include <memory>
 #include <utility>
+#include <vector>
 
 #define provide_member_function_access(func_name)      \
     template <typename... Args>                        \
@@ -58,4 +64,134 @@ public:
 
     provide_member_function_access(bisectionAccuracy)
     provide_member_function_access(computePhongShading)
-};
\ No newline at end of file
+    provide_const_member_function_access(getTF2DOpacity)
+
+    // Makes the next frames evaluate the 2D transfer function directly, without its LUT and without skipping empty bricks.
+    void test_invalidateTF2DTables() { m_tf2DTablesValid = false; }
+    // Opacity of the 2D transfer function LUT, and whether a brick of tf2DBrickSize voxels was classified as empty.
+    float test_tf2DTableOpacity(float val, float gradientMagnitude) const
+    {
+        const glm::ivec2 bin = glm::clamp(glm::ivec2(glm::vec2(val, gradientMagnitude) * m_tf2DBinScale), glm::ivec2(0), glm::ivec2(tf2DTableSize - 1));
+        return m_tf2DOpacityTable[size_t(bin.x + bin.y * tf2DTableSize)];
+    }
+    bool test_isTF2DBrickEmpty(const glm::ivec3& brick) const
+    {
+        return m_tf2DBrickEmpty[size_t(brick.x) + size_t(m_tf2DNumBricks.x) * (size_t(brick.y) + size_t(m_tf2DNumBricks.y) * size_t(brick.z))];
+    }
+    glm::ivec3 test_tf2DNumBricks() const { return m_tf2DNumBricks; }
+    using render::Renderer::tf2DBrickSize;
+};
+
+// Orthographic camera looking along +z at the xy square [0, size]^2, so that every pixel of a square image covers a known
+// column of voxels.
+class TestCamera : public render::RayTraceCamera {
+public:
+    TestCamera(float size)
+        : m_size(size)
+    {
+    }
+
+    glm::vec3 position() const override { return glm::vec3(m_size / 2.0f, m_size / 2.0f, -m_size); }
+    glm::vec3 forward() const override { return glm::vec3(0.0f, 0.0f, 1.0f); }
+
+    render::Ray generateRay(const glm::vec2& pixel) const override
+    {
+        const glm::vec2 xy = (pixel + 1.0f) / 2.0f * m_size;
+        return render::Ray { glm::vec3(xy, -m_size), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 0.0f };
+    }
+    std::optional<glm::vec2> project(const glm::vec3& point) const override { return glm::vec2(point) / m_size * 2.0f - 1.0f; }
+
+    std::unique_ptr<render::RayTraceCamera> clone() const override { return std::make_unique<TestCamera>(*this); }
+
+private:
+    float m_size;
+};
+
+// Traces the pixels of a camera at a fixed offset inside the pixel, the same way as the passes of
+// Renderer::renderRefinementPass() that take more than one sample per pixel.
+class JitteredCamera : public render::RayTraceCamera {
+public:
+    JitteredCamera(const render::RayTraceCamera& camera, const glm::ivec2& resolution, const glm::vec2& jitter)
+        : m_camera(camera)
+        , m_resolution(resolution)
+        , m_jitter(jitter)
+    {
+    }
+
+    glm::vec3 position() const override { return m_camera.position(); }
+    glm::vec3 forward() const override { return m_camera.forward(); }
+
+    render::Ray generateRay(const glm::vec2& pixel) const override
+    {
+        const glm::vec2 xy = glm::round((pixel + 1.0f) / 2.0f * glm::vec2(m_resolution));
+        return m_camera.generateRay((xy + m_jitter) / glm::vec2(m_resolution) * 2.0f - 1.0f);
+    }
+    std::optional<glm::vec2> project(const glm::vec3& point) const override { return m_camera.project(point); }
+
+    std::unique_ptr<render::RayTraceCamera> clone() const override { return std::make_unique<JitteredCamera>(*this); }
+
+private:
+    const render::RayTraceCamera& m_camera;
+    glm::ivec2 m_resolution;
+    glm::vec2 m_jitter;
+};
+
+// Counts the rays that are generated through a camera (from all threads), to measure how many rays a renderer traces.
+class CountingCamera : public render::RayTraceCamera {
+public:
+    CountingCamera(const render::RayTraceCamera& camera)
+        : m_camera(camera)
+    {
+    }
+
+    glm::vec3 position() const override { return m_camera.position(); }
+    glm::vec3 forward() const override { return m_camera.forward(); }
+
+    render::Ray generateRay(const glm::vec2& pixel) const override
+    {
+        m_numRays++;
+        return m_camera.generateRay(pixel);
+    }
+    std::optional<glm::vec2> project(const glm::vec3& point) const override { return m_camera.project(point); }
+
+    // The copy counts its rays separately.
+    std::unique_ptr<render::RayTraceCamera> clone() const override { return std::make_unique<CountingCamera>(m_camera); }
+
+    size_t numRays() const { return m_numRays; }
+
+private:
+    const render::RayTraceCamera& m_camera;
+    mutable std::atomic<size_t> m_numRays { 0 };
+};
+
+// A volume of dim voxels with pseudo random values, seen through a TestCamera that covers it, and a MIP frame of 20x20
+// pixels rendered from it. The tests of the different ways to render a frame compare against this reference.
+struct RenderTestFixture {
+    explicit RenderTestFixture(const glm::ivec3& volumeDim = glm::ivec3(8))
+        : dim(volumeDim)
+        , volume(pseudoRandomData(volumeDim), volumeDim)
+        , gradient(volume)
+        , camera(float(volumeDim.x - 1))
+    {
+        config.renderMode = render::RenderMode::RenderMIP;
+        config.renderResolution = glm::ivec2(20, 20);
+        render::Renderer renderer { &volume, &gradient, &camera, config };
+        if (renderer.render())
+            reference.assign(std::begin(renderer.frameBuffer()), std::end(renderer.frameBuffer()));
+    }
+
+    static std::vector<float> pseudoRandomData(const glm::ivec3& volumeDim)
+    {
+        std::vector<float> data(volume::voxelCount(volumeDim));
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = float((i * 7919) % 256);
+        return data;
+    }
+
+    const glm::ivec3 dim;
+    volume::Volume volume;
+    volume::GradientVolume gradient;
+    const TestCamera camera;
+    render::RenderConfig config;
+    std::vector<glm::vec4> reference;
+};
@@ -1,9 +1,29 @@
 // Can access the header files from the viewer...
 #include "test_classes.h"
+#include "render/ambient_occlusion.h"
+#include "render/async_renderer.h"
+#include "render/illumination_cache.h"
+#include "render/quality_controller.h"
 #include "ui/window.h"
+#include "util/aligned_allocator.h"
+#include "util/task_graph.h"
+#include "volume/compressed_volume.h"
+#include "volume/joint_histogram.h"
+#include "volume/lazy_gradient_volume.h"
+#include "volume/quantized_volume.h"
 #include <algorithm>
+#include <atomic>
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/vector_relational.hpp>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
 
 /*
 GradientVolume:
@@ -46,3 +66,1080 @@ TEST_CASE("Gradient Volume Tests")
     const TestGradientVolume gradient { volume };
     REQUIRE_NOTHROW(gradient.test_getGradientLinearInterpolate(glm::vec3(100.f)));
 }
+
+TEST_CASE("Packed Gradient Volume Tests")
+{
+    // Linear ramp with a constant gradient of (1, 2, 3) in the interior of the volume.
+    const glm::ivec3 dim { 8, 8, 8 };
+    std::vector<float> data;
+    for (int z = 0; z < dim.z; z++)
+        for (int y = 0; y < dim.y; y++)
+            for (int x = 0; x < dim.x; x++)
+                data.push_back(float(x + 2 * y + 3 * z));
+    const volume::Volume volume { std::move(data), dim };
+    const TestGradientVolume gradient { volume };
+
+    REQUIRE(gradient.sizeInBytes() == size_t(dim.x * dim.y * dim.z) * sizeof(volume::PackedGradientVoxel));
+
+    const glm::vec3 expected { 1.0f, 2.0f, 3.0f };
+    const volume::GradientVoxel voxel = gradient.getGradient(4, 4, 4);
+    REQUIRE(voxel.magnitude == Approx(glm::length(expected)).epsilon(1e-4));
+    REQUIRE(glm::distance(voxel.dir, expected) < 1e-3f);
+
+    const volume::GradientVoxel interpolated = gradient.test_getGradientLinearInterpolate(glm::vec3(3.5f, 4.25f, 2.75f));
+    REQUIRE(interpolated.magnitude == Approx(glm::length(expected)).epsilon(1e-4));
+    REQUIRE(glm::distance(interpolated.dir, expected) < 1e-3f);
+}
+
+TEST_CASE("Gradient Volume Boundary Tests")
+{
+    // The second volume is only one voxel thick in z, which has no differences along that axis.
+    for (const glm::ivec3& dim : { glm::ivec3(9, 7, 6), glm::ivec3(5, 4, 1) }) {
+        std::vector<float> data(volume::voxelCount(dim));
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = float((i * 7919) % 256);
+        const volume::Volume volume { data, dim };
+        const volume::GradientVolume gradient { volume };
+
+        // Interior voxels keep the central differences that used to be computed; voxels on the faces, edges and corners
+        // (which used to be zero) use one-sided differences along the axes where a neighbour is missing.
+        const auto difference = [&](glm::ivec3 p, int axis) {
+            glm::ivec3 lower = p, upper = p;
+            lower[axis] = std::max(p[axis] - 1, 0);
+            upper[axis] = std::min(p[axis] + 1, dim[axis] - 1);
+            if (upper[axis] == lower[axis])
+                return 0.0f;
+            return (volume.getVoxel(upper.x, upper.y, upper.z) - volume.getVoxel(lower.x, lower.y, lower.z)) / float(upper[axis] - lower[axis]);
+        };
+        for (int z = 0; z < dim.z; z++) {
+            for (int y = 0; y < dim.y; y++) {
+                for (int x = 0; x < dim.x; x++) {
+                    const glm::ivec3 p { x, y, z };
+                    const glm::vec3 expected { difference(p, 0), difference(p, 1), difference(p, 2) };
+                    if (glm::all(glm::greaterThan(p, glm::ivec3(0))) && glm::all(glm::lessThan(p, dim - 1))) {
+                        const glm::vec3 centralDifferences {
+                            (volume.getVoxel(x + 1, y, z) - volume.getVoxel(x - 1, y, z)) / 2.0f,
+                            (volume.getVoxel(x, y + 1, z) - volume.getVoxel(x, y - 1, z)) / 2.0f,
+                            (volume.getVoxel(x, y, z + 1) - volume.getVoxel(x, y, z - 1)) / 2.0f
+                        };
+                        REQUIRE(expected == centralDifferences);
+                    }
+                    const volume::GradientVoxel voxel = gradient.getGradient(x, y, z);
+                    REQUIRE(voxel.magnitude == Approx(glm::length(expected)).margin(1e-3f * gradient.maxMagnitude()));
+                    REQUIRE(glm::distance(voxel.dir, expected) < 1e-3f * gradient.maxMagnitude());
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Lazy Gradient Volume Tests")
+{
+    const glm::ivec3 dim { 20, 18, 17 };
+    std::vector<float> data;
+    for (int z = 0; z < dim.z; z++)
+        for (int y = 0; y < dim.y; y++)
+            for (int x = 0; x < dim.x; x++)
+                data.push_back(float((x * 7 + y * 13 + z * 29) % 31));
+    const volume::Volume volume { std::move(data), dim };
+    volume::GradientVolume gradient { volume };
+    // Room for a single brick per shard, so bricks get evicted while sampling.
+    volume::LazyGradientVolume lazyGradient { volume, 1 };
+    REQUIRE(lazyGradient.numCachedBricks() == 0);
+    REQUIRE(lazyGradient.maxMagnitude() == Approx(gradient.maxMagnitude()));
+
+    for (const auto interpolationMode : { volume::InterpolationMode::NearestNeighbour, volume::InterpolationMode::Linear }) {
+        gradient.interpolationMode = interpolationMode;
+        lazyGradient.interpolationMode = interpolationMode;
+        for (const glm::vec3& coord : { glm::vec3(0.0f), glm::vec3(3.3f, 17.0f, 16.0f), glm::vec3(15.5f, 16.2f, 8.7f), glm::vec3(19.0f, 1.5f, 2.9f) }) {
+            const volume::GradientVoxel expected = gradient.getGradientInterpolate(coord);
+            const volume::GradientVoxel actual = lazyGradient.getGradientInterpolate(coord);
+            REQUIRE(actual.magnitude == Approx(expected.magnitude).margin(1e-3));
+            REQUIRE(glm::distance(actual.dir, expected.dir) < 1e-3f);
+        }
+    }
+    REQUIRE(lazyGradient.numCachedBricks() > 0);
+}
+
+TEST_CASE("Task Graph Tests")
+{
+    using Thread = util::TaskGraph::Thread;
+    util::TaskGraph graph { 2 };
+    std::atomic<int> counter { 0 };
+    int loadOrder = -1, mainThreadOrder = -1;
+    bool ranAfterError = false;
+
+    const auto load = graph.addTask("load", Thread::Worker, {}, [&]() { loadOrder = counter++; });
+    const auto a = graph.addTask("a", Thread::Worker, { load }, [&]() { counter++; });
+    const auto b = graph.addTask("b", Thread::Worker, { load }, [&]() { counter++; });
+    const auto mainThread = graph.addTask("main", Thread::Main, { a, b }, [&]() { mainThreadOrder = counter++; });
+    const auto failing = graph.addTask("failing", Thread::Worker, { load }, []() { throw std::runtime_error("failed"); });
+    const auto dependent = graph.addTask("dependent", Thread::Main, { failing }, [&]() { ranAfterError = true; });
+    graph.start();
+
+    REQUIRE_THROWS_AS(graph.wait(), std::runtime_error);
+    REQUIRE(graph.isFinished());
+    REQUIRE(loadOrder == 0);
+    REQUIRE(mainThreadOrder == 3);
+    REQUIRE(graph.isFinished(mainThread));
+    REQUIRE_FALSE(graph.isFinished(dependent));
+    REQUIRE_FALSE(ranAfterError);
+}
+
+TEST_CASE("Aligned Allocator Tests")
+{
+    util::AlignedVector<glm::vec4> small(3);
+    util::parallelFill<glm::vec4>(small, glm::vec4(1.0f));
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+    REQUIRE(reinterpret_cast<uintptr_t>(small.data()) % util::AlignedAllocator<glm::vec4>::cacheLineSize == 0);
+#endif
+    REQUIRE(small[2] == glm::vec4(1.0f));
+
+    // Spans several fill blocks and ends in a partial one.
+    util::AlignedVector<float> large(util::AlignedAllocator<float>::hugePageSize + 3);
+    util::parallelFill<float>(large, 2.0f);
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+    REQUIRE(reinterpret_cast<uintptr_t>(large.data()) % util::AlignedAllocator<float>::hugePageSize == 0);
+#endif
+    REQUIRE(std::all_of(std::begin(large), std::end(large), [](float v) { return v == 2.0f; }));
+
+    const std::vector<float> data { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const volume::Volume volume { data, glm::ivec3(2) };
+    const auto view = volume.getDataView();
+    REQUIRE(std::equal(std::begin(view), std::end(view), std::begin(data), std::end(data)));
+    REQUIRE(volume.getVoxel(1, 1, 1) == 8.0f);
+}
+
+TEST_CASE("Compressed Volume Tests")
+{
+    // Bricks with a small value range, an empty region, a non integer voxel (stored as raw floats) and a size that is
+    // not a multiple of the brick size.
+    const glm::ivec3 dim { 37, 20, 19 };
+    std::vector<float> data(volume::voxelCount(dim), 0.0f);
+    for (int z = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 10; x < dim.x; x++)
+                data[volume::voxelIndex(dim, x, y, z)] = float(1000 + (x * 7 + y * 3 + z) % 100);
+        }
+    }
+    data[volume::voxelIndex(dim, 0, 0, 0)] = 65535.0f;
+    data[volume::voxelIndex(dim, 36, 19, 18)] = 0.25f;
+    const volume::Volume volume { data, dim };
+
+    volume::CompressedVolume compressed { volume };
+    REQUIRE(compressed.dims() == dim);
+    REQUIRE(compressed.maximum() == volume.maximum());
+    REQUIRE(compressed.decompress() == data);
+    REQUIRE(compressed.sizeInBytes() < data.size() * sizeof(float) / 2);
+    for (int z = dim.z - 1; z >= 0; z--) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++)
+                REQUIRE(compressed.getVoxel(x, y, z) == data[volume::voxelIndex(dim, x, y, z)]);
+        }
+    }
+
+    compressed.interpolationMode = volume::InterpolationMode::Linear;
+    const glm::vec3 coord { 15.5f, 7.25f, 8.0f };
+    const float expected = glm::mix(
+        glm::mix(volume.getVoxel(15, 7, 8), volume.getVoxel(16, 7, 8), 0.5f),
+        glm::mix(volume.getVoxel(15, 8, 8), volume.getVoxel(16, 8, 8), 0.5f), 0.25f);
+    REQUIRE(compressed.getSampleInterpolate(coord) == Approx(expected));
+    REQUIRE(compressed.getSampleInterpolate(glm::vec3(-1.0f)) == 0.0f);
+
+    // The renderer samples the compressed volume through the same interface as the volume, which gives the same image.
+    compressed.interpolationMode = volume.interpolationMode;
+    const volume::GradientVolume gradient { volume };
+    const TestCamera camera { float(dim.x - 1) };
+    render::RenderConfig config {};
+    config.renderMode = render::RenderMode::RenderMIP;
+    config.renderResolution = glm::ivec2(16, 16);
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+    REQUIRE(renderer.render());
+    render::Renderer compressedRenderer { &compressed, &gradient, &camera, config };
+    REQUIRE(compressedRenderer.render());
+    const auto frameBuffer = compressedRenderer.frameBuffer();
+    REQUIRE(std::equal(std::begin(frameBuffer), std::end(frameBuffer), std::begin(renderer.frameBuffer()), std::end(renderer.frameBuffer())));
+}
+
+TEST_CASE("Quantized Volume Tests")
+{
+    const glm::ivec3 dim { 13, 6, 9 };
+    std::vector<float> data(volume::voxelCount(dim));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = float((i * 7919) % 4096);
+    const volume::Volume volume { data, dim };
+
+    volume::QuantizedVolume quantized { volume };
+    REQUIRE(quantized.sizeInBytes() < data.size() * sizeof(float) / 3);
+
+    // The error of a voxel is bounded by the value range of its block (plus the quantization of the range itself).
+    const std::vector<float> decompressed = quantized.decompress();
+    for (int z = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++) {
+                const glm::ivec3 blockStart = glm::ivec3(x, y, z) / 4 * 4;
+                const glm::ivec3 blockEnd = glm::min(blockStart + 4, dim);
+                float blockMin = volume.maximum(), blockMax = 0.0f;
+                for (int bz = blockStart.z; bz < blockEnd.z; bz++) {
+                    for (int by = blockStart.y; by < blockEnd.y; by++) {
+                        for (int bx = blockStart.x; bx < blockEnd.x; bx++) {
+                            blockMin = std::min(blockMin, volume.getVoxel(bx, by, bz));
+                            blockMax = std::max(blockMax, volume.getVoxel(bx, by, bz));
+                        }
+                    }
+                }
+                const float value = quantized.getVoxel(x, y, z);
+                REQUIRE(value == decompressed[volume::voxelIndex(dim, x, y, z)]);
+                REQUIRE(std::abs(value - volume.getVoxel(x, y, z)) <= (blockMax - blockMin) / 30.0f + volume.maximum() / 30000.0f);
+            }
+        }
+    }
+
+    // Interpolation works on the decoded voxels.
+    quantized.interpolationMode = volume::InterpolationMode::Linear;
+    REQUIRE(quantized.getSampleInterpolate(glm::vec3(4.5f, 2.0f, 3.0f)) == Approx((quantized.getVoxel(4, 2, 3) + quantized.getVoxel(5, 2, 3)) / 2.0f));
+
+    // A constant volume is stored exactly.
+    const volume::Volume constant { std::vector<float>(volume::voxelCount(dim), 7.0f), dim };
+    REQUIRE(volume::QuantizedVolume(constant).getVoxel(12, 5, 8) == 7.0f);
+
+    // The 8 bit texture covers the value range of the volume, also when its minimum is not 0.
+    std::vector<float> shiftedData = data;
+    for (float& value : shiftedData)
+        value += 1000.0f;
+    const std::vector<uint8_t> textureData = volume::QuantizedVolume(volume::Volume { shiftedData, dim }).normalizedTextureData();
+    REQUIRE(*std::min_element(std::begin(textureData), std::end(textureData)) == 0);
+    REQUIRE(*std::max_element(std::begin(textureData), std::end(textureData)) == 255);
+
+    // The renderer samples the decoded voxels.
+    const volume::Volume decompressedVolume { decompressed, dim };
+    const volume::GradientVolume gradient { volume };
+    const TestCamera camera { float(dim.x - 1) };
+    render::RenderConfig config {};
+    config.renderMode = render::RenderMode::RenderMIP;
+    config.renderResolution = glm::ivec2(16, 16);
+    render::Renderer renderer { &decompressedVolume, &gradient, &camera, config };
+    REQUIRE(renderer.render());
+    quantized.interpolationMode = decompressedVolume.interpolationMode;
+    render::Renderer quantizedRenderer { &quantized, &gradient, &camera, config };
+    REQUIRE(quantizedRenderer.render());
+    const auto frameBuffer = quantizedRenderer.frameBuffer();
+    REQUIRE(std::equal(std::begin(frameBuffer), std::end(frameBuffer), std::begin(renderer.frameBuffer()), std::end(renderer.frameBuffer())));
+}
+
+TEST_CASE("Subsampled Volume Loading Tests")
+{
+    // Write a small AVS field file with 16 bit voxels.
+    const glm::ivec3 dim { 11, 7, 5 };
+    const std::filesystem::path filePath = std::filesystem::temp_directory_path() / "volvis_subsampled_test.fld";
+    {
+        std::ofstream ofs(filePath, std::ios::binary);
+        ofs << "# AVS\nndim=3\ndim1=" << dim.x << "\ndim2=" << dim.y << "\ndim3=" << dim.z << "\nnspace=3\nveclen=1\ndata=short\nfield=uniform\n\f\f";
+        for (size_t i = 0; i < volume::voxelCount(dim); i++) {
+            const uint16_t value = uint16_t((i * 7919) % 65536);
+            ofs.put(char(value & 0xFF));
+            ofs.put(char(value >> 8));
+        }
+    }
+
+    REQUIRE(volume::Volume::readDims(filePath) == dim);
+    const volume::Volume full { filePath };
+    const volume::Volume subsampled { filePath, 3 };
+    REQUIRE(subsampled.dims() == glm::ivec3(4, 3, 2));
+    for (int z = 0; z < subsampled.dims().z; z++) {
+        for (int y = 0; y < subsampled.dims().y; y++) {
+            for (int x = 0; x < subsampled.dims().x; x++)
+                REQUIRE(subsampled.getVoxel(x, y, z) == full.getVoxel(3 * x, 3 * y, 3 * z));
+        }
+    }
+
+    // A region of interest is clamped to the volume.
+    const volume::VolumeRegion region { glm::ivec3(2, 1, 3), glm::ivec3(9, 100, 5) };
+    const volume::Volume cropped { filePath, region };
+    REQUIRE(cropped.dims() == glm::ivec3(7, 6, 2));
+    for (int z = 0; z < cropped.dims().z; z++) {
+        for (int y = 0; y < cropped.dims().y; y++) {
+            for (int x = 0; x < cropped.dims().x; x++)
+                REQUIRE(cropped.getVoxel(x, y, z) == full.getVoxel(x + 2, y + 1, z + 3));
+        }
+    }
+    REQUIRE(volume::Volume(filePath, region, 2).getVoxel(3, 2, 0) == full.getVoxel(8, 5, 3));
+
+    // Voxels missing from a truncated file are zero.
+    const size_t numStoredVoxels = volume::voxelCount(dim) / 2;
+    std::filesystem::resize_file(filePath, std::filesystem::file_size(filePath) - (volume::voxelCount(dim) - numStoredVoxels) * 2);
+    const volume::Volume truncated { filePath };
+    const volume::Volume truncatedSubsampled { filePath, 3 };
+    REQUIRE(truncated.dims() == dim);
+    const auto view = truncated.getDataView();
+    for (size_t i = 0; i < volume::voxelCount(dim); i++)
+        REQUIRE(view[i] == (i < numStoredVoxels ? full.getDataView()[i] : 0.0f));
+    REQUIRE(truncatedSubsampled.getVoxel(0, 0, 0) == full.getVoxel(0, 0, 0));
+    REQUIRE(truncatedSubsampled.getVoxel(3, 2, 1) == 0.0f);
+    std::filesystem::remove(filePath);
+}
+
+TEST_CASE("Joint Histogram Tests")
+{
+    const glm::ivec3 dim { 20, 18, 17 };
+    std::vector<float> data(volume::voxelCount(dim));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = float((i * 7919) % 256);
+    const volume::Volume volume { data, dim };
+    const volume::GradientVolume gradient { volume };
+
+    // The counts that the threads collect in their own bins add up to the counts of a serial pass over the volume.
+    const glm::ivec2 numBins { 13, 7 };
+    const volume::JointHistogram histogram { volume, gradient, numBins };
+    REQUIRE(histogram.numBins() == numBins);
+    std::vector<int64_t> expected(size_t(numBins.x * numBins.y), 0);
+    for (int z = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++) {
+                const int intensityBin = std::min(int(volume.getVoxel(x, y, z) * float(numBins.x) / volume.maximum()), numBins.x - 1);
+                const int magnitudeBin = std::min(int(gradient.getGradient(x, y, z).magnitude * float(numBins.y) / gradient.maxMagnitude()), numBins.y - 1);
+                expected[size_t(intensityBin + magnitudeBin * numBins.x)]++;
+            }
+        }
+    }
+    int64_t total = 0;
+    for (int magnitudeBin = 0; magnitudeBin < numBins.y; magnitudeBin++) {
+        for (int intensityBin = 0; intensityBin < numBins.x; intensityBin++) {
+            REQUIRE(histogram.count(intensityBin, magnitudeBin) == expected[size_t(intensityBin + magnitudeBin * numBins.x)]);
+            total += histogram.count(intensityBin, magnitudeBin);
+        }
+    }
+    REQUIRE(total == int64_t(volume::voxelCount(dim)));
+    REQUIRE(histogram.maxCount() == *std::max_element(std::begin(expected), std::end(expected)));
+
+    // Empty bins map to 0 and the fullest bin maps to 1.
+    const std::vector<float> logScaled = histogram.logScaled();
+    REQUIRE(logScaled.size() == expected.size());
+    const auto maxBin = std::max_element(std::begin(expected), std::end(expected));
+    REQUIRE(logScaled[size_t(maxBin - std::begin(expected))] == Approx(1.0f));
+    const auto emptyBin = std::find(std::begin(expected), std::end(expected), 0);
+    REQUIRE(emptyBin != std::end(expected));
+    REQUIRE(logScaled[size_t(emptyBin - std::begin(expected))] == 0.0f);
+    for (const float value : logScaled)
+        REQUIRE((value >= 0.0f && value <= 1.0f));
+}
+
+TEST_CASE("Illumination Cache Tests")
+{
+    // A ball whose values fall off smoothly from the center, so that the lighting varies slowly over a grid cell.
+    const glm::ivec3 dim { 32 };
+    std::vector<float> data;
+    for (int z = 0; z < dim.z; z++) {
+        for (int y = 0; y < dim.y; y++) {
+            for (int x = 0; x < dim.x; x++)
+                data.push_back(std::max(255.0f - 16.0f * glm::length(glm::vec3(x, y, z) - 15.5f), 0.0f));
+        }
+    }
+    const volume::Volume volume { data, dim };
+    volume::GradientVolume gradient { volume };
+    gradient.interpolationMode = volume::InterpolationMode::Linear;
+    const TestCamera camera { float(dim.x - 1) };
+
+    render::RenderConfig config {};
+    config.renderMode = render::RenderMode::RenderComposite;
+    config.renderResolution = glm::ivec2(24, 24);
+    config.volumeShading = true;
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 256.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 0.8f, 0.6f, i > 100 ? 0.5f : 0.0f);
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+    REQUIRE(renderer.render());
+
+    // The grid is built in the background after the first frame that asks for it.
+    render::IlluminationCache illuminationCache { &volume, &gradient };
+    config.useIlluminationCache = true;
+    render::Renderer cachedRenderer { &volume, &gradient, &camera, config };
+    cachedRenderer.setIlluminationCache(&illuminationCache);
+    REQUIRE(cachedRenderer.render());
+    while (illuminationCache.generation() == 0)
+        std::this_thread::yield();
+
+    // The cached lighting is close to full Phong shading. Only the peak of the highlight (in the center of the image) is
+    // noticeably dimmer, because the specular term is averaged over the cells of the grid.
+    REQUIRE(cachedRenderer.render());
+    REQUIRE(illuminationCache.generation() == 1);
+    const auto frameBuffer = cachedRenderer.frameBuffer();
+    float errorSum = 0.0f;
+    for (size_t i = 0; i < frameBuffer.size(); i++) {
+        REQUIRE(frameBuffer[i].a == renderer.frameBuffer()[i].a);
+        const float error = glm::length(glm::vec3(frameBuffer[i] - renderer.frameBuffer()[i]));
+        REQUIRE(error < (i == 12 * 24 + 12 ? 0.15f : 0.05f));
+        errorSum += error;
+    }
+    REQUIRE(errorSum / float(frameBuffer.size()) < 0.005f);
+
+    // Changing the opacity of the transfer function rebuilds the grid.
+    config.tfColorMap[150].a = 1.0f;
+    cachedRenderer.setConfig(config);
+    REQUIRE(cachedRenderer.render());
+    while (illuminationCache.generation() == 1)
+        std::this_thread::yield();
+
+    // The voxels of a cell are weighted by their opacity. If only the largest values of the first cell are visible, the
+    // cell is lit as those voxels alone.
+    std::vector<float> noise(volume::voxelCount(dim));
+    for (size_t i = 0; i < noise.size(); i++)
+        noise[i] = float((i * 7919) % 256);
+    const volume::Volume noiseVolume { noise, dim };
+    const volume::GradientVolume noiseGradient { noiseVolume };
+    float maxValue = 0.0f;
+    for (int z = 0; z < 2; z++) {
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++)
+                maxValue = std::max(maxValue, noiseVolume.getVoxel(x, y, z));
+        }
+    }
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i].a = float(i) >= maxValue ? 1.0f : 0.0f;
+    const glm::vec3 L { 1.0f, 0.0f, 0.0f };
+    float expected = 0.0f, numVisible = 0.0f;
+    for (int z = 0; z < 2; z++) {
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++) {
+                const volume::GradientVoxel voxelGradient = noiseGradient.getGradient(x, y, z);
+                if (noiseVolume.getVoxel(x, y, z) == maxValue) {
+                    const float NdotL = std::abs(glm::dot(voxelGradient.dir, L)) / voxelGradient.magnitude;
+                    expected += 0.1f + 0.7f * NdotL + 0.2f * std::pow(std::max(2.0f * NdotL * NdotL - 1.0f, 0.0f), 25.0f);
+                    numVisible += 1.0f;
+                }
+            }
+        }
+    }
+    render::IlluminationCache noiseIlluminationCache { &noiseVolume, &noiseGradient };
+    noiseIlluminationCache.requestUpdate(L, config);
+    while (noiseIlluminationCache.generation() == 0)
+        std::this_thread::yield();
+    REQUIRE(noiseIlluminationCache.snapshot()->getIlluminationInterpolate(glm::vec3(0.5f)) == Approx(expected / numVisible));
+}
+
+TEST_CASE("Ambient Occlusion Tests")
+{
+    const glm::ivec3 dim { 20, 18, 17 };
+    std::vector<float> data(volume::voxelCount(dim));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = float((i * 7919) % 256);
+    const volume::Volume volume { std::move(data), dim };
+
+    render::RenderConfig config {};
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 256.0f;
+    render::AmbientOcclusionVolume ambientOcclusion { &volume };
+    REQUIRE(ambientOcclusion.needsUpdate(config));
+    REQUIRE(ambientOcclusion.update(config));
+    REQUIRE_FALSE(ambientOcclusion.needsUpdate(config));
+    REQUIRE_FALSE(ambientOcclusion.update(config));
+    // Nothing is opaque, so nothing is occluded.
+    REQUIRE(std::all_of(std::begin(ambientOcclusion.data()), std::end(ambientOcclusion.data()), [](float v) { return v == 1.0f; }));
+
+    // An incremental update after editing a part of the transfer function gives the same result as building from scratch.
+    const auto compareWithFullRebuild = [&]() {
+        REQUIRE(ambientOcclusion.update(config));
+        render::AmbientOcclusionVolume rebuilt { &volume };
+        REQUIRE(rebuilt.update(config));
+        REQUIRE(ambientOcclusion.data().size() == rebuilt.data().size());
+        for (size_t i = 0; i < rebuilt.data().size(); i++)
+            REQUIRE(ambientOcclusion.data()[i] == Approx(rebuilt.data()[i]).margin(1e-6));
+    };
+    for (size_t i = 100; i < 120; i++)
+        config.tfColorMap[i].a = 0.8f;
+    compareWithFullRebuild();
+    REQUIRE(std::any_of(std::begin(ambientOcclusion.data()), std::end(ambientOcclusion.data()), [](float v) { return v < 1.0f; }));
+    config.tfColorMap[110].a = 0.0f;
+    config.tfColorMap[250].a = 1.0f;
+    compareWithFullRebuild();
+    // Changing the value range of the transfer function reclassifies everything.
+    config.tfColorMapIndexStart = 50.0f;
+    compareWithFullRebuild();
+
+    // A prepared update only becomes visible once it is applied.
+    const std::vector<float> previous = ambientOcclusion.data();
+    config.tfColorMap[200].a = 1.0f;
+    REQUIRE(ambientOcclusion.prepareUpdate(config));
+    REQUIRE(ambientOcclusion.data() == previous);
+    ambientOcclusion.applyUpdate();
+    REQUIRE(ambientOcclusion.data() != previous);
+    render::AmbientOcclusionVolume rebuilt { &volume };
+    REQUIRE(rebuilt.update(config));
+    for (size_t i = 0; i < rebuilt.data().size(); i++)
+        REQUIRE(ambientOcclusion.data()[i] == Approx(rebuilt.data()[i]).margin(1e-6));
+}
+
+TEST_CASE("2D Transfer Function Tests")
+{
+    // A cone of values around the center of the volume, so that the bricks near the corners only contain small values.
+    const glm::ivec3 dim { 32, 32, 32 };
+    std::vector<float> data;
+    for (int z = 0; z < dim.z; z++)
+        for (int y = 0; y < dim.y; y++)
+            for (int x = 0; x < dim.x; x++)
+                data.push_back(std::max(255.0f - 12.0f * glm::distance(glm::vec3(x, y, z), glm::vec3(15.5f)), 0.0f));
+    volume::Volume volume { std::move(data), dim };
+    volume::GradientVolume gradient { volume };
+    volume.interpolationMode = volume::InterpolationMode::NearestNeighbour;
+    gradient.interpolationMode = volume::InterpolationMode::Linear;
+    const TestCamera camera { float(dim.x - 1) };
+
+    render::RenderConfig config {};
+    config.renderMode = render::RenderMode::RenderTF2D;
+    config.renderResolution = glm::ivec2(24, 24);
+    config.stepSize = 0.5f;
+    config.TF2DIntensity = 200.0f;
+    config.TF2DRadius = 60.0f;
+    config.TF2DColor = glm::vec4(1.0f, 0.5f, 0.25f, 0.6f);
+    TestRenderer renderer { &volume, &gradient, &camera, config };
+    // The tables are built by the first frame.
+    REQUIRE(renderer.render());
+    const std::vector<glm::vec4> image(std::begin(renderer.frameBuffer()), std::end(renderer.frameBuffer()));
+
+    // The LUT stores the opacity at the center of every bin, which is close to the exact opacity (within the value range
+    // of the volume) wherever the widget is wide compared to a bin.
+    for (float magnitude = 0.5f * gradient.maxMagnitude(); magnitude <= gradient.maxMagnitude(); magnitude += 0.25f) {
+        for (float intensity = 0.0f; intensity <= volume.maximum(); intensity += 0.5f)
+            REQUIRE(renderer.test_tf2DTableOpacity(intensity, magnitude) == Approx(renderer.test_getTF2DOpacity(intensity, magnitude)).margin(0.02));
+    }
+
+    // Bricks are only classified as empty if none of their voxels (including the ones shared with the next brick) is visible.
+    const glm::ivec3 numBricks = renderer.test_tf2DNumBricks();
+    int numEmptyBricks = 0;
+    for (int bz = 0; bz < numBricks.z; bz++) {
+        for (int by = 0; by < numBricks.y; by++) {
+            for (int bx = 0; bx < numBricks.x; bx++) {
+                if (!renderer.test_isTF2DBrickEmpty(glm::ivec3(bx, by, bz)))
+                    continue;
+                numEmptyBricks++;
+                const glm::ivec3 begin = glm::ivec3(bx, by, bz) * TestRenderer::tf2DBrickSize;
+                const glm::ivec3 end = glm::min(begin + TestRenderer::tf2DBrickSize + 1, dim);
+                for (int z = begin.z; z < end.z; z++)
+                    for (int y = begin.y; y < end.y; y++)
+                        for (int x = begin.x; x < end.x; x++)
+                            REQUIRE(renderer.test_tf2DTableOpacity(volume.getVoxel(x, y, z), gradient.getGradient(x, y, z).magnitude) == 0.0f);
+            }
+        }
+    }
+    REQUIRE(numEmptyBricks > 0);
+    REQUIRE(numEmptyBricks < numBricks.x * numBricks.y * numBricks.z);
+
+    // Rendering with the LUT and empty space skipping matches evaluating the transfer function at every sample.
+    renderer.test_invalidateTF2DTables();
+    REQUIRE(renderer.render());
+    const std::vector<glm::vec4> bruteForceImage(std::begin(renderer.frameBuffer()), std::end(renderer.frameBuffer()));
+    REQUIRE(std::any_of(std::begin(bruteForceImage), std::end(bruteForceImage), [](const glm::vec4& color) { return color.a > 0.1f; }));
+    for (size_t i = 0; i < image.size(); i++)
+        REQUIRE(glm::distance(image[i], bruteForceImage[i]) < 0.05f);
+}
+
+TEST_CASE("Async Renderer Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    REQUIRE(reference.size() == 400);
+    std::atomic_bool cancel { true };
+    REQUIRE_FALSE(render::Renderer(&volume, &gradient, &camera, config).render(&cancel));
+
+    // The frame rendered on the render thread is the same as a synchronously rendered frame.
+    render::AsyncRenderer asyncRenderer { &volume, &gradient, &camera, config };
+    REQUIRE_FALSE(asyncRenderer.swapFrameBuffers());
+    asyncRenderer.requestFrame();
+    while (asyncRenderer.isBusy())
+        std::this_thread::yield();
+    REQUIRE(asyncRenderer.swapFrameBuffers());
+    REQUIRE(asyncRenderer.frameResolution() == config.renderResolution);
+    const auto frameBuffer = asyncRenderer.frameBuffer();
+    REQUIRE(std::equal(std::begin(frameBuffer), std::end(frameBuffer), std::begin(reference), std::end(reference)));
+    REQUIRE_FALSE(asyncRenderer.swapFrameBuffers());
+
+    // Settings are applied by the render thread.
+    config.renderResolution = glm::ivec2(8, 8);
+    asyncRenderer.setConfig(config);
+    asyncRenderer.setInterpolationMode(volume::InterpolationMode::Linear);
+    asyncRenderer.requestFrame();
+    while (asyncRenderer.isBusy())
+        std::this_thread::yield();
+    REQUIRE(asyncRenderer.swapFrameBuffers());
+    REQUIRE(asyncRenderer.frameBuffer().size() == 64);
+    REQUIRE(asyncRenderer.pause().owns_lock());
+    REQUIRE(volume.interpolationMode == volume::InterpolationMode::Linear);
+}
+
+TEST_CASE("Progressive Refinement Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    config.progressiveRefinement = true;
+    config.progressiveSamples = 4;
+    REQUIRE(render::Renderer::numRefinementPasses(config) == 7);
+
+    // The first pass fills blocks of 8x8 pixels, after the coarse passes every pixel is traced once.
+    render::Renderer refinedRenderer { &volume, &gradient, &camera, config };
+    REQUIRE(refinedRenderer.renderRefinementPass(0));
+    REQUIRE(refinedRenderer.frameBuffer()[21] == reference[0]);
+    REQUIRE(refinedRenderer.frameBuffer()[19] == reference[16]);
+    for (int pass = 1; pass < 4; pass++)
+        REQUIRE(refinedRenderer.renderRefinementPass(pass));
+    REQUIRE(std::equal(std::begin(reference), std::end(reference), std::begin(refinedRenderer.frameBuffer()), std::end(refinedRenderer.frameBuffer())));
+    std::atomic_bool cancel { true };
+    REQUIRE_FALSE(refinedRenderer.renderRefinementPass(4, &cancel));
+
+    // The render thread refines the image until all passes are done.
+    render::AsyncRenderer asyncRenderer { &volume, &gradient, &camera, config };
+    asyncRenderer.requestFrame();
+    while (asyncRenderer.isBusy())
+        std::this_thread::yield();
+    REQUIRE(asyncRenderer.swapFrameBuffers());
+    const auto frameBuffer = asyncRenderer.frameBuffer();
+    REQUIRE(frameBuffer.size() == reference.size());
+    REQUIRE_FALSE(asyncRenderer.swapFrameBuffers());
+
+    // The final frame is the average of the samples at the jittered positions (the Halton sequence in bases 2 and 3).
+    const std::vector<glm::vec2> jitters { glm::vec2(0.0f), glm::vec2(0.5f, 1.0f / 3.0f), glm::vec2(0.25f, 2.0f * (1.0f / 3.0f)), glm::vec2(0.75f, 1.0f / 3.0f / 3.0f) };
+    std::vector<glm::vec4> sum(reference.size(), glm::vec4(0.0f));
+    for (const glm::vec2& jitter : jitters) {
+        const JitteredCamera jitteredCamera { camera, config.renderResolution, jitter };
+        render::Renderer sampleRenderer { &volume, &gradient, &jitteredCamera, config };
+        REQUIRE(sampleRenderer.render());
+        for (size_t i = 0; i < sum.size(); i++)
+            sum[i] += sampleRenderer.frameBuffer()[i];
+    }
+    for (size_t i = 0; i < sum.size(); i++)
+        REQUIRE(glm::length(frameBuffer[i] - sum[i] / float(jitters.size())) < 1e-6f);
+}
+
+TEST_CASE("Adaptive Sampling Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+
+    // Without subdivision only the corners of the 8x8 blocks are traced; they are exact.
+    config.adaptiveSampling = true;
+    config.adaptiveThreshold = 1.0f;
+    render::Renderer adaptiveRenderer { &volume, &gradient, &camera, config };
+    REQUIRE(adaptiveRenderer.render());
+    const auto frameBuffer = adaptiveRenderer.frameBuffer();
+    for (const int index : { 0, 8, 16, 19, 160, 168, 399 })
+        REQUIRE(frameBuffer[size_t(index)] == reference[size_t(index)]);
+
+    // Blocks are subdivided along the edges of the volume and interpolated inside a uniform volume.
+    const volume::Volume uniformVolume { std::vector<float>(volume::voxelCount(dim), 100.0f), dim };
+    const volume::GradientVolume uniformGradient { uniformVolume };
+    config.adaptiveThreshold = 0.01f;
+    const CountingCamera adaptiveCamera { camera };
+    render::Renderer adaptiveUniformRenderer { &uniformVolume, &uniformGradient, &adaptiveCamera, config };
+    REQUIRE(adaptiveUniformRenderer.render());
+    config.adaptiveSampling = false;
+    const CountingCamera uniformCamera { camera };
+    render::Renderer uniformRenderer { &uniformVolume, &uniformGradient, &uniformCamera, config };
+    REQUIRE(uniformRenderer.render());
+    for (size_t i = 0; i < reference.size(); i++)
+        REQUIRE(glm::length(adaptiveUniformRenderer.frameBuffer()[i] - uniformRenderer.frameBuffer()[i]) < 1e-5f);
+
+    // Every pixel is traced without adaptive sampling; with it far fewer rays are traced for the uniform volume.
+    REQUIRE(uniformCamera.numRays() == reference.size());
+    REQUIRE(adaptiveCamera.numRays() * 2 < uniformCamera.numRays());
+}
+
+TEST_CASE("Brick Ordered Tracing Tests")
+{
+    // Large enough for several bricks in every direction.
+    RenderTestFixture fixture { glm::ivec3(72, 70, 80) };
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    config.renderResolution = glm::ivec2(40, 40);
+    config.stepSize = 0.7f;
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 256.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(float(i) / 255.0f, 0.5f, 1.0f - float(i) / 255.0f, i > 128 ? 0.1f : 0.0f);
+
+    for (const auto renderMode : { render::RenderMode::RenderMIP, render::RenderMode::RenderComposite }) {
+        config.renderMode = renderMode;
+        config.brickOrderedTracing = false;
+        render::Renderer renderer { &volume, &gradient, &camera, config };
+        REQUIRE(renderer.render());
+
+        // The samples and the order in which they are combined are the same, so the result is exactly the same.
+        config.brickOrderedTracing = true;
+        render::Renderer brickRenderer { &volume, &gradient, &camera, config };
+        REQUIRE(brickRenderer.render());
+        for (size_t i = 0; i < renderer.frameBuffer().size(); i++)
+            REQUIRE(brickRenderer.frameBuffer()[i] == renderer.frameBuffer()[i]);
+    }
+}
+
+TEST_CASE("Fused Rendering Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    config.stepSize = 0.5f;
+    config.isoValue = 200.0f;
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 256.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(float(i) / 255.0f, 0.5f, 1.0f - float(i) / 255.0f, i > 128 ? 0.3f : 0.0f);
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+    REQUIRE(renderer.fusedFrameBuffer(render::RenderMode::RenderMIP).empty());
+    REQUIRE(renderer.renderFused());
+    REQUIRE(renderer.fusedFrameBuffer(render::RenderMode::RenderSlicer).empty());
+
+    // MIP and compositing give exactly the same images as rendering them separately.
+    for (const auto renderMode : { render::RenderMode::RenderMIP, render::RenderMode::RenderComposite }) {
+        config.renderMode = renderMode;
+        render::Renderer modeRenderer { &volume, &gradient, &camera, config };
+        REQUIRE(modeRenderer.render());
+        const auto fusedFrameBuffer = renderer.fusedFrameBuffer(renderMode);
+        REQUIRE(fusedFrameBuffer.size() == 400);
+        for (size_t i = 0; i < fusedFrameBuffer.size(); i++)
+            REQUIRE(fusedFrameBuffer[i] == modeRenderer.frameBuffer()[i]);
+    }
+
+    // A ray shows the (unshaded) isosurface if and only if its maximum reaches the iso value.
+    const auto mipFrameBuffer = renderer.fusedFrameBuffer(render::RenderMode::RenderMIP);
+    const auto isoFrameBuffer = renderer.fusedFrameBuffer(render::RenderMode::RenderIso);
+    for (size_t i = 0; i < isoFrameBuffer.size(); i++) {
+        if (mipFrameBuffer[i].r * volume.maximum() >= config.isoValue)
+            REQUIRE(isoFrameBuffer[i] == glm::vec4(0.8f, 0.8f, 0.2f, 1.0f));
+        else
+            REQUIRE(isoFrameBuffer[i] == glm::vec4(0.0f));
+    }
+
+    // The fused view of the render thread shows the three images at half the render resolution in a 2x2 grid (the rows
+    // of the frame go from the bottom to the top): MIP and isosurface at the top, compositing at the bottom left.
+    config.fusedView = true;
+    config.renderResolution = glm::ivec2(41, 40);
+    render::AsyncRenderer asyncRenderer { &volume, &gradient, &camera, config };
+    asyncRenderer.requestFrame();
+    while (asyncRenderer.isBusy())
+        std::this_thread::yield();
+    REQUIRE(asyncRenderer.swapFrameBuffers());
+    REQUIRE(asyncRenderer.frameResolution() == glm::ivec2(40, 40));
+    REQUIRE(asyncRenderer.compactFrameBuffer().empty());
+    const auto frameBuffer = asyncRenderer.frameBuffer();
+    const auto compositeFrameBuffer = renderer.fusedFrameBuffer(render::RenderMode::RenderComposite);
+    for (size_t y = 0; y < 20; y++) {
+        for (size_t x = 0; x < 20; x++) {
+            REQUIRE(frameBuffer[(y + 20) * 40 + x] == mipFrameBuffer[y * 20 + x]);
+            REQUIRE(frameBuffer[(y + 20) * 40 + x + 20] == isoFrameBuffer[y * 20 + x]);
+            REQUIRE(frameBuffer[y * 40 + x] == compositeFrameBuffer[y * 20 + x]);
+            REQUIRE(frameBuffer[y * 40 + x + 20] == glm::vec4(0.0f));
+        }
+    }
+}
+
+TEST_CASE("Thick Slab Tests")
+{
+    RenderTestFixture fixture { glm::ivec3(16) };
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    config.renderMode = render::RenderMode::RenderSlab;
+    config.stepSize = 0.5f;
+    config.slabThickness = 4.0f;
+    config.slabOffset = -8.0f;
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+    REQUIRE(renderer.render());
+
+    // Scroll the slab through the volume in small steps (and one large jump), and switch between the projections on the
+    // way. The incrementally updated frames are the same as frames that are rendered from scratch.
+    const std::vector<float> offsets { -7.5f, -6.5f, -6.0f, -4.0f, -3.75f, 3.0f, 3.5f, 2.0f, 2.5f, 7.5f, 9.0f };
+    for (size_t i = 0; i < offsets.size(); i++) {
+        config.slabOffset = offsets[i];
+        config.slabProjection = render::SlabProjection(i % 3);
+        config.slabThickness = i == 5 ? 6.0f : 4.0f;
+        renderer.setConfig(config);
+        REQUIRE(renderer.render());
+
+        render::Renderer referenceRenderer { &volume, &gradient, &camera, config };
+        REQUIRE(referenceRenderer.render());
+        for (size_t j = 0; j < referenceRenderer.frameBuffer().size(); j++)
+            REQUIRE(glm::length(renderer.frameBuffer()[j] - referenceRenderer.frameBuffer()[j]) < 1e-5f);
+    }
+
+    // A slab that contains the whole volume gives the same maximum as MIP (which also makes pixels opaque whose ray only
+    // touches a face of the volume).
+    config.slabOffset = 0.0f;
+    config.slabThickness = 100.0f;
+    config.slabProjection = render::SlabProjection::Maximum;
+    renderer.setConfig(config);
+    REQUIRE(renderer.render());
+    config.renderMode = render::RenderMode::RenderMIP;
+    render::Renderer mipRenderer { &volume, &gradient, &camera, config };
+    REQUIRE(mipRenderer.render());
+    for (size_t j = 0; j < mipRenderer.frameBuffer().size(); j++)
+        REQUIRE(glm::length(glm::vec3(renderer.frameBuffer()[j] - mipRenderer.frameBuffer()[j])) < 1e-5f);
+}
+
+TEST_CASE("Interleaved Rendering Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    config.interleavedRendering = true;
+
+    // Without a previous frame the whole frame is traced. When the camera does not move, the pixels that are not traced
+    // are reprojected onto themselves.
+    for (const int interleaveFactor : { 2, 4 }) {
+        config.interleaveFactor = interleaveFactor;
+        render::Renderer interleavedRenderer { &volume, &gradient, &camera, config };
+        for (int frame = 0; frame < 3; frame++) {
+            REQUIRE(interleavedRenderer.renderInterleaved());
+            const auto frameBuffer = interleavedRenderer.frameBuffer();
+            REQUIRE(std::equal(std::begin(reference), std::end(reference), std::begin(frameBuffer), std::end(frameBuffer)));
+        }
+        std::atomic_bool cancel { true };
+        REQUIRE_FALSE(interleavedRenderer.renderInterleaved(&cancel));
+    }
+
+    // The depth that reprojection uses is recorded while a ray is traced: it is the first sample that contributes.
+    config.renderMode = render::RenderMode::RenderComposite;
+    config.volumeShading = false;
+    config.tfColorMapIndexStart = 0.0f;
+    config.tfColorMapIndexRange = 256.0f;
+    for (size_t i = 0; i < config.tfColorMap.size(); i++)
+        config.tfColorMap[i] = glm::vec4(1.0f, 1.0f, 1.0f, i >= 192 ? 0.5f : 0.0f);
+    TestRenderer renderer { &volume, &gradient, &camera, config };
+    int numHits = 0;
+    for (int y = 0; y < dim.y; y++) {
+        for (int x = 0; x < dim.x; x++) {
+            const render::Ray ray { glm::vec3(float(x), float(y), -1.0f), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, float(dim.z) };
+            float firstHit = -1.0f;
+            if (renderer.test_traceRayComposite(ray, 0.5f, &firstHit).a == 0.0f) {
+                REQUIRE(firstHit == ray.tmin);
+                continue;
+            }
+            numHits++;
+            render::Ray beforeHit = ray, upToHit = ray;
+            beforeHit.tmax = firstHit - 0.25f;
+            upToHit.tmax = firstHit;
+            REQUIRE(renderer.test_traceRayComposite(beforeHit, 0.5f).a == 0.0f);
+            REQUIRE(renderer.test_traceRayComposite(upToHit, 0.5f).a > 0.0f);
+        }
+    }
+    REQUIRE(numHits > 0);
+}
+
+TEST_CASE("Quality Controller Tests")
+{
+    REQUIRE(render::QualityController::settingsForQuality(1.0f).resolutionScale == 1.0f);
+    REQUIRE(render::QualityController::settingsForQuality(1.0f).stepSizeScale == 1.0f);
+    REQUIRE(render::QualityController::settingsForQuality(0.0f).resolutionScale == 0.25f);
+    REQUIRE(render::QualityController::settingsForQuality(0.0f).stepSizeScale == 2.0f);
+
+    // Simulate a renderer whose frames take fullQualityTime times the relative cost of their settings.
+    render::QualityController controller;
+    controller.setFrameBudget(std::chrono::milliseconds(10));
+    const auto renderFrames = [&](double fullQualityTime, int numFrames) {
+        for (int i = 0; i < numFrames; i++) {
+            const render::QualitySettings settings = controller.settings();
+            const double speedup = settings.nearestNeighbour ? 3.0 : 1.0;
+            const double cost = double(render::QualityController::relativeCost(settings.resolutionScale, settings.stepSizeScale));
+            controller.addFrame(std::chrono::duration<double>(fullQualityTime * cost / speedup), settings.resolutionScale, settings.stepSizeScale, settings.nearestNeighbour);
+        }
+    };
+
+    // Frames converge to the budget and the quality stays put.
+    renderFrames(0.04, 20);
+    const render::QualitySettings settings = controller.settings();
+    const float cost = render::QualityController::relativeCost(settings.resolutionScale, settings.stepSizeScale);
+    REQUIRE(0.04 * cost == Approx(0.01).epsilon(0.15));
+    REQUIRE_FALSE(settings.nearestNeighbour);
+    renderFrames(0.04, 5);
+    REQUIRE(controller.settings().quality == settings.quality);
+
+    // Nearest neighbour interpolation is only used when the lowest quality does not fit in the budget.
+    renderFrames(1.0, 30);
+    REQUIRE(controller.settings().nearestNeighbour);
+    renderFrames(0.001, 30);
+    REQUIRE_FALSE(controller.settings().nearestNeighbour);
+    REQUIRE(controller.settings().quality == 1.0f);
+}
+
+TEST_CASE("Poster Rendering Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+
+    // Reads the red channel of a PPM file, from the top row to the bottom row.
+    const auto readPoster = [](const std::filesystem::path& path, const glm::ivec2& resolution) {
+        std::ifstream ifs(path, std::ios::binary);
+        std::string magic;
+        int width, height, maxValue;
+        ifs >> magic >> width >> height >> maxValue;
+        ifs.get();
+        REQUIRE(magic == "P6");
+        REQUIRE(glm::ivec2(width, height) == resolution);
+        std::vector<char> pixels(size_t(width) * size_t(height) * 3);
+        ifs.read(pixels.data(), std::streamsize(pixels.size()));
+        REQUIRE(ifs);
+        std::vector<float> red;
+        for (size_t i = 0; i < pixels.size(); i += 3)
+            red.push_back(float(uint8_t(pixels[i])));
+        return red;
+    };
+
+    // Strips of 8 rows (the last one only has 4), stored from the top row to the bottom row.
+    const std::filesystem::path filePath = std::filesystem::temp_directory_path() / "volvis_poster_test.ppm";
+    config.renderResolution = glm::ivec2(4, 4);
+    render::Renderer posterRenderer { &volume, &gradient, &camera, config };
+    REQUIRE(posterRenderer.renderPoster(glm::ivec2(20, 20), filePath, 8));
+    REQUIRE(posterRenderer.frameBuffer().size() == 16);
+    const std::vector<float> poster = readPoster(filePath, glm::ivec2(20, 20));
+    for (int y = 0; y < 20; y++) {
+        for (int x = 0; x < 20; x++) {
+            const float expected = reference[size_t((19 - y) * 20 + x)].r;
+            REQUIRE(poster[size_t(y * 20 + x)] == Approx(expected * 255.0f).margin(0.5f));
+        }
+    }
+
+    // A poster that is twice as wide as the (square) view keeps the vertical field of view and shows the view in its center
+    // columns, instead of stretching it.
+    REQUIRE(posterRenderer.renderPoster(glm::ivec2(40, 20), filePath, 8));
+    const std::vector<float> widePoster = readPoster(filePath, glm::ivec2(40, 20));
+    for (int y = 0; y < 20; y++) {
+        for (int x = 0; x < 20; x++) {
+            const float expected = reference[size_t((19 - y) * 20 + x)].r;
+            REQUIRE(widePoster[size_t(y * 40 + x + 10)] == Approx(expected * 255.0f).margin(0.5f));
+        }
+    }
+
+    // The progress is the fraction of the rows that were written, and a cancelled poster is reported as not written.
+    std::atomic<float> progress { 0.0f };
+    std::atomic_bool cancel { false };
+    REQUIRE(posterRenderer.renderPoster(glm::ivec2(20, 20), filePath, 8, &cancel, &progress));
+    REQUIRE(progress == 1.0f);
+    cancel = true;
+    progress = 0.0f;
+    REQUIRE_FALSE(posterRenderer.renderPoster(glm::ivec2(20, 20), filePath, 8, &cancel, &progress));
+    REQUIRE(progress == 0.0f);
+    std::filesystem::remove(filePath);
+}
+
+TEST_CASE("Compact Framebuffer Tests")
+{
+    RenderTestFixture fixture;
+    auto& [dim, volume, gradient, camera, config, reference] = fixture;
+    render::Renderer renderer { &volume, &gradient, &camera, config };
+    REQUIRE(renderer.compactFrameBuffer().empty());
+
+    config.compactFrameBuffer = true;
+    config.interleavedRendering = true;
+    renderer.setConfig(config);
+    const auto checkPacked = [&]() {
+        const auto frameBuffer = renderer.frameBuffer();
+        const auto compactFrameBuffer = renderer.compactFrameBuffer();
+        REQUIRE(compactFrameBuffer.size() == frameBuffer.size());
+        for (size_t i = 0; i < frameBuffer.size(); i++) {
+            for (int c = 0; c < 4; c++) {
+                const float value = float((compactFrameBuffer[i] >> (8 * c)) & 0xFF);
+                REQUIRE(value == Approx(glm::clamp(frameBuffer[i][c], 0.0f, 1.0f) * 255.0f).margin(0.5f));
+            }
+        }
+    };
+    REQUIRE(renderer.render());
+    checkPacked();
+    // The second frame reprojects the first one.
+    REQUIRE(renderer.renderInterleaved());
+    checkPacked();
+    REQUIRE(renderer.renderRefinementPass(0));
+    checkPacked();
+
+    // The buffer that is handed out is replaced by one of the render resolution.
+    util::AlignedVector<uint32_t> compactFrameBuffer;
+    renderer.swapCompactFrameBuffer(compactFrameBuffer);
+    REQUIRE(compactFrameBuffer.size() == 400);
+    REQUIRE(renderer.compactFrameBuffer().size() == 400);
+
+    config.compactFrameBuffer = false;
+    renderer.setConfig(config);
+    REQUIRE(renderer.compactFrameBuffer().empty());
+}
+
+TEST_CASE("Large Volume Indexing Tests")
+{
+    // 2048^3 voxels do not fit in an int; the index math has to be done in 64 bits.
+    const glm::ivec3 dim { 2048 };
+    REQUIRE(volume::voxelCount(dim) == size_t(1) << 33);
+    REQUIRE(volume::voxelIndex(dim, 2047, 2047, 2047) == (size_t(1) << 33) - 1);
+    REQUIRE(volume::voxelIndex(dim, 5, 0, 1024) == (size_t(1) << 32) + 5);
+}
+
+// Needs ~25GB of memory, run explicitly with: IntegrityTests "[large]"
+TEST_CASE("Large Volume Tests", "[.][large]")
+{
+    // Just over 2^31 voxels, with a ramp in z so that the gradient is known everywhere.
+    const glm::ivec3 dim { 2048, 1024, 1025 };
+    std::vector<float> data(volume::voxelCount(dim));
+    for (int z = 0; z < dim.z; z++)
+        std::fill_n(std::begin(data) + volume::voxelIndex(dim, 0, 0, z), size_t(dim.x) * size_t(dim.y), float(z));
+    const volume::Volume volume { std::move(data), dim };
+
+    REQUIRE(volume.getVoxel(2047, 1023, 1024) == 1024.0f);
+    REQUIRE(volume.maximum() == 1024.0f);
+    REQUIRE(volume.histogram()[1024] == int64_t(dim.x) * int64_t(dim.y));
+
+    const volume::GradientVolume gradient { volume };
+    const volume::GradientVoxel voxel = gradient.getGradient(2047, 1023, 1023);
+    REQUIRE(voxel.magnitude == Approx(1.0f).epsilon(1e-3));
+    REQUIRE(voxel.dir.z == Approx(1.0f).epsilon(1e-3));
+}
+
+// Memory use and sampling speed of the packed gradients compared to unpacked ones, run explicitly with: IntegrityTests "[benchmark]"
+TEST_CASE("Packed Gradient Benchmark", "[.][benchmark]")
+{
+    const glm::ivec3 dim { 256 };
+    std::vector<float> data(volume::voxelCount(dim));
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = float((i * 7919) % 256);
+    const volume::Volume volume { std::move(data), dim };
+    volume::GradientVolume gradient { volume };
+    volume::LazyGradientVolume lazyGradient { volume };
+    gradient.interpolationMode = volume::InterpolationMode::Linear;
+    lazyGradient.interpolationMode = volume::InterpolationMode::Linear;
+
+    // Unpacked reference with the same trilinear interpolation as GradientVolume.
+    std::vector<volume::GradientVoxel> unpacked(volume::voxelCount(dim));
+    for (int z = 0; z < dim.z; z++)
+        for (int y = 0; y < dim.y; y++)
+            for (int x = 0; x < dim.x; x++)
+                unpacked[volume::voxelIndex(dim, x, y, z)] = gradient.getGradient(x, y, z);
+    const auto sampleUnpacked = [&](const glm::vec3& coord) {
+        const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(coord), dim - 2), glm::ivec3(0));
+        const glm::vec3 f = coord - glm::vec3(p0);
+        const auto voxel = [&](int dx, int dy, int dz) { return unpacked[volume::voxelIndex(dim, p0.x + dx, p0.y + dy, p0.z + dz)]; };
+        const auto mix = [](const volume::GradientVoxel& g0, const volume::GradientVoxel& g1, float t) {
+            return volume::GradientVoxel { glm::mix(g0.dir, g1.dir, t), glm::mix(g0.magnitude, g1.magnitude, t) };
+        };
+        return mix(mix(mix(voxel(0, 0, 0), voxel(1, 0, 0), f.x), mix(voxel(0, 1, 0), voxel(1, 1, 0), f.x), f.y),
+            mix(mix(voxel(0, 0, 1), voxel(1, 0, 1), f.x), mix(voxel(0, 1, 1), voxel(1, 1, 1), f.x), f.y), f.z);
+    };
+
+    // Rays along x through the volume, like the samples of a ray caster.
+    std::vector<glm::vec3> coords;
+    for (int i = 0; i < 64 * 64; i++) {
+        const glm::vec2 start = glm::vec2(float(i % 64), float(i / 64)) * (float(dim.y - 1) / 64.0f) + 0.37f;
+        for (float x = 0.0f; x < float(dim.x - 1); x += 0.5f)
+            coords.emplace_back(x, start.x, start.y);
+    }
+
+    const auto time = [&](const char* name, auto&& sample) {
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+        double sum = 0.0;
+        for (const glm::vec3& coord : coords)
+            sum += double(sample(coord).magnitude);
+        const auto end = clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(end - start).count() << "ms for " << coords.size() << " samples (checksum " << sum << ")" << std::endl;
+        return sum;
+    };
+    const double unpackedSum = time("Unpacked gradients", sampleUnpacked);
+    const double packedSum = time("Packed gradients", [&](const glm::vec3& coord) { return gradient.getGradientInterpolate(coord); });
+    // The first pass over the lazy gradients also computes all bricks.
+    time("Lazy packed gradients (computing bricks)", [&](const glm::vec3& coord) { return lazyGradient.getGradientInterpolate(coord); });
+    const double lazySum = time("Lazy packed gradients", [&](const glm::vec3& coord) { return lazyGradient.getGradientInterpolate(coord); });
+    REQUIRE(packedSum == Approx(unpackedSum).epsilon(1e-4));
+    REQUIRE(lazySum == Approx(unpackedSum).epsilon(1e-3));
+
+    const size_t unpackedSize = unpacked.size() * sizeof(volume::GradientVoxel);
+    std::cout << "Unpacked gradients: " << unpackedSize / (1 << 20) << "MB, packed gradients: " << gradient.sizeInBytes() / (1 << 20) << "MB" << std::endl;
+    REQUIRE(gradient.sizeInBytes() * 2 < unpackedSize);
+}
@@ -4,6 +4,8 @@ layout(location = 0) in vec3 pos;
 uniform mat4 u_modelViewProjection;
 uniform mat4 u_model;
 uniform vec3 cubeSize;
+uniform vec3 cropMin;
+uniform vec3 cropMax;
 
 uniform samplerBuffer positionCube;
 uniform isamplerBuffer blockActive;
@@ -20,8 +22,8 @@ void main() {
     int isActive = texelFetch(blockActive, gl_InstanceID).x;
 
     if (isActive > 0) {
-        // moves the cube instance to the correct position and clamps the last row of cubes
-        vec3 actualPos = clamp((pos + cubeOffset) * cubeSize, 0, 1);
+        // moves the cube instance to the correct position and clamps the cubes to the crop box
+        vec3 actualPos = clamp((pos + cubeOffset) * cubeSize, cropMin, cropMax);
         
         // calculate position in view space
         worldPos = (u_model * vec4(actualPos, 1.0)).xyz;
@@ -15,18 +15,24 @@ uniform sampler3D volumeData;
 // the volume indirection lookup
 uniform sampler3D volumeIndexData;
 
+// local ambient occlusion factors of the classified volume (lower resolution than the volume)
+uniform sampler3D ambientOcclusion;
+
 // the transferfunction (2D for simplicity, values in y do not change, so it can be sampled with (norm intensity, 0.5)
 uniform sampler2D transferFunction;
 
 // this contains the voxels size in normalized coordinates + 0 if using regular texture and 1 when using bricking
 uniform vec4 volumeInfo; // (voxelsize.x, voxelsize.y, voxelsize.z, use bricking?)
 uniform vec2 volumeMaxValues; // 1/max intensity, 1/max gm
+uniform float volumeValueScale; // converts texture values to intensities (the value range for normalized 8 bit volume textures, 1 otherwise)
+uniform float volumeValueOffset; // the minimum intensity for normalized 8 bit volume textures, 0 otherwise
 
 // contains various rendering options, here stepsize and its reciprocal (both in normalized volume space) and the stepsize in the original space, and the toggle to use shading
 // Note: we give reciprocals to avoid divisions as they are more expensive than multiplications
 // so if we can calculate a reciprocal once outside instead of potentially multiple times every thread it can save a lot of computation
 uniform vec4 renderOptions; // (stepSize (adjusted to 0..1 volume coords), 1.0f / stepSize, stepSize (orginal value relative to default), use shading)
 uniform vec4 gmParams; // kc, ks, ke, use opacity modulation
+uniform vec4 aoParams; // (scale from normalized volume coordinates to ambient occlusion texture coordinates, use ambient occlusion)
 
 
 // Phong shading constants, defined globally to avoid repeated creation in phongShading function
@@ -60,19 +66,18 @@ vec3 phongShading(vec3 color, vec4 normal, vec3 L, vec3 V)
     return ambient + diffuse + specular;
 }
 
-// ======= TODO: IMPLEMENT ========
-//
-// Part of **1. Basic Volume Rendering**
-//
-// This function should calculate the gradient on the fly at the current samplePos
+// This function calculates the gradient on the fly at the current samplePos using central differences
 // Gives the voxelSize (in normalized volume coordinates) for the offset
-// The return is a vec4 intended to contain the gradient magnitude in the fourth component though not strictly necessary
+// The return is a vec4 containing the gradient magnitude in the fourth component
 // Note: The function can be cpoied over to iso-surface shader once implemented
 vec4 calculateGradient(vec3 samplePos, vec3 voxelSize)
 {
-    vec4 gradient = vec4(0.0f);
+    vec3 gradient = 0.5 * volumeValueScale * vec3(
+        texture(volumeData, samplePos + vec3(voxelSize.x, 0.0, 0.0)).r - texture(volumeData, samplePos - vec3(voxelSize.x, 0.0, 0.0)).r,
+        texture(volumeData, samplePos + vec3(0.0, voxelSize.y, 0.0)).r - texture(volumeData, samplePos - vec3(0.0, voxelSize.y, 0.0)).r,
+        texture(volumeData, samplePos + vec3(0.0, 0.0, voxelSize.z)).r - texture(volumeData, samplePos - vec3(0.0, 0.0, voxelSize.z)).r);
 
-    return gradient;
+    return vec4(gradient, length(gradient));
 }
 
 
@@ -126,12 +131,30 @@ void main()
     int numSteps = int(ray_length * renderOptions.y);
     vec3 ray_increment = ray_direction * renderOptions.x;
 
+    // front to back compositing with premultiplied colors (the same as the CPU renderer)
     vec4 color = vec4(0.0f);
-    for(int i = 0; i < numSteps; i++) {
+    for(int i = 0; i < numSteps; i++, samplePos += ray_increment) {
+
+        // classify the sample, the transfer function is indexed with the normalized intensity
+        float intensity = texture(volumeData, samplePos).r * volumeValueScale + volumeValueOffset;
+        vec4 sampleColor = texture(transferFunction, vec2(intensity * volumeMaxValues.x, 0.5));
+        if (sampleColor.a <= 0.0)
+            continue;
+
+        // headlight shading: the light and view vectors both point back along the ray
+        if (renderOptions.w > 0.5)
+            sampleColor.rgb = phongShading(sampleColor.rgb, calculateGradient(samplePos, volumeInfo.xyz), -ray_direction, -ray_direction);
+
+        // darken the sample by the amount of opacity in its neighbourhood
+        if (aoParams.w > 0.5)
+            sampleColor.rgb *= texture(ambientOcclusion, samplePos * aoParams.xyz).r;
+
+        color.rgb += (1.0 - color.a) * sampleColor.a * sampleColor.rgb;
+        color.a += (1.0 - color.a) * sampleColor.a;
 
-        // ======= TODO: IMPLEMENT ========
-        // replace this with your code
-        color = vec4(samplePos, 0.0f);
+        // early ray termination
+        if (color.a >= 0.99)
+            break;
     }
 
     // this sets the final color to the pixel
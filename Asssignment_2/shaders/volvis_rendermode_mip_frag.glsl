@@ -18,6 +18,10 @@ uniform vec4 renderOptions; // (stepSize, 1.0f / stepSize, empty, empty)
 // this contains the voxels size in normalized coordinates + the reciprocal of the max intensity of the volume
 uniform vec4 volumeInfo; // (voxelsize.x, voxelsize.y, voxelsize.z, 1.0f/max vol intensity)
 
+// converts texture values to intensities (the max intensity for normalized 8 bit volume textures, 1 otherwise)
+uniform float volumeValueScale;
+uniform float volumeValueOffset;
+
 void main()
 {
     // start positions from the front face texture
@@ -39,7 +43,7 @@ void main()
     for(int i = 0; i < numSteps; i++) {
     
         // sample the volume
-        float intensity = float(texture(volumeData, samplePos).r);
+        float intensity = float(texture(volumeData, samplePos).r) * volumeValueScale + volumeValueOffset;
         
         // update max value
         maxIntensity = max(intensity, maxIntensity);
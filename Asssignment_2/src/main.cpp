@@ -4,6 +4,10 @@
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
 
+#include "render/ambient_occlusion.h"
+#include "render/async_renderer.h"
+#include "render/illumination_cache.h"
+#include "render/quality_controller.h"
 #include "render/renderer.h"
 #include "render/gpu_renderer.h"
 #include "ui/full_screen_texture_gl.h"
@@ -12,18 +16,27 @@
 #include "ui/trackball.h"
 #include "ui/window.h"
 #include "ui/wireframe_cube.h"
-#include "volume/gradient_volume.h"
+#include "util/task_graph.h"
+#include "volume/compressed_volume.h"
+#include "volume/quantized_volume.h"
+#include "volume/lazy_gradient_volume.h"
 #include "volume/volume.h"
 #include "volume/gpu_volume.h"
+#include "volume/joint_histogram.h"
+#include <atomic>
 #include <chrono>
 #include <cmath> // log2
+#include <exception>
 #include <glm/geometric.hpp>
 #include <glm/gtx/component_wise.hpp>
 #include <glm/vec3.hpp>
 #include <imgui.h>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <ratio>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 int main(int argc, char** argv)
@@ -32,7 +45,10 @@ int main(int argc, char** argv)
     constexpr int menuWidth = 560;
     glm::ivec2 viewportSize { 760, 760 };
     glm::ivec2 windowSize { viewportSize.x + menuWidth, viewportSize.y };
-    constexpr float frameTimeTarget = 1.0f / 60.0f; // Target 60 fps.
+    // Volumes with more voxels than this are first shown as a subsampled preview (with at most previewMaxDimension
+    // voxels along each axis) that can be explored while the full volume is loading.
+    constexpr size_t previewMinVoxels = size_t(1) << 25;
+    constexpr int previewMaxDimension = 128;
 
     // === VIEWER ===
     ui::Window myWindow { "3D Visualization Viewer", windowSize };
@@ -50,11 +66,20 @@ int main(int argc, char** argv)
     // nothing to render hence the optional (initially it is empty). The optional is passed to the menu
     // class which is responsible for creating the volume + renderer when the user loads a volume.
     std::optional<volume::Volume> optVolume;
+    std::optional<volume::Volume> optPreviewVolume;
+    std::optional<volume::LazyGradientVolume> optPreviewGradientVolume;
+    std::optional<volume::QuantizedVolume> optQuantizedVolume;
     std::optional<volume::GPUVolume> optGPUVolume;
-    std::optional<volume::GradientVolume> optGradientVolume;
-    std::optional<render::Renderer> optRenderer;
+    std::optional<volume::LazyGradientVolume> optGradientVolume;
+    std::optional<volume::CompressedVolume> optCompressedVolume;
+    std::optional<render::IlluminationCache> optIlluminationCache;
+    std::optional<render::AmbientOcclusionVolume> optAmbientOcclusion;
+    std::optional<volume::JointHistogram> optJointHistogram;
+    std::optional<render::AsyncRenderer> optRenderer;
     std::optional<render::GPURenderer> gpuRenderer;
     ui::Menu volVisMenu { viewportSize };
+    // Chooses the settings of the CPU renderer during interaction such that frames fit in the frame budget.
+    render::QualityController qualityController;
 
     // Whether to redraw because the user interacted with the application. When this is the reason for the
     // redraw then dynamic resolution scaling is enabled. After the user interaction, one more render is
@@ -66,27 +91,209 @@ int main(int argc, char** argv)
     bool updateOpacitySumTable = true;
     bool updateVolume = true;
 
+    // Preprocessing of the most recently loaded volume. It is destroyed after its last task finished (see the main loop),
+    // and is declared after the objects that its tasks create so that it is destroyed before them.
+    std::optional<util::TaskGraph> optLoadPipeline;
+    // The ambient occlusion volume is built on a worker thread when it is first enabled; this is only set once it is attached
+    // to the renderers. Transfer function edits are also applied on a worker thread (see the main loop).
+    render::AmbientOcclusionVolume* pAmbientOcclusion = nullptr;
+    std::optional<util::TaskGraph> optAmbientOcclusionUpdate;
+    // The quantized volume is built on a worker thread if it is first selected after loading (see the main loop).
+    std::optional<util::TaskGraph> optQuantizedVolumeBuild;
+    // A poster is rendered on a worker thread by a renderer of its own (see the poster callback).
+    std::atomic<float> posterProgress { 0.0f };
+    std::atomic_bool cancelPoster { false };
+    std::optional<util::TaskGraph> optPosterRender;
+    // The volume that the CPU renderer draws: the preview until the full volume (or its compressed or quantized copy) is loaded.
+    volume::VolumeSampler* pRenderedVolume = nullptr;
+    // Used to print the time to the first frame after loading a volume.
+    std::optional<std::chrono::steady_clock::time_point> optLoadStartTime;
+    auto reportFirstFrame = [&]() {
+        if (optLoadStartTime) {
+            std::cout << "First frame after loading rendered in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - *optLoadStartTime).count() << "ms" << std::endl;
+            optLoadStartTime.reset();
+        }
+    };
+
+    // Destroy the current volume and everything that was created from it.
+    auto unloadVolume = [&]() {
+        // Stop the preprocessing of a previous volume (and a poster of it) before destroying the objects that their tasks use.
+        // The renderers (the CPU renderer renders on a thread of its own) and the illumination cache (which reads from
+        // the gradient volume on a background thread) refer to the other objects, so they have to be destroyed first.
+        if (optPosterRender) {
+            cancelPoster = true;
+            optPosterRender.reset();
+            volVisMenu.setPosterFinished("The poster was cancelled.");
+        }
+        optLoadPipeline.reset();
+        optAmbientOcclusionUpdate.reset();
+        optQuantizedVolumeBuild.reset();
+        pAmbientOcclusion = nullptr;
+        pRenderedVolume = nullptr;
+        optRenderer.reset();
+        gpuRenderer.reset();
+        optIlluminationCache.reset();
+        optAmbientOcclusion.reset();
+        optJointHistogram.reset();
+        optGPUVolume.reset();
+        optQuantizedVolume.reset();
+        optCompressedVolume.reset();
+        optGradientVolume.reset();
+        optVolume.reset();
+        optPreviewGradientVolume.reset();
+        optPreviewVolume.reset();
+        optLoadStartTime.reset();
+    };
+
     // This value stores a refrence of all the values that can change the render to check if anything changed
     auto loadVolume = [&](const std::filesystem::path& filePath) {
-        optVolume.emplace(filePath.string());
-        optVolume->interpolationMode = volVisMenu.interpolationMode();
-
-        optGradientVolume.emplace(optVolume.value());
-        optGPUVolume.emplace(&optVolume.value());
-        optGPUVolume->interpolationMode = volVisMenu.interpolationMode();
-        optRenderer.emplace(&optVolume.value(), &optGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig());
-        gpuRenderer.emplace(&optGPUVolume.value(), &optVolume.value(), &optGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig(), volVisMenu.meshConfig());
-        gpuRenderer->setRenderSize(baseRenderResolutionScaled);
+        unloadVolume();
+        volVisMenu.setVolumeLoading(filePath);
+        optLoadStartTime = std::chrono::steady_clock::now();
+
+        // The preprocessing steps form a dependency graph: independent steps run concurrently on worker threads and the
+        // OpenGL steps run on the main thread in between frames. Everything that the main loop and the callbacks look at is
+        // created by main thread tasks, so the CPU renderer starts drawing as soon as the volume and gradients are ready,
+        // while the histogram, the GPU resources and the ambient occlusion are still being computed.
+        // The worker tasks read the menu settings from before the load, the menu is only accessed on the main thread.
+        const volume::InterpolationMode interpolationMode = volVisMenu.interpolationMode();
+        const std::optional<volume::VolumeRegion> optRegion = volVisMenu.loadRegion();
+        const render::RenderConfig renderConfig = volVisMenu.renderConfig();
+        const ui::CPUVolumeFormat cpuVolumeFormat = volVisMenu.cpuVolumeFormat();
+        using Thread = util::TaskGraph::Thread;
+        util::TaskGraph& pipeline = optLoadPipeline.emplace();
+
+        // Large volumes are first loaded at a coarse resolution, which the CPU renderer shows until the full volume replaces it.
+        // The full volume is loaded after the preview so that they do not compete for the disk. A region of interest is
+        // loaded directly.
+        const glm::ivec3 fileDims = optRegion ? glm::ivec3(0) : volume::Volume::readDims(filePath);
+        const int previewStride = volume::voxelCount(fileDims) > previewMinVoxels ? (glm::compMax(fileDims) + previewMaxDimension - 1) / previewMaxDimension : 1;
+        std::vector<util::TaskGraph::TaskID> loadDependencies;
+        if (previewStride > 1) {
+            const auto previewTask = pipeline.addTask("load preview", Thread::Worker, {}, [&, filePath, interpolationMode, previewStride]() {
+                optPreviewVolume.emplace(filePath.string(), previewStride);
+                optPreviewVolume->interpolationMode = interpolationMode;
+                optPreviewGradientVolume.emplace(optPreviewVolume.value());
+                optPreviewGradientVolume->interpolationMode = interpolationMode;
+            });
+            pipeline.addTask("preview renderer", Thread::Main, { previewTask }, [&]() {
+                if (optRenderer) // The full volume was loaded first.
+                    return;
+                optRenderer.emplace(&optPreviewVolume.value(), &optPreviewGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig());
+                optRenderer->setInterpolationMode(volVisMenu.interpolationMode());
+                pRenderedVolume = &optPreviewVolume.value();
+                trackballCamera.enableRotation(true);
+
+                const float maxDimension = float(glm::compMax(optPreviewVolume->dims()));
+                trackballCamera.setDistance(maxDimension);
+                trackballCamera.setWorldScale(maxDimension);
+                trackballCamera.setLookAt(glm::vec3(optPreviewVolume->dims()) / 2.0f);
+                redrawUserInteraction = true;
+            });
+            loadDependencies.push_back(previewTask);
+        }
 
-        volVisMenu.setLoadedVolume(optVolume.value(), optGradientVolume.value());
-        trackballCamera.enableRotation(true);
+        const auto loadTask = pipeline.addTask("load volume", Thread::Worker, loadDependencies, [&, filePath, interpolationMode, optRegion]() {
+            if (optRegion)
+                optVolume.emplace(filePath, *optRegion);
+            else
+                optVolume.emplace(filePath.string());
+            optVolume->interpolationMode = interpolationMode;
+        });
+        const auto histogramTask = pipeline.addTask("histogram", Thread::Worker, { loadTask }, [&]() { optVolume->histogram(); });
+        // Gradients are only needed for shading and the 2D transfer function, so they are computed per brick on first use.
+        const auto gradientTask = pipeline.addTask("gradient volume", Thread::Worker, { loadTask }, [&, interpolationMode]() {
+            optGradientVolume.emplace(optVolume.value());
+            optGradientVolume->interpolationMode = interpolationMode;
+        });
+        const auto gpuVolumeTask = pipeline.addTask("volume texture upload", Thread::Main, { loadTask }, [&]() {
+            optGPUVolume.emplace(&optVolume.value());
+            optGPUVolume->interpolationMode = volVisMenu.interpolationMode();
+            optGPUVolume->setVolumeConfig(volVisMenu.volumeConfig());
+        });
+        const auto gpuMinMaxTask = pipeline.addTask("GPU brick min/max", Thread::Worker, { gpuVolumeTask }, [&]() { optGPUVolume->precomputeMinMax(); });
+
+        // The quantized volume can be uploaded to the GPU instead of the float volume (see GPUVolumeConfig), or rendered by the
+        // CPU renderer. It is only built if either is selected; the main loop builds it when it is selected later.
+        std::optional<util::TaskGraph::TaskID> optQuantizedTask;
+        if (cpuVolumeFormat == ui::CPUVolumeFormat::Quantized || volVisMenu.volumeConfig().useQuantizedVolume) {
+            optQuantizedTask = pipeline.addTask("quantized volume", Thread::Worker, { loadTask }, [&, interpolationMode]() {
+                optQuantizedVolume.emplace(optVolume.value());
+                optQuantizedVolume->interpolationMode = interpolationMode;
+            });
+        }
 
-        const float maxDimension = float(glm::compMax(optVolume->dims()));
-        trackballCamera.setDistance(maxDimension);
-        trackballCamera.setWorldScale(maxDimension);
-        trackballCamera.setLookAt(glm::vec3(optVolume->dims()) / 2.0f);
+        // The CPU renderer can sample a compressed copy of the volume instead, which decompresses bricks as rays enter them,
+        // or the quantized copy. Both are kept in addition to the volume, which everything else still reads.
+        std::vector<util::TaskGraph::TaskID> rendererDependencies { gradientTask };
+        if (cpuVolumeFormat == ui::CPUVolumeFormat::Compressed) {
+            rendererDependencies.push_back(pipeline.addTask("compressed volume", Thread::Worker, { loadTask }, [&, interpolationMode]() {
+                optCompressedVolume.emplace(optVolume.value());
+                optCompressedVolume->interpolationMode = interpolationMode;
+            }));
+        } else if (cpuVolumeFormat == ui::CPUVolumeFormat::Quantized) {
+            rendererDependencies.push_back(*optQuantizedTask);
+        }
+        const auto rendererTask = pipeline.addTask("CPU renderer", Thread::Main, rendererDependencies, [&, previewStride, cpuVolumeFormat]() {
+            const bool previewShown = optRenderer.has_value();
+            pRenderedVolume = &optVolume.value();
+            if (optCompressedVolume)
+                pRenderedVolume = &optCompressedVolume.value();
+            else if (cpuVolumeFormat == ui::CPUVolumeFormat::Quantized)
+                pRenderedVolume = &optQuantizedVolume.value();
+            optRenderer.emplace(pRenderedVolume, &optGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig());
+            optRenderer->setInterpolationMode(volVisMenu.interpolationMode());
+            optPreviewGradientVolume.reset();
+            optPreviewVolume.reset();
+
+            if (previewShown) {
+                // Keep the view that the user chose while exploring the preview.
+                trackballCamera.scaleWorld(float(previewStride));
+            } else {
+                trackballCamera.enableRotation(true);
 
-        redrawUserInteraction = true;
+                const float maxDimension = float(glm::compMax(optVolume->dims()));
+                trackballCamera.setDistance(maxDimension);
+                trackballCamera.setWorldScale(maxDimension);
+                trackballCamera.setLookAt(glm::vec3(optVolume->dims()) / 2.0f);
+            }
+            redrawUserInteraction = true;
+        });
+        const auto gpuRendererTask = pipeline.addTask("GPU renderer", Thread::Main, { gpuMinMaxTask }, [&]() {
+            gpuRenderer.emplace(&optGPUVolume.value(), &optVolume.value(), &optGradientVolume.value(), &trackballCamera, volVisMenu.renderConfig(), volVisMenu.meshConfig());
+            gpuRenderer->setRenderSize(baseRenderResolutionScaled);
+        });
+        const auto brickCacheTask = pipeline.addTask("GPU brick cache", Thread::Main, { gpuRendererTask }, [&]() { gpuRenderer->updateVolumeBricks(); });
+        if (optQuantizedTask) {
+            pipeline.addTask("attach quantized volume", Thread::Main, { *optQuantizedTask, brickCacheTask }, [&]() {
+                optGPUVolume->setQuantizedVolume(&optQuantizedVolume.value());
+                // Uploads it if it is selected already.
+                gpuRenderer->updateVolumeBricks();
+                redrawGPUVolume = true;
+            });
+        }
+        pipeline.addTask("illumination cache", Thread::Main, { rendererTask }, [&]() {
+            optIlluminationCache.emplace(&optVolume.value(), &optGradientVolume.value());
+            optRenderer->setIlluminationCache(&optIlluminationCache.value());
+        });
+        // The volume dependent parts of the menu can only be used once the objects that their callbacks modify exist.
+        const auto menuTask = pipeline.addTask("menu", Thread::Main, { histogramTask, rendererTask, brickCacheTask }, [&]() {
+            volVisMenu.setLoadedVolume(optVolume.value(), optGradientVolume.value());
+            redrawUserInteraction = true;
+        });
+        // The range of the gradient magnitudes needs the gradients of the whole volume. The 2D transfer function (widget) and
+        // the GPU compositing shader use it, but do not wait for it on the main thread, so it is computed once everything
+        // else is up. The CPU renderer waits for it on its own thread if it renders the 2D transfer function before that.
+        const auto magnitudeRangeTask = pipeline.addTask("gradient magnitude range", Thread::Worker, { menuTask, gpuRendererTask }, [&]() { optGradientVolume->maxMagnitude(); });
+        // The joint histogram is the background of the 2D transfer function widget, which shows it once it is ready.
+        const auto jointHistogramTask = pipeline.addTask("joint histogram", Thread::Worker, { magnitudeRangeTask }, [&]() {
+            optJointHistogram.emplace(optVolume.value(), optGradientVolume.value());
+        });
+        pipeline.addTask("attach joint histogram", Thread::Main, { jointHistogramTask }, [&]() {
+            volVisMenu.setJointHistogram(*optJointHistogram);
+            optJointHistogram.reset();
+        });
+        pipeline.start();
     };
 
     // Callbacks.
@@ -103,14 +310,55 @@ int main(int argc, char** argv)
                 updateOpacitySumTable = true;
             }
         });
+    auto setInterpolationMode = [&](volume::InterpolationMode interpolationMode) {
+        // The CPU renderer changes the volumes that it renders in between frames.
+        if (optRenderer)
+            optRenderer->setInterpolationMode(interpolationMode);
+        if (optGPUVolume)
+            optGPUVolume->interpolationMode = interpolationMode;
+        redrawUserInteraction = true;
+    };
     volVisMenu.setInterpolationModeChangedCallback(
         [&](volume::InterpolationMode interpolationMode) {
-            if (optVolume) {
-                optVolume->interpolationMode = interpolationMode;
-                optGPUVolume->interpolationMode = interpolationMode;
-                optGradientVolume->interpolationMode = interpolationMode;
+            // A poster that is rendering samples the same volumes, so the new mode is applied once it is finished.
+            if (!optPosterRender)
+                setInterpolationMode(interpolationMode);
+        });
+    volVisMenu.setRenderPosterCallback(
+        [&](const std::filesystem::path& file, const glm::ivec2& resolution) {
+            if (!optRenderer || optPreviewVolume || optPosterRender)
+                return;
+
+            // The poster is rendered with the settings selected in the menu and a copy of the current camera, on a worker
+            // thread, so the application keeps responding. It samples the same volumes as the CPU renderer: their
+            // interpolation mode is set while that is paused, and changes to it or to the ambient occlusion volume are held
+            // back until the poster is finished.
+            if (optAmbientOcclusionUpdate)
+                optAmbientOcclusionUpdate->wait();
+            {
+                const auto pauseRenderer = optRenderer->pause();
+                pRenderedVolume->interpolationMode = volVisMenu.interpolationMode();
+                optGradientVolume->interpolationMode = volVisMenu.interpolationMode();
             }
-            redrawUserInteraction = true;
+            const std::shared_ptr<const render::RayTraceCamera> pCamera = trackballCamera.clone();
+            render::IlluminationCache* pIlluminationCache = optIlluminationCache ? &optIlluminationCache.value() : nullptr;
+            posterProgress = 0.0f;
+            cancelPoster = false;
+            using Thread = util::TaskGraph::Thread;
+            util::TaskGraph& posterRender = optPosterRender.emplace(1);
+            const auto renderTask = posterRender.addTask("poster", Thread::Worker, {},
+                [&, file, resolution, pCamera, pIlluminationCache, pVolume = pRenderedVolume, pAmbientOcclusion = pAmbientOcclusion, renderConfig = volVisMenu.renderConfig()]() {
+                    render::Renderer posterRenderer { pVolume, &optGradientVolume.value(), pCamera.get(), renderConfig };
+                    posterRenderer.setIlluminationCache(pIlluminationCache);
+                    posterRenderer.setAmbientOcclusionVolume(pAmbientOcclusion);
+                    if (!posterRenderer.renderPoster(resolution, file, 64, &cancelPoster, &posterProgress))
+                        throw std::runtime_error("Could not write poster to " + file.string());
+                });
+            posterRender.addTask("poster finished", Thread::Main, { renderTask }, [&, file]() {
+                volVisMenu.setPosterFinished("Poster written to " + file.string());
+            });
+            posterRender.start();
+            volVisMenu.setPosterProgress(0.0f);
         });
     volVisMenu.setGPUMeshConfigChangedCallback(
         [&](const render::GPUMeshConfig& gpuMeshConfig) {
@@ -140,9 +388,9 @@ int main(int argc, char** argv)
         });
     myWindow.registerMouseButtonCallback(
         [&](int key, int action, int mods) {
-            if (key == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+            if (key == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && pRenderedVolume) {
 
-                glm::vec3 dims = glm::vec3(optVolume->dims());
+                glm::vec3 dims = glm::vec3(pRenderedVolume->dims());
                 glm::vec3 rectMin(0, 0, 0);
                 glm::vec3 rectMax(dims.x, dims.y, 0);
                 glm::vec3 rectNormal(0, 0, 1);
@@ -178,8 +426,8 @@ int main(int argc, char** argv)
 
         myWindow.registerMouseMoveCallback(
             [&](const glm::vec2& cursorPos) {
-            if (myWindow.isMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT)) {
-                glm::vec3 dims = glm::vec3(optVolume->dims());
+            if (myWindow.isMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT) && pRenderedVolume) {
+                glm::vec3 dims = glm::vec3(pRenderedVolume->dims());
                 glm::vec3 rectMin(0, 0, 0);
                 glm::vec3 rectMax(dims.x, dims.y, 0);
                 glm::vec3 rectNormal(0, 0, 1);
@@ -229,9 +477,6 @@ int main(int argc, char** argv)
     ui::WireframeCube wireframeCube;
     ui::SurfaceCube surfaceCube;
 
-    // The dynamic resolution scale that was used in previous frame (to keep the frame time below the target).
-    int prevResolutionScale = 1;
-
     std::chrono::duration<double> renderTime { 0 };
     std::chrono::duration<double> renderTimeFrame { 0 };
     std::chrono::duration<double> renderTimeFrameTemp { 0 };
@@ -241,6 +486,108 @@ int main(int argc, char** argv)
 
     while (!myWindow.shouldClose()) {
         myWindow.updateInput();
+
+        // Run the OpenGL steps of the volume preprocessing whose inputs became available.
+        // A step that failed (e.g. because the file could not be read) cancels the steps that depend on it, so the volume is
+        // incomplete: throw all of it away.
+        if (optLoadPipeline) {
+            try {
+                optLoadPipeline->runMainThreadTasks();
+                if (optLoadPipeline->isFinished())
+                    optLoadPipeline.reset();
+            } catch (const std::exception& e) {
+                std::cerr << "Could not load volume: " << e.what() << std::endl;
+                unloadVolume();
+                volVisMenu.setVolumeLoadFailed(e.what());
+            }
+        }
+
+        // Bring the ambient occlusion volume up to date with the transfer function. It is only built once ambient occlusion is
+        // enabled for the loaded volume. Only the parts affected by a TF edit are recomputed, on a worker thread, so that dragging
+        // a TF control point does not stall the application. The renderers keep using the previous occlusion values until the
+        // new ones are swapped in; edits made in the meantime are picked up by the next update.
+        if (optAmbientOcclusionUpdate) {
+            try {
+                optAmbientOcclusionUpdate->runMainThreadTasks();
+            } catch (const std::exception& e) {
+                std::cerr << "Could not update ambient occlusion: " << e.what() << std::endl;
+            }
+            if (optAmbientOcclusionUpdate->isFinished())
+                optAmbientOcclusionUpdate.reset();
+        }
+        const bool volumeLoaded = optRenderer && gpuRenderer && !optLoadPipeline;
+        if (!optAmbientOcclusionUpdate && volumeLoaded && volVisMenu.renderConfig().ambientOcclusion && !pAmbientOcclusion) {
+            using Thread = util::TaskGraph::Thread;
+            util::TaskGraph& update = optAmbientOcclusionUpdate.emplace(1);
+            const auto buildTask = update.addTask("ambient occlusion", Thread::Worker, {}, [&, renderConfig = volVisMenu.renderConfig()]() {
+                optAmbientOcclusion.emplace(&optVolume.value());
+                optAmbientOcclusion->update(renderConfig);
+            });
+            update.addTask("attach ambient occlusion", Thread::Main, { buildTask }, [&]() {
+                pAmbientOcclusion = &optAmbientOcclusion.value();
+                gpuRenderer->updateAmbientOcclusion(*pAmbientOcclusion);
+                optRenderer->setAmbientOcclusionVolume(pAmbientOcclusion);
+                redrawUserInteraction = true;
+            });
+            update.start();
+        } else if (!optAmbientOcclusionUpdate && !optPosterRender && pAmbientOcclusion && volVisMenu.renderConfig().ambientOcclusion && pAmbientOcclusion->needsUpdate(volVisMenu.renderConfig())) {
+            using Thread = util::TaskGraph::Thread;
+            util::TaskGraph& update = optAmbientOcclusionUpdate.emplace(1);
+            const auto updateTask = update.addTask("ambient occlusion update", Thread::Worker, {}, [&, renderConfig = volVisMenu.renderConfig()]() {
+                pAmbientOcclusion->prepareUpdate(renderConfig);
+            });
+            update.addTask("swap ambient occlusion", Thread::Main, { updateTask }, [&]() {
+                {
+                    // The CPU renderer reads the ambient occlusion volume on its own thread.
+                    const auto pauseRenderer = optRenderer->pause();
+                    pAmbientOcclusion->applyUpdate();
+                }
+                gpuRenderer->updateAmbientOcclusion(*pAmbientOcclusion);
+                redrawUserInteraction = true;
+            });
+            update.start();
+        }
+
+        // Report the progress of a poster that is rendering in the background. Once it is finished, the interpolation mode
+        // that was selected in the meantime is applied.
+        if (optPosterRender) {
+            try {
+                volVisMenu.setPosterProgress(posterProgress);
+                optPosterRender->runMainThreadTasks();
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                volVisMenu.setPosterFinished(e.what());
+            }
+            if (optPosterRender->isFinished()) {
+                optPosterRender.reset();
+                setInterpolationMode(volVisMenu.interpolationMode());
+            }
+        }
+
+        // Build the quantized volume once it is selected for the GPU renderer, if it was not selected during loading.
+        if (optQuantizedVolumeBuild) {
+            try {
+                optQuantizedVolumeBuild->runMainThreadTasks();
+            } catch (const std::exception& e) {
+                std::cerr << "Could not build the quantized volume: " << e.what() << std::endl;
+            }
+            if (optQuantizedVolumeBuild->isFinished())
+                optQuantizedVolumeBuild.reset();
+        } else if (volumeLoaded && volVisMenu.volumeConfig().useQuantizedVolume && !optQuantizedVolume) {
+            using Thread = util::TaskGraph::Thread;
+            util::TaskGraph& build = optQuantizedVolumeBuild.emplace(1);
+            const auto quantizedTask = build.addTask("quantized volume", Thread::Worker, {}, [&, interpolationMode = volVisMenu.interpolationMode()]() {
+                optQuantizedVolume.emplace(optVolume.value());
+                optQuantizedVolume->interpolationMode = interpolationMode;
+            });
+            build.addTask("attach quantized volume", Thread::Main, { quantizedTask }, [&]() {
+                optGPUVolume->setQuantizedVolume(&optQuantizedVolume.value());
+                gpuRenderer->updateVolumeBricks();
+                redrawGPUVolume = true;
+            });
+            build.start();
+        }
+
         using clock = std::chrono::steady_clock;
         startFrame = clock::now();
 
@@ -250,10 +597,17 @@ int main(int argc, char** argv)
                 // If camera changed in any way then we need to redraw.
                 static glm::mat4 prevViewMatrix = glm::identity<glm::mat4>();
                 const glm::mat4 viewMatrix = trackballCamera.viewMatrix();
-                if (prevViewMatrix != viewMatrix) {
+                const bool viewChanged = prevViewMatrix != viewMatrix;
+                if (viewChanged) {
                     prevViewMatrix = viewMatrix;
                     redrawUserInteraction = true;
                 }
+                // Redraw once the illumination cache finished building a grid for the new light direction.
+                static uint64_t prevIlluminationGeneration = 0;
+                if (optIlluminationCache && optIlluminationCache->generation() != prevIlluminationGeneration) {
+                    prevIlluminationGeneration = optIlluminationCache->generation();
+                    redrawFullResolution = true;
+                }
                 // If previous frame we rendered at a lower resolution (because something changed) then it will request to draw
                 // the next frame in full resolution. If the user is still holding the mouse button then we can reasonably assume
                 // that (s)he is not finished with the interaction (so we should keep rendering at a lower resolution).
@@ -262,46 +616,84 @@ int main(int argc, char** argv)
 
                 // We draw when either the user has interacted (camera matrix changed or render config changed (see callback)) or if
                 //  last frame we rendered at a lower resolution and we want to now render at the full resolution.
-                if (redrawUserInteraction || redrawFullResolution) {
-                    if (redrawUserInteraction) {
-                        // Reduce the resolution if the performance drops below the target frame time.
-                        // Estimated performance when rendering at full resolution (resolution returned from menu).
-                        // This way we can dynamically update the resolution while the user is moving the camera since
-                        // some views may be slower to render than others.
-                        const float estimatedFullResFrameTime = float(renderTime.count()) * float(prevResolutionScale * prevResolutionScale);
-                        const float performanceScale = estimatedFullResFrameTime / float(frameTimeTarget);
-                        // Resolution scale changes the number of pixels quadratically (scales both width and height).
-                        const int resolutionScale = std::max(int(std::sqrt(performanceScale)) + 1, 1);
+                // The frames are rendered asynchronously: the full resolution frame is requested once the low resolution frame
+                //  finished, because requesting it earlier would replace the low resolution frame.
+                // Progressive refinement replaces the dynamic resolution: it always renders at full resolution and the first
+                //  (coarse) pass of the refinement is fast enough for interaction. The fused view is never refined or interleaved.
+                if (volVisMenu.renderConfig().progressiveRefinement && !volVisMenu.renderConfig().fusedView) {
+                    if (redrawUserInteraction || redrawFullResolution) {
+                        volVisMenu.setBaseRenderResolution(baseRenderResolution);
+                        optRenderer->setInterpolationMode(volVisMenu.interpolationMode());
+                        redrawUserInteraction = false;
+                        redrawFullResolution = false;
+                        optRenderer->requestFrame();
+                    }
+                } else if (redrawUserInteraction || (redrawFullResolution && !optRenderer->isBusy())) {
+                    // Interleaved rendering keeps the full resolution while the user interacts and instead traces only
+                    //  a fraction of the pixels, reprojecting the others from the previous frame.
+                    const bool interleaved = redrawUserInteraction && volVisMenu.renderConfig().interleavedRendering && !volVisMenu.renderConfig().fusedView;
+                    // Moving a thick slab while the camera stands still updates the previous frame incrementally, which
+                    //  only works (and is cheap enough) at full quality.
+                    const bool slabMoved = redrawUserInteraction && !viewChanged && volVisMenu.renderConfig().renderMode == render::RenderMode::RenderSlab;
+                    if (interleaved || slabMoved) {
+                        volVisMenu.setBaseRenderResolution(baseRenderResolution);
+                        optRenderer->setInterpolationMode(volVisMenu.interpolationMode());
+                        redrawFullResolution = interleaved;
+                    } else if (redrawUserInteraction) {
+                        // Lower the quality (resolution, step size and interpolation) such that frames rendered during
+                        //  interaction fit in the frame budget. The quality controller learns the cost of the current
+                        //  view from the render times of the displayed frames (see below).
+                        const render::QualitySettings quality = qualityController.settings();
 
                         // NOTE(Mathijs): calling setBaseRenderResolution will update the render config and call
                         //  the associated callback. Make sure that you don't read redrawUserInteraction after
                         //  this call because it will always be true.
-                        volVisMenu.setBaseRenderResolution(baseRenderResolution / resolutionScale);
+                        volVisMenu.setBaseRenderResolution(glm::max(glm::ivec2(glm::vec2(baseRenderResolution) * quality.resolutionScale), glm::ivec2(1)));
+                        render::RenderConfig interactionConfig = volVisMenu.renderConfig();
+                        interactionConfig.stepSize *= quality.stepSizeScale;
+                        optRenderer->setConfig(interactionConfig);
+                        optRenderer->setInterpolationMode(quality.nearestNeighbour ? volume::InterpolationMode::NearestNeighbour : volVisMenu.interpolationMode());
                         redrawFullResolution = true;
-                        prevResolutionScale = resolutionScale;
                     } else {
-                        prevResolutionScale = 1;
                         volVisMenu.setBaseRenderResolution(baseRenderResolution);
+                        optRenderer->setInterpolationMode(volVisMenu.interpolationMode());
                         redrawFullResolution = false;
                     }
                     redrawUserInteraction = false;
+                    optRenderer->requestFrame(interleaved);
+                }
 
-                    using clock = std::chrono::steady_clock;
-                    const auto start = clock::now();
-                    optRenderer->render();
-                    const auto end = clock::now();
-                    renderTime = end - start;
+                // Show the most recently finished frame.
+                if (optRenderer->swapFrameBuffers()) {
+                    renderTime = optRenderer->frameRenderTime();
+                    reportFirstFrame();
+
+                    // Progressively refined and interleaved frames do not use the quality controller.
+                    const render::RenderConfig frameConfig = optRenderer->frameConfig();
+                    if (frameConfig.fusedView || (!frameConfig.progressiveRefinement && !frameConfig.interleavedRendering)) {
+                        qualityController.setFrameBudget(volVisMenu.frameBudget());
+                        qualityController.addFrame(renderTime,
+                            float(frameConfig.renderResolution.x) / float(baseRenderResolution.x),
+                            frameConfig.stepSize / volVisMenu.renderConfig().stepSize,
+                            optRenderer->frameInterpolationMode() == volume::InterpolationMode::NearestNeighbour);
+                        volVisMenu.setInteractiveQuality(qualityController.settings());
+                    }
 
-                    fullScreenTextureGL.update(optRenderer->frameBuffer(), volVisMenu.renderConfig().renderResolution);
+                    if (frameConfig.compactFrameBuffer)
+                        fullScreenTextureGL.update(optRenderer->compactFrameBuffer(), optRenderer->frameResolution());
+                    else
+                        fullScreenTextureGL.update(optRenderer->frameBuffer(), optRenderer->frameResolution());
                 }
 
                 // === Drawing the framebuffer to the screen and adding the wireframe. ===
 
                 // Make the wireframe slightly larger than the volume to prevent z-fighting
                 constexpr float wireframeMargin = 0.05f;
-                const auto wireframeCubeSize = glm::vec3(optVolume->dims()) * (1.0f + wireframeMargin);
-                const auto wireframeCubeOffset = -glm::vec3(optVolume->dims()) * wireframeMargin * 0.5f;
+                const auto wireframeCubeSize = glm::vec3(pRenderedVolume->dims()) * (1.0f + wireframeMargin);
+                const auto wireframeCubeOffset = -glm::vec3(pRenderedVolume->dims()) * wireframeMargin * 0.5f;
                 constexpr glm::vec3 wireframeColor { 1.0f };
+                // The wireframe does not line up with the panes of the fused view.
+                const bool showWireframe = !optRenderer->frameConfig().fusedView;
 
                 // Draw on the left side of the screen next to the menu.
                 const glm::ivec2 borders = ((windowSize - glm::ivec2(menuWidth, 0) - baseRenderResolution)) / 2;
@@ -317,7 +709,7 @@ int main(int argc, char** argv)
                 glDepthMask(GL_TRUE);
                 glDepthFunc(GL_LEQUAL);
                 glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-                surfaceCube.draw(trackballCamera, optVolume->dims());
+                surfaceCube.draw(trackballCamera, pRenderedVolume->dims());
 
                 // Enable color writes and depth blending.
                 glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
@@ -327,7 +719,8 @@ int main(int argc, char** argv)
                 // Draw the part of the wireframe that is behind the volume.
                 glDepthMask(GL_FALSE);
                 glDepthFunc(GL_GREATER);
-                wireframeCube.draw(trackballCamera, wireframeCubeSize, wireframeCubeOffset, wireframeColor);
+                if (showWireframe)
+                    wireframeCube.draw(trackballCamera, wireframeCubeSize, wireframeCubeOffset, wireframeColor);
 
                 // Draw the CPU framebuffer on top of the GPU framebuffer.
                 glDepthFunc(GL_ALWAYS);
@@ -338,7 +731,8 @@ int main(int argc, char** argv)
                 // Finally, draw the part of the wireframe that is in front of the volume.
                 glDepthFunc(GL_LEQUAL);
                 glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                wireframeCube.draw(trackballCamera, wireframeCubeSize, wireframeCubeOffset, wireframeColor);
+                if (showWireframe)
+                    wireframeCube.draw(trackballCamera, wireframeCubeSize, wireframeCubeOffset, wireframeColor);
 
                 // Restore render state.
                 glDisable(GL_BLEND);
@@ -390,6 +784,7 @@ int main(int argc, char** argv)
 
                 const auto end = clock::now();
                 renderTime = end - start;
+                reportFirstFrame();
 
                 // Restore render state.
                 glDisable(GL_BLEND);
@@ -418,5 +813,7 @@ int main(int argc, char** argv)
         myWindow.swapBuffers();
         
     }
+    // Do not wait for a poster that is still rendering.
+    cancelPoster = true;
     return 0;
 }
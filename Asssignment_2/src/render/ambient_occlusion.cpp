@@ -0,0 +1,318 @@
+#include "ambient_occlusion.h"
+#include <algorithm>
+#include <chrono>
+#include <glm/common.hpp>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace render {
+
+// Maps a volume value to an index into the transfer function, the same way as Renderer::getTFValue.
+static int tfIndex(float value, float indexStart, float indexRange, int tfSize)
+{
+    const float range01 = (value - indexStart) / indexRange;
+    return std::clamp(int(range01 * float(tfSize)), 0, tfSize - 1);
+}
+
+// Grow the set of marked cells by radius cells in every direction (a box dilation).
+// Done as three separable passes that each use a running count over a window of 2 * radius + 1 cells.
+static std::vector<char> dilate(const std::vector<char>& mask, const glm::ivec3& dim, int radius)
+{
+    std::vector<char> result = mask;
+    const size_t strides[3] { 1, size_t(dim.x), size_t(dim.x) * size_t(dim.y) };
+    for (int axis = 0; axis < 3; axis++) {
+        const std::vector<char> input = result;
+        const int length = dim[axis];
+        const size_t stride = strides[axis];
+        const glm::ivec3 lines = glm::ivec3(axis == 0 ? 1 : dim.x, axis == 1 ? 1 : dim.y, axis == 2 ? 1 : dim.z);
+
+#pragma omp parallel for
+        for (int lineIndex = 0; lineIndex < lines.x * lines.y * lines.z; lineIndex++) {
+            const int lx = lineIndex % lines.x;
+            const int ly = (lineIndex / lines.x) % lines.y;
+            const int lz = lineIndex / (lines.x * lines.y);
+            const size_t first = size_t(lx) + size_t(dim.x) * (size_t(ly) + size_t(dim.y) * size_t(lz));
+
+            // Number of marked cells in the window [i - radius, i + radius].
+            int count = 0;
+            for (int i = 0; i < std::min(radius, length); i++)
+                count += input[first + size_t(i) * stride];
+            for (int i = 0; i < length; i++) {
+                if (i + radius < length)
+                    count += input[first + size_t(i + radius) * stride];
+                if (i - radius - 1 >= 0)
+                    count -= input[first + size_t(i - radius - 1) * stride];
+                result[first + size_t(i) * stride] = count > 0;
+            }
+        }
+    }
+    return result;
+}
+
+AmbientOcclusionVolume::AmbientOcclusionVolume(const volume::Volume* pVolume, int downsampleFactor, int radius)
+    : m_pVolume(pVolume)
+    , m_downsampleFactor(std::max(downsampleFactor, 1))
+    , m_radius(std::max(radius, 1))
+    , m_dim((pVolume->dims() + m_downsampleFactor - 1) / m_downsampleFactor)
+    , m_valueRanges(volume::voxelCount(m_dim))
+    , m_opacity(m_valueRanges.size(), 0.0f)
+    , m_summedAreaTable(size_t(m_dim.x + 1) * size_t(m_dim.y + 1) * size_t(m_dim.z + 1), 0.0)
+    , m_data(m_valueRanges.size(), 1.0f)
+{
+    computeValueRanges();
+}
+
+// Whether update() would change anything, i.e. whether the opacity part of the transfer function changed.
+bool AmbientOcclusionVolume::needsUpdate(const RenderConfig& config) const
+{
+    if (!m_isClassified || config.tfColorMapIndexStart != m_tfColorMapIndexStart || config.tfColorMapIndexRange != m_tfColorMapIndexRange)
+        return true;
+    for (size_t i = 0; i < m_tfOpacity.size(); i++) {
+        if (config.tfColorMap[i].a != m_tfOpacity[i])
+            return true;
+    }
+    return false;
+}
+
+// Reclassify the volume with the transfer function of the given config and update the occlusion values.
+// Returns false (and does nothing) if the opacity part of the transfer function did not change.
+bool AmbientOcclusionVolume::update(const RenderConfig& config)
+{
+    if (!prepareUpdate(config))
+        return false;
+    applyUpdate();
+    return true;
+}
+
+// Like update(), but the new occlusion values are written to the back buffer: data() and getAmbientOcclusionInterpolate()
+// keep returning the previous values until applyUpdate() is called.
+bool AmbientOcclusionVolume::prepareUpdate(const RenderConfig& config)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    const int tfSize = int(config.tfColorMap.size());
+    std::array<float, 256> tfOpacity;
+    for (size_t i = 0; i < tfOpacity.size(); i++)
+        tfOpacity[i] = config.tfColorMap[i].a;
+
+    std::vector<char> dirtyCells(m_opacity.size(), 0);
+    if (!m_isClassified || config.tfColorMapIndexStart != m_tfColorMapIndexStart || config.tfColorMapIndexRange != m_tfColorMapIndexRange) {
+        std::fill(std::begin(dirtyCells), std::end(dirtyCells), char(1));
+    } else {
+        // Find the range of transfer function entries whose opacity changed.
+        int firstChanged = tfSize, lastChanged = -1;
+        for (int i = 0; i < tfSize; i++) {
+            if (tfOpacity[size_t(i)] != m_tfOpacity[size_t(i)]) {
+                firstChanged = std::min(firstChanged, i);
+                lastChanged = i;
+            }
+        }
+        if (lastChanged < 0)
+            return false;
+
+        // Only cells containing values that map into that range are affected.
+#pragma omp parallel for
+        for (int i = 0; i < int(m_valueRanges.size()); i++) {
+            const glm::vec2& valueRange = m_valueRanges[size_t(i)];
+            const int minIndex = tfIndex(valueRange.x, m_tfColorMapIndexStart, m_tfColorMapIndexRange, tfSize);
+            const int maxIndex = tfIndex(valueRange.y, m_tfColorMapIndexStart, m_tfColorMapIndexRange, tfSize);
+            dirtyCells[size_t(i)] = minIndex <= lastChanged && maxIndex >= firstChanged;
+        }
+    }
+
+    m_tfOpacity = tfOpacity;
+    m_tfColorMapIndexStart = config.tfColorMapIndexStart;
+    m_tfColorMapIndexRange = config.tfColorMapIndexRange;
+    m_isClassified = true;
+
+    classifyCells(dirtyCells);
+    buildSummedAreaTable();
+    // Only the cells near the edited ones are recomputed, the others keep their current value.
+    m_updatedData = m_data;
+    computeOcclusion(dilate(dirtyCells, m_dim, m_radius));
+    m_hasPreparedUpdate = true;
+
+    const auto end = clock::now();
+    std::cout << "AmbientOcclusionVolume::prepareUpdate() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+    return true;
+}
+
+// Make the occlusion values computed by the last prepareUpdate() visible. This only swaps two buffers.
+void AmbientOcclusionVolume::applyUpdate()
+{
+    if (!m_hasPreparedUpdate)
+        return;
+    std::swap(m_data, m_updatedData);
+    m_hasPreparedUpdate = false;
+}
+
+// This function returns the trilinearly interpolated ambient occlusion factor at a continuous position given in (full resolution) voxel coordinates.
+// Cell centers are located at the centers of the voxel blocks they summarize.
+float AmbientOcclusionVolume::getAmbientOcclusionInterpolate(const glm::vec3& coord) const
+{
+    const glm::vec3 gridCoord = glm::clamp((coord + 0.5f) / float(m_downsampleFactor) - 0.5f, glm::vec3(0.0f), glm::vec3(m_dim - 1));
+    const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(gridCoord), m_dim - 2), glm::ivec3(0));
+    const glm::ivec3 p1 = glm::min(p0 + 1, m_dim - 1);
+    const glm::vec3 f = gridCoord - glm::vec3(p0);
+
+    const float c00 = glm::mix(m_data[cellIndex(p0.x, p0.y, p0.z)], m_data[cellIndex(p1.x, p0.y, p0.z)], f.x);
+    const float c10 = glm::mix(m_data[cellIndex(p0.x, p1.y, p0.z)], m_data[cellIndex(p1.x, p1.y, p0.z)], f.x);
+    const float c01 = glm::mix(m_data[cellIndex(p0.x, p0.y, p1.z)], m_data[cellIndex(p1.x, p0.y, p1.z)], f.x);
+    const float c11 = glm::mix(m_data[cellIndex(p0.x, p1.y, p1.z)], m_data[cellIndex(p1.x, p1.y, p1.z)], f.x);
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+
+glm::ivec3 AmbientOcclusionVolume::dims() const
+{
+    return m_dim;
+}
+
+// Scale that maps normalized volume coordinates to normalized texture coordinates of the occlusion grid.
+// The grid covers a (slightly) larger region than the volume when the dimensions are not a multiple of the downsample factor.
+glm::vec3 AmbientOcclusionVolume::textureScale() const
+{
+    return glm::vec3(m_pVolume->dims()) / glm::vec3(m_dim * m_downsampleFactor);
+}
+
+const std::vector<float>& AmbientOcclusionVolume::data() const
+{
+    return m_data;
+}
+
+size_t AmbientOcclusionVolume::cellIndex(int x, int y, int z) const
+{
+    return volume::voxelIndex(m_dim, x, y, z);
+}
+
+size_t AmbientOcclusionVolume::tableIndex(int x, int y, int z) const
+{
+    return size_t(x) + size_t(m_dim.x + 1) * (size_t(y) + size_t(m_dim.y + 1) * size_t(z));
+}
+
+// Store the value range of the voxels covered by every cell so that TF edits can be mapped to the cells they affect.
+void AmbientOcclusionVolume::computeValueRanges()
+{
+    const glm::ivec3 volumeDims = m_pVolume->dims();
+
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++) {
+                const glm::ivec3 blockBegin = glm::ivec3(x, y, z) * m_downsampleFactor;
+                const glm::ivec3 blockEnd = glm::min(blockBegin + m_downsampleFactor, volumeDims);
+
+                glm::vec2 range { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+                for (int vz = blockBegin.z; vz < blockEnd.z; vz++) {
+                    for (int vy = blockBegin.y; vy < blockEnd.y; vy++) {
+                        for (int vx = blockBegin.x; vx < blockEnd.x; vx++) {
+                            const float value = m_pVolume->getVoxel(vx, vy, vz);
+                            range.x = std::min(range.x, value);
+                            range.y = std::max(range.y, value);
+                        }
+                    }
+                }
+                m_valueRanges[cellIndex(x, y, z)] = range;
+            }
+        }
+    }
+}
+
+// Compute the mean transfer function opacity of the voxels covered by every dirty cell.
+void AmbientOcclusionVolume::classifyCells(const std::vector<char>& dirtyCells)
+{
+    const glm::ivec3 volumeDims = m_pVolume->dims();
+    const int tfSize = int(m_tfOpacity.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++) {
+                const size_t index = cellIndex(x, y, z);
+                if (!dirtyCells[index])
+                    continue;
+
+                const glm::ivec3 blockBegin = glm::ivec3(x, y, z) * m_downsampleFactor;
+                const glm::ivec3 blockEnd = glm::min(blockBegin + m_downsampleFactor, volumeDims);
+
+                float sum = 0.0f;
+                for (int vz = blockBegin.z; vz < blockEnd.z; vz++) {
+                    for (int vy = blockBegin.y; vy < blockEnd.y; vy++) {
+                        for (int vx = blockBegin.x; vx < blockEnd.x; vx++)
+                            sum += m_tfOpacity[size_t(tfIndex(m_pVolume->getVoxel(vx, vy, vz), m_tfColorMapIndexStart, m_tfColorMapIndexRange, tfSize))];
+                    }
+                }
+                const glm::ivec3 blockSize = blockEnd - blockBegin;
+                m_opacity[index] = sum / float(blockSize.x * blockSize.y * blockSize.z);
+            }
+        }
+    }
+}
+
+// Build the 3D summed-area table of the cell opacities as three passes of (independent, hence parallel) 1D prefix sums.
+// Entry (x, y, z) contains the sum of all cells in [0, x) x [0, y) x [0, z). Doubles prevent the large sums from losing precision.
+void AmbientOcclusionVolume::buildSummedAreaTable()
+{
+    const glm::ivec3 tableDims = m_dim + 1;
+
+#pragma omp parallel for
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            double rowSum = 0.0;
+            for (int x = 0; x < m_dim.x; x++) {
+                rowSum += double(m_opacity[cellIndex(x, y, z)]);
+                m_summedAreaTable[tableIndex(x + 1, y + 1, z + 1)] = rowSum;
+            }
+        }
+    }
+
+#pragma omp parallel for
+    for (int z = 1; z < tableDims.z; z++) {
+        for (int y = 2; y < tableDims.y; y++) {
+            for (int x = 1; x < tableDims.x; x++)
+                m_summedAreaTable[tableIndex(x, y, z)] += m_summedAreaTable[tableIndex(x, y - 1, z)];
+        }
+    }
+
+#pragma omp parallel for
+    for (int y = 1; y < tableDims.y; y++) {
+        for (int z = 2; z < tableDims.z; z++) {
+            for (int x = 1; x < tableDims.x; x++)
+                m_summedAreaTable[tableIndex(x, y, z)] += m_summedAreaTable[tableIndex(x, y, z - 1)];
+        }
+    }
+}
+
+// Sum of the cell opacities in the box [begin, end).
+double AmbientOcclusionVolume::boxSum(const glm::ivec3& b, const glm::ivec3& e) const
+{
+    return m_summedAreaTable[tableIndex(e.x, e.y, e.z)]
+        - m_summedAreaTable[tableIndex(b.x, e.y, e.z)] - m_summedAreaTable[tableIndex(e.x, b.y, e.z)] - m_summedAreaTable[tableIndex(e.x, e.y, b.z)]
+        + m_summedAreaTable[tableIndex(b.x, b.y, e.z)] + m_summedAreaTable[tableIndex(b.x, e.y, b.z)] + m_summedAreaTable[tableIndex(e.x, b.y, b.z)]
+        - m_summedAreaTable[tableIndex(b.x, b.y, b.z)];
+}
+
+// The occlusion of a cell is the mean opacity of the box of (2 * radius + 1)^3 cells around it (clipped to the volume).
+// The results are written to the back buffer.
+void AmbientOcclusionVolume::computeOcclusion(const std::vector<char>& dirtyCells)
+{
+#pragma omp parallel for
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++) {
+                const size_t index = cellIndex(x, y, z);
+                if (!dirtyCells[index])
+                    continue;
+
+                const glm::ivec3 boxBegin = glm::max(glm::ivec3(x, y, z) - m_radius, glm::ivec3(0));
+                const glm::ivec3 boxEnd = glm::min(glm::ivec3(x, y, z) + m_radius + 1, m_dim);
+                const glm::ivec3 boxSize = boxEnd - boxBegin;
+                const double meanOpacity = boxSum(boxBegin, boxEnd) / double(boxSize.x * boxSize.y * boxSize.z);
+                m_updatedData[index] = 1.0f - std::clamp(float(meanOpacity), 0.0f, 1.0f);
+            }
+        }
+    }
+}
+
+}
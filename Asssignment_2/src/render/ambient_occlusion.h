@@ -0,0 +1,63 @@
+#pragma once
+#include "render/render_config.h"
+#include "volume/volume.h"
+#include <array>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace render {
+
+// Local ambient occlusion for the 1D transfer function: for every (downsampled) cell the fraction of the surrounding
+// box that is NOT occupied by classified opacity. The mean opacity of a box is an O(1) query into a 3D summed-area table,
+// so the build cost does not depend on the occlusion radius.
+// After a transfer function edit only the cells whose value range overlaps the edited part of the TF are reclassified,
+// and only the occlusion values within the radius of those cells are recomputed.
+// The occlusion values are double buffered: prepareUpdate() may run while another thread samples the volume, only
+// applyUpdate() (which swaps the buffers) has to be synchronized with the readers.
+class AmbientOcclusionVolume {
+public:
+    AmbientOcclusionVolume(const volume::Volume* pVolume, int downsampleFactor = 2, int radius = 3);
+
+    bool needsUpdate(const RenderConfig& config) const;
+    bool update(const RenderConfig& config);
+    bool prepareUpdate(const RenderConfig& config);
+    void applyUpdate();
+
+    float getAmbientOcclusionInterpolate(const glm::vec3& coord) const;
+
+    glm::ivec3 dims() const;
+    glm::vec3 textureScale() const;
+    const std::vector<float>& data() const;
+
+private:
+    size_t cellIndex(int x, int y, int z) const;
+    size_t tableIndex(int x, int y, int z) const;
+
+    void computeValueRanges();
+    void classifyCells(const std::vector<char>& dirtyCells);
+    void buildSummedAreaTable();
+    void computeOcclusion(const std::vector<char>& dirtyCells);
+    double boxSum(const glm::ivec3& begin, const glm::ivec3& end) const;
+
+private:
+    const volume::Volume* m_pVolume;
+    const int m_downsampleFactor;
+    const int m_radius;
+    const glm::ivec3 m_dim;
+
+    std::vector<glm::vec2> m_valueRanges; // Minimum and maximum voxel value of every cell.
+    std::vector<float> m_opacity; // Mean classified opacity of every cell.
+    std::vector<double> m_summedAreaTable; // (m_dim + 1)^3 entries, the first row/column/slice is zero.
+    std::vector<float> m_data; // Ambient occlusion factor of every cell, 1 = unoccluded.
+    std::vector<float> m_updatedData; // Back buffer of m_data that prepareUpdate() writes to.
+    bool m_hasPreparedUpdate { false };
+
+    // Transfer function that m_opacity was classified with.
+    bool m_isClassified { false };
+    std::array<float, 256> m_tfOpacity;
+    float m_tfColorMapIndexStart { 0.0f };
+    float m_tfColorMapIndexRange { 0.0f };
+};
+
+}
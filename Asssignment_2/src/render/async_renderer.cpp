@@ -0,0 +1,277 @@
+#include "async_renderer.h"
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+namespace render {
+
+// Number of pixels that are traced for a frame (interleaved frames trace one in interleaveFactor pixels).
+static size_t pixelCount(const glm::ivec2& resolution, int interleaveFactor = 1)
+{
+    return size_t(resolution.x) * size_t(resolution.y) / size_t(std::max(interleaveFactor, 1));
+}
+
+AsyncRenderer::AsyncRenderer(
+    volume::VolumeSampler* pVolume,
+    volume::GradientProvider* pGradientVolume,
+    const render::RayTraceCamera* pCamera,
+    const RenderConfig& config)
+    : m_pVolume(pVolume)
+    , m_pGradientVolume(pGradientVolume)
+    , m_pCamera(pCamera)
+    , m_pFrameCamera(pCamera->clone())
+    , m_renderer(pVolume, pGradientVolume, m_pFrameCamera.get(), config)
+    , m_config(config)
+    , m_requestedConfig(config)
+    , m_thread([this]() { renderLoop(); })
+{
+}
+
+AsyncRenderer::~AsyncRenderer()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+        m_cancel = true;
+    }
+    m_wakeUp.notify_one();
+    m_thread.join();
+}
+
+void AsyncRenderer::setConfig(const RenderConfig& config)
+{
+    std::lock_guard lock { m_mutex };
+    m_config = config;
+}
+
+// The interpolation mode is a member of the volumes, so it can only be changed while no frame is rendering.
+void AsyncRenderer::setInterpolationMode(volume::InterpolationMode interpolationMode)
+{
+    std::lock_guard lock { m_mutex };
+    m_optInterpolationMode = interpolationMode;
+}
+
+void AsyncRenderer::setIlluminationCache(IlluminationCache* pIlluminationCache)
+{
+    std::lock_guard lock { m_mutex };
+    m_pIlluminationCache = pIlluminationCache;
+}
+
+void AsyncRenderer::setAmbientOcclusionVolume(const AmbientOcclusionVolume* pAmbientOcclusion)
+{
+    std::lock_guard lock { m_mutex };
+    m_pAmbientOcclusion = pAmbientOcclusion;
+}
+
+// Render a frame with the current camera and settings. Returns immediately. Interleaved frames reproject the previous
+// frame (see Renderer::renderInterleaved()).
+void AsyncRenderer::requestFrame(bool interleaved)
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_pRequestedCamera = m_pCamera->clone();
+        m_requestedConfig = m_config;
+        m_requestedInterleaved = interleaved;
+        if (m_rendering && (m_refining || m_renderingPixels > pixelCount(m_config.renderResolution, interleaved ? m_config.interleaveFactor : 1)))
+            m_cancel = true;
+    }
+    m_wakeUp.notify_one();
+}
+
+// Whether a requested frame did not finish yet (including the refinement of its image).
+bool AsyncRenderer::isBusy() const
+{
+    std::lock_guard lock { m_mutex };
+    return m_rendering || m_pRequestedCamera || m_refinementPass < m_numRefinementPasses;
+}
+
+// Cancel the running frame and keep the render thread waiting until the returned lock is released, so that the caller
+// can modify objects that the renderer reads (such as the ambient occlusion volume). The caller should request a new frame.
+std::unique_lock<std::mutex> AsyncRenderer::pause()
+{
+    std::unique_lock lock { m_mutex };
+    m_cancel = true;
+    m_idle.wait(lock, [this]() { return !m_rendering; });
+    return lock;
+}
+
+// Display the most recently finished frame. Returns false if no frame finished since the previous call.
+bool AsyncRenderer::swapFrameBuffers()
+{
+    std::lock_guard lock { m_mutex };
+    if (!m_hasFinishedFrame)
+        return false;
+
+    std::swap(m_frameBuffer, m_finishedFrameBuffer);
+    std::swap(m_compactFrameBuffer, m_finishedCompactFrameBuffer);
+    m_frameResolution = m_finishedResolution;
+    m_frameConfig = m_finishedConfig;
+    m_frameInterpolationMode = m_finishedInterpolationMode;
+    m_frameRenderTime = m_finishedRenderTime;
+    m_hasFinishedFrame = false;
+    return true;
+}
+
+// Return a VIEW into the displayed framebuffer. It stays valid until the next call to swapFrameBuffers().
+gsl::span<const glm::vec4> AsyncRenderer::frameBuffer() const
+{
+    return m_frameBuffer;
+}
+
+// The displayed frame as packed 8-bit RGBA, if it was rendered with compactFrameBuffer enabled (empty otherwise).
+gsl::span<const uint32_t> AsyncRenderer::compactFrameBuffer() const
+{
+    return m_compactFrameBuffer;
+}
+
+// The resolution of the displayed frame. This is the render resolution, except for fused frames whose panes are rendered
+// at half the render resolution (rounded down).
+glm::ivec2 AsyncRenderer::frameResolution() const
+{
+    return m_frameResolution;
+}
+
+// The settings that the displayed frame was rendered with.
+RenderConfig AsyncRenderer::frameConfig() const
+{
+    return m_frameConfig;
+}
+
+volume::InterpolationMode AsyncRenderer::frameInterpolationMode() const
+{
+    return m_frameInterpolationMode;
+}
+
+// The time that it took to render the displayed frame.
+std::chrono::duration<double> AsyncRenderer::frameRenderTime() const
+{
+    return m_frameRenderTime;
+}
+
+// Arrange the images of the last Renderer::renderFused() call in m_fusedFrameBuffer as a 2x2 grid: MIP and isosurface on
+// the top row, compositing on the bottom left and the bottom right empty.
+void AsyncRenderer::composeFusedFrame(const glm::ivec2& paneResolution)
+{
+    const glm::ivec2 resolution = 2 * paneResolution;
+    m_fusedFrameBuffer.resize(pixelCount(resolution));
+    std::fill(std::begin(m_fusedFrameBuffer), std::end(m_fusedFrameBuffer), glm::vec4(0.0f));
+
+    const std::pair<RenderMode, glm::ivec2> panes[] {
+        { RenderMode::RenderMIP, glm::ivec2(0, paneResolution.y) },
+        { RenderMode::RenderIso, paneResolution },
+        { RenderMode::RenderComposite, glm::ivec2(0) }
+    };
+    for (const auto& [renderMode, paneOffset] : panes) {
+        const gsl::span<const glm::vec4> pane = m_renderer.fusedFrameBuffer(renderMode);
+        for (int y = 0; y < paneResolution.y; y++) {
+            const auto paneRow = std::begin(pane) + std::ptrdiff_t(y) * paneResolution.x;
+            const size_t frameRow = size_t(paneOffset.y + y) * size_t(resolution.x) + size_t(paneOffset.x);
+            std::copy(paneRow, paneRow + paneResolution.x, std::begin(m_fusedFrameBuffer) + std::ptrdiff_t(frameRow));
+        }
+    }
+}
+
+void AsyncRenderer::renderLoop()
+{
+    RenderConfig config;
+    bool interleaved = false;
+    std::chrono::duration<double> imageRenderTime { 0 };
+    while (true) {
+        bool newImage;
+        IlluminationCache* pIlluminationCache;
+        const AmbientOcclusionVolume* pAmbientOcclusion;
+        std::optional<volume::InterpolationMode> optInterpolationMode;
+        int refinementPass, numRefinementPasses;
+        {
+            std::unique_lock lock { m_mutex };
+            m_wakeUp.wait(lock, [&]() { return m_stop || m_pRequestedCamera || m_refinementPass < m_numRefinementPasses; });
+            if (m_stop)
+                return;
+
+            newImage = m_pRequestedCamera != nullptr;
+            if (newImage) {
+                m_pFrameCamera = std::move(m_pRequestedCamera);
+                config = m_requestedConfig;
+                interleaved = m_requestedInterleaved;
+                pIlluminationCache = m_pIlluminationCache;
+                pAmbientOcclusion = m_pAmbientOcclusion;
+                std::swap(optInterpolationMode, m_optInterpolationMode);
+                m_refinementPass = 0;
+                m_numRefinementPasses = config.progressiveRefinement && !config.fusedView ? Renderer::numRefinementPasses(config) : 0;
+                imageRenderTime = std::chrono::duration<double>(0);
+            }
+            refinementPass = m_refinementPass;
+            numRefinementPasses = m_numRefinementPasses;
+            m_rendering = true;
+            m_refining = refinementPass > 0;
+            m_renderingPixels = pixelCount(config.renderResolution, interleaved && numRefinementPasses == 0 && !config.fusedView ? config.interleaveFactor : 1);
+            m_cancel = false;
+        }
+
+        if (newImage) {
+            if (optInterpolationMode && *optInterpolationMode != m_pVolume->interpolationMode) {
+                m_pVolume->interpolationMode = *optInterpolationMode;
+                m_pGradientVolume->interpolationMode = *optInterpolationMode;
+                m_renderer.resetReprojectionHistory();
+            }
+            m_renderer.setCamera(m_pFrameCamera.get());
+            if (config.fusedView) {
+                // Fused frames do not update the frame that interleaved frames reproject, so it is outdated afterwards.
+                RenderConfig paneConfig = config;
+                paneConfig.renderResolution = glm::max(config.renderResolution / 2, glm::ivec2(1));
+                paneConfig.compactFrameBuffer = false;
+                m_renderer.setConfig(paneConfig);
+                m_renderer.resetReprojectionHistory();
+            } else {
+                m_renderer.setConfig(config);
+            }
+            m_renderer.setIlluminationCache(pIlluminationCache);
+            m_renderer.setAmbientOcclusionVolume(pAmbientOcclusion);
+        }
+
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+        const glm::ivec2 paneResolution = glm::max(config.renderResolution / 2, glm::ivec2(1));
+        bool finished;
+        if (config.fusedView) {
+            finished = m_renderer.renderFused(&m_cancel);
+            if (finished)
+                composeFusedFrame(paneResolution);
+        } else if (numRefinementPasses > 0)
+            finished = m_renderer.renderRefinementPass(refinementPass, &m_cancel);
+        else if (interleaved)
+            finished = m_renderer.renderInterleaved(&m_cancel);
+        else
+            finished = m_renderer.render(&m_cancel);
+        const auto end = clock::now();
+        imageRenderTime += end - start;
+
+        {
+            std::lock_guard lock { m_mutex };
+            m_rendering = false;
+            if (finished) {
+                if (config.fusedView) {
+                    std::swap(m_fusedFrameBuffer, m_finishedFrameBuffer);
+                    m_finishedCompactFrameBuffer.clear();
+                    m_finishedResolution = 2 * paneResolution;
+                } else {
+                    m_renderer.swapFrameBuffer(m_finishedFrameBuffer);
+                    m_renderer.swapCompactFrameBuffer(m_finishedCompactFrameBuffer);
+                    m_finishedResolution = config.renderResolution;
+                }
+                m_finishedConfig = config;
+                m_finishedConfig.compactFrameBuffer = config.compactFrameBuffer && !config.fusedView;
+                m_finishedInterpolationMode = m_pVolume->interpolationMode;
+                m_finishedRenderTime = imageRenderTime;
+                m_hasFinishedFrame = true;
+                m_refinementPass++;
+            } else {
+                // A cancelled pass leaves the refinement in an inconsistent state, it restarts with the next request.
+                m_numRefinementPasses = 0;
+            }
+        }
+        m_idle.notify_all();
+    }
+}
+
+}
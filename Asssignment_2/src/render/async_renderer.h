@@ -0,0 +1,125 @@
+#pragma once
+#include "render/ambient_occlusion.h"
+#include "render/illumination_cache.h"
+#include "render/ray_trace_camera.h"
+#include "render/render_config.h"
+#include "render/renderer.h"
+#include "util/aligned_allocator.h"
+#include "volume/gradient_provider.h"
+#include "volume/volume_sampler.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/span>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace render {
+
+// Runs a Renderer on a thread of its own, so that the UI keeps running at full frame rate however long a frame takes.
+// Settings are handed over to the render thread and applied in between frames, and every frame is rendered with a copy
+// of the camera that was taken when it was requested.
+//
+// A frame is rendered into a back buffer, which is exchanged with the displayed buffer once the frame is finished (see
+// swapFrameBuffers()). Requests that arrive while a frame is rendering are coalesced into one. The running frame is only
+// cancelled (after its current tiles) when the new request has fewer pixels, e.g. when the user starts moving the camera
+// during a full resolution frame. Frames of the same resolution are never cancelled, so that continuous interaction shows
+// new frames at the rate at which they can be rendered.
+//
+// With progressive refinement enabled, every pass of the refinement is handed over as a frame of its own, and the
+// refinement continues in the background until the image converged or a new frame is requested (which cancels it).
+//
+// With the fused view enabled, the frames show the MIP, isosurface and compositing images of Renderer::renderFused() in
+// a 2x2 grid (see frameResolution()). Fused frames are always rendered at once and never have a compact framebuffer.
+class AsyncRenderer {
+public:
+    AsyncRenderer(
+        volume::VolumeSampler* pVolume,
+        volume::GradientProvider* pGradientVolume,
+        const render::RayTraceCamera* pCamera,
+        const RenderConfig& config);
+    // Cancels the running frame.
+    ~AsyncRenderer();
+
+    AsyncRenderer(const AsyncRenderer&) = delete;
+    AsyncRenderer& operator=(const AsyncRenderer&) = delete;
+
+    // The settings are used from the next requested frame on.
+    void setConfig(const RenderConfig& config);
+    void setInterpolationMode(volume::InterpolationMode interpolationMode);
+    void setIlluminationCache(IlluminationCache* pIlluminationCache);
+    void setAmbientOcclusionVolume(const AmbientOcclusionVolume* pAmbientOcclusion);
+
+    void requestFrame(bool interleaved = false);
+    bool isBusy() const;
+    std::unique_lock<std::mutex> pause();
+
+    bool swapFrameBuffers();
+    gsl::span<const glm::vec4> frameBuffer() const;
+    gsl::span<const uint32_t> compactFrameBuffer() const;
+    glm::ivec2 frameResolution() const;
+    RenderConfig frameConfig() const;
+    volume::InterpolationMode frameInterpolationMode() const;
+    std::chrono::duration<double> frameRenderTime() const;
+
+private:
+    void renderLoop();
+    void composeFusedFrame(const glm::ivec2& paneResolution);
+
+private:
+    volume::VolumeSampler* m_pVolume;
+    volume::GradientProvider* m_pGradientVolume;
+    const render::RayTraceCamera* m_pCamera;
+
+    // Only used by the render thread.
+    std::unique_ptr<render::RayTraceCamera> m_pFrameCamera;
+    Renderer m_renderer;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp, m_idle;
+    RenderConfig m_config;
+    std::optional<volume::InterpolationMode> m_optInterpolationMode;
+    IlluminationCache* m_pIlluminationCache { nullptr };
+    const AmbientOcclusionVolume* m_pAmbientOcclusion { nullptr };
+    // The most recent request that was not picked up by the render thread yet.
+    std::unique_ptr<render::RayTraceCamera> m_pRequestedCamera;
+    RenderConfig m_requestedConfig;
+    bool m_requestedInterleaved { false };
+    // The frame that the render thread is working on.
+    bool m_rendering { false };
+    bool m_refining { false }; // Refinement pass after the first one.
+    // Progressive refinement of the current image (m_numRefinementPasses is 0 when it is rendered at once).
+    int m_refinementPass { 0 }, m_numRefinementPasses { 0 };
+    size_t m_renderingPixels { 0 };
+    std::atomic_bool m_cancel { false };
+    bool m_stop { false };
+
+    // The fused view of the last fused frame, only used by the render thread.
+    util::AlignedVector<glm::vec4> m_fusedFrameBuffer;
+
+    // Finished frame that was not displayed yet.
+    bool m_hasFinishedFrame { false };
+    util::AlignedVector<glm::vec4> m_finishedFrameBuffer;
+    util::AlignedVector<uint32_t> m_finishedCompactFrameBuffer;
+    glm::ivec2 m_finishedResolution { 0 };
+    RenderConfig m_finishedConfig {};
+    volume::InterpolationMode m_finishedInterpolationMode { volume::InterpolationMode::NearestNeighbour };
+    std::chrono::duration<double> m_finishedRenderTime { 0 };
+
+    // Displayed frame, only used by the thread that calls swapFrameBuffers().
+    util::AlignedVector<glm::vec4> m_frameBuffer;
+    util::AlignedVector<uint32_t> m_compactFrameBuffer;
+    glm::ivec2 m_frameResolution { 0 };
+    RenderConfig m_frameConfig {};
+    volume::InterpolationMode m_frameInterpolationMode { volume::InterpolationMode::NearestNeighbour };
+    std::chrono::duration<double> m_frameRenderTime { 0 };
+
+    std::thread m_thread;
+};
+
+}
@@ -1,4 +1,5 @@
 #include "gpu_renderer.h"
+#include <glm/common.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/component_wise.hpp>
 #include <iostream>
@@ -9,7 +10,7 @@ namespace render {
 GPURenderer::GPURenderer(
     volume::GPUVolume* pGPUVolume,
     const volume::Volume* pVolume,
-    const volume::GradientVolume* pGradientVolume,
+    const volume::GradientProvider* pGradientVolume,
     const ui::Trackball* pCamera,
     const RenderConfig& config,
     const GPUMeshConfig& meshConfig)
@@ -79,6 +80,16 @@ GPURenderer::GPURenderer(
     glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, m_blockActiveBufferID);
     glBindTexture(GL_TEXTURE_BUFFER, 0);
 
+    // Low resolution ambient occlusion volume, the data is uploaded in updateAmbientOcclusion
+    glGenTextures(1, &m_ambientOcclusionTexID);
+    glBindTexture(GL_TEXTURE_3D, m_ambientOcclusionTexID);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
     // Vertex Shader for rendering the cube geometry
     GLuint renderCubesVertexShader = loadShader("gpu_optimization_vert.glsl", GL_VERTEX_SHADER);
     // Setup shaders
@@ -366,6 +377,9 @@ void GPURenderer::drawGeometry(GLuint shaderID)
 
     // the size of each cube in normalized volume coordinates
     glUniform3fv(glGetUniformLocation(shaderID, "cubeSize"), 1, glm::value_ptr(1.0f / m_numBlocks3D));
+    // the cubes are clipped to the crop box, so the rays start and end at its faces
+    glUniform3fv(glGetUniformLocation(shaderID, "cropMin"), 1, glm::value_ptr(m_renderConfig.cropMin));
+    glUniform3fv(glGetUniformLocation(shaderID, "cropMax"), 1, glm::value_ptr(glm::max(m_renderConfig.cropMin, m_renderConfig.cropMax)));
 
     // give the matrices to the shaders
     glUniformMatrix4fv(glGetUniformLocation(shaderID, "u_model"), 1, GL_FALSE, glm::value_ptr(m_modelMatrix));
@@ -459,6 +473,8 @@ void GPURenderer::renderMIP()
     // the reciprocal of the volDims is the voxelSize in 0..1 space, the reciprocal of the maximum vol value eases GPU load
     glm::vec4 volumeInfo = glm::vec4(1.0f / volDims, 1.0f / m_pVolume->maximum());
     glUniform4fv(glGetUniformLocation(m_mipShader, "volumeInfo"), 1, glm::value_ptr(volumeInfo));
+    glUniform1f(glGetUniformLocation(m_mipShader, "volumeValueScale"), m_pGPUVolume->getValueScale());
+    glUniform1f(glGetUniformLocation(m_mipShader, "volumeValueOffset"), m_pGPUVolume->getValueOffset());
 
     glClear(GL_COLOR_BUFFER_BIT);
 
@@ -555,6 +571,10 @@ void GPURenderer::renderComposite()
         glBindTexture(GL_TEXTURE_2D, m_renderConfig.tfTexId);
         glUniform1i(glGetUniformLocation(m_compositeShader, "transferFunction"), 4);
 
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_3D, m_ambientOcclusionTexID);
+        glUniform1i(glGetUniformLocation(m_compositeShader, "ambientOcclusion"), 5);
+
         // we bring the stepsize into normalized volume coordinates
         // first we need the max volume extent
         glm::vec3 volDims = m_pVolume->dims();
@@ -568,14 +588,22 @@ void GPURenderer::renderComposite()
                                                                                                        m_renderConfig.illustrativeParams.y,
                                                                                                        m_renderConfig.illustrativeParams.z,
                                                                                                        m_renderConfig.useOpacityModulation)));
+
+        const bool useAmbientOcclusion = m_renderConfig.ambientOcclusion && m_ambientOcclusionScale != glm::vec3(0.0f);
+        glUniform4fv(glGetUniformLocation(m_compositeShader, "aoParams"), 1, glm::value_ptr(glm::vec4(m_ambientOcclusionScale, useAmbientOcclusion)));
+
         // the reciprocal of the volDims is the voxelSize in 0..1 space
         glm::vec4 volumeInfo = glm::vec4(1.0f / volDims, m_pGPUVolume->useBricking());
         glUniform4fv(glGetUniformLocation(m_compositeShader, "volumeInfo"), 1, glm::value_ptr(volumeInfo));
 
         // Here we provide maximum volume and maximum gradient magnitude for normalization in the shader
         // Note: we actually give the reciprocal, to avoid division in the shader
+        // The gradient magnitude range is computed on a worker thread after loading; do not wait for it here (0 until then).
+        const float invMaxMagnitude = m_pGradientVolume->hasMagnitudeRange() ? 1.0f / m_pGradientVolume->maxMagnitude() : 0.0f;
         glUniform2fv(glGetUniformLocation(m_compositeShader, "volumeMaxValues"), 1, glm::value_ptr(glm::vec2( 1.0f/m_pVolume->maximum(),
-                                                                                                              1.0f/m_pGradientVolume->maxMagnitude())));
+                                                                                                              invMaxMagnitude)));
+        glUniform1f(glGetUniformLocation(m_compositeShader, "volumeValueScale"), m_pGPUVolume->getValueScale());
+        glUniform1f(glGetUniformLocation(m_compositeShader, "volumeValueOffset"), m_pGPUVolume->getValueOffset());
         
         // ======= TODO: IMPLEMENT ========
         //
@@ -590,6 +618,16 @@ void GPURenderer::renderComposite()
         glBindVertexArray(0);
 }
 
+// Upload the ambient occlusion factors after they were (re)computed for a new transfer function
+void GPURenderer::updateAmbientOcclusion(const AmbientOcclusionVolume& ambientOcclusion)
+{
+    const glm::ivec3 dims = ambientOcclusion.dims();
+    glBindTexture(GL_TEXTURE_3D, m_ambientOcclusionTexID);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, dims.x, dims.y, dims.z, 0, GL_RED, GL_FLOAT, ambientOcclusion.data().data());
+    glBindTexture(GL_TEXTURE_3D, 0);
+    m_ambientOcclusionScale = ambientOcclusion.textureScale();
+}
+
 // ======= DO NOT MODIFY THIS FUNCTION ========
 // Note: Only used to pass update events through to the GPU Volume
 // Upate the volume bricks after a tf/iso change or setting the bricksize
@@ -1,11 +1,12 @@
 #pragma once
+#include "render/ambient_occlusion.h"
 #include "ui/opengl.h"
 #include "ui/trackball.h"
 #include "render/render_config.h"
 #include "render/gpu_mesh_config.h"
 #include "volume/gpu_volume.h"
 #include "volume/volume.h"
-#include "volume/gradient_volume.h"
+#include "volume/gradient_provider.h"
 
 
 namespace render {
@@ -16,7 +17,7 @@ public:
     GPURenderer(
         volume::GPUVolume* pGPUVolume,
         const volume::Volume* m_pVolume,
-        const volume::GradientVolume* pGradientVolume,
+        const volume::GradientProvider* pGradientVolume,
         const ui::Trackball* pCamera,
         const RenderConfig& config,
         const GPUMeshConfig& meshConfig);
@@ -37,6 +38,9 @@ public:
 
     void setRenderSize(glm::ivec2 resolution);
 
+    // ambient occlusion
+    void updateAmbientOcclusion(const AmbientOcclusionVolume& ambientOcclusion);
+
     void render();
 
 
@@ -62,7 +66,7 @@ private:
 
     volume::GPUVolume* m_pGPUVolume;
     const volume::Volume* m_pVolume;
-    const volume::GradientVolume* m_pGradientVolume;
+    const volume::GradientProvider* m_pGradientVolume;
     const ui::Trackball* m_pCamera;
     RenderConfig  m_renderConfig {};
     GPUMeshConfig m_meshConfig {};
@@ -76,6 +80,8 @@ private:
 
     GLuint positionsBufferID, positionsTexID;
     GLuint m_blockActiveBufferID, m_blockActiveTexID;
+    GLuint m_ambientOcclusionTexID;
+    glm::vec3 m_ambientOcclusionScale { 0.0f }; // zero until the ambient occlusion texture has been uploaded
 
     glm::vec3 m_numBlocks3D;
     std::vector<glm::vec3> m_positions;
@@ -7,6 +7,7 @@ namespace render {
 struct GPUVolumeConfig {
     int brickSize { 32 };
     bool useVolumeBricking { false };
+    bool useQuantizedVolume { false }; // Upload the block-quantized volume as an 8 bit texture (without bricking only).
 };
 
 // NOTE: should be replaced by C++20 three-way operator (aka spaceship operator) if we require C++ 20 support from Linux users (GCC10 / Clang10).
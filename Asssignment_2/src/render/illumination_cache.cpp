@@ -0,0 +1,204 @@
+#include "illumination_cache.h"
+#include "volume/volume.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <iostream>
+
+// Light directions that differ less than this (cosine of ~1 degree) reuse the current grid.
+static constexpr float lightDirectionTolerance = 0.99985f;
+
+namespace render {
+
+// Maps a volume value to its opacity, the same way as Renderer::getTFValue.
+float TransferFunctionOpacity::opacity(float value) const
+{
+    const int tfSize = int(opacities.size());
+    const float range01 = (value - indexStart) / indexRange;
+    return opacities[size_t(std::clamp(int(range01 * float(tfSize)), 0, tfSize - 1))];
+}
+
+static TransferFunctionOpacity tfOpacityFromConfig(const RenderConfig& config)
+{
+    TransferFunctionOpacity out;
+    for (size_t i = 0; i < out.opacities.size(); i++)
+        out.opacities[i] = config.tfColorMap[i].a;
+    out.indexStart = config.tfColorMapIndexStart;
+    out.indexRange = config.tfColorMapIndexRange;
+    return out;
+}
+
+IlluminationGrid::IlluminationGrid(const glm::ivec3& dim, int downsampleFactor, const glm::vec3& lightDirection, const TransferFunctionOpacity& tfOpacity)
+    : m_dim(dim)
+    , m_invDownsampleFactor(1.0f / float(downsampleFactor))
+    , m_lightDirection(lightDirection)
+    , m_tfOpacity(tfOpacity)
+    , m_data(volume::voxelCount(dim), 0.0f)
+{
+}
+
+glm::vec3 IlluminationGrid::lightDirection() const
+{
+    return m_lightDirection;
+}
+
+const TransferFunctionOpacity& IlluminationGrid::tfOpacity() const
+{
+    return m_tfOpacity;
+}
+
+float IlluminationGrid::getValue(int x, int y, int z) const
+{
+    return m_data[volume::voxelIndex(m_dim, x, y, z)];
+}
+
+// This function returns the trilinearly interpolated lighting factor at a continuous position given in (full resolution) voxel coordinates.
+// Cell centers of the lower resolution grid are located at the centers of the voxel blocks they summarize.
+float IlluminationGrid::getIlluminationInterpolate(const glm::vec3& coord) const
+{
+    const glm::vec3 gridCoord = glm::clamp((coord + 0.5f) * m_invDownsampleFactor - 0.5f, glm::vec3(0.0f), glm::vec3(m_dim - 1));
+    const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(gridCoord), m_dim - 2), glm::ivec3(0));
+    const glm::ivec3 p1 = glm::min(p0 + 1, m_dim - 1);
+    const glm::vec3 f = gridCoord - glm::vec3(p0);
+
+    const float c00 = glm::mix(getValue(p0.x, p0.y, p0.z), getValue(p1.x, p0.y, p0.z), f.x);
+    const float c10 = glm::mix(getValue(p0.x, p1.y, p0.z), getValue(p1.x, p1.y, p0.z), f.x);
+    const float c01 = glm::mix(getValue(p0.x, p0.y, p1.z), getValue(p1.x, p0.y, p1.z), f.x);
+    const float c11 = glm::mix(getValue(p0.x, p1.y, p1.z), getValue(p1.x, p1.y, p1.z), f.x);
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+
+IlluminationCache::IlluminationCache(const volume::Volume* pVolume, const volume::GradientProvider* pGradientVolume, int downsampleFactor, float ambientCoefficient, float diffuseCoefficient, float specularCoefficient, int specularPower)
+    : m_pVolume(pVolume)
+    , m_pGradientVolume(pGradientVolume)
+    , m_downsampleFactor(std::max(downsampleFactor, 1))
+    , m_ambientCoefficient(ambientCoefficient)
+    , m_diffuseCoefficient(diffuseCoefficient)
+    , m_specularCoefficient(specularCoefficient)
+    , m_specularPower(specularPower)
+    , m_worker([this]() { workerLoop(); })
+{
+}
+
+IlluminationCache::~IlluminationCache()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+    }
+    m_wakeUp.notify_one();
+    m_worker.join();
+}
+
+// Schedule a rebuild for the given light direction (pointing from the volume towards the light) and the transfer function
+// of the given config. Requests are coalesced: if several arrive while a build is running only the most recent one is built next.
+void IlluminationCache::requestUpdate(const glm::vec3& lightDirection, const RenderConfig& config)
+{
+    const glm::vec3 L = glm::normalize(lightDirection);
+    const TransferFunctionOpacity tfOpacity = tfOpacityFromConfig(config);
+    {
+        std::lock_guard lock { m_mutex };
+        if (m_hasRequest) {
+            if (glm::dot(m_requestedLightDirection, L) > lightDirectionTolerance && m_requestedTFOpacity == tfOpacity)
+                return;
+        } else if (m_pGrid && glm::dot(m_pGrid->lightDirection(), L) > lightDirectionTolerance && m_pGrid->tfOpacity() == tfOpacity) {
+            return;
+        }
+        m_requestedLightDirection = L;
+        m_requestedTFOpacity = tfOpacity;
+        m_hasRequest = true;
+    }
+    m_wakeUp.notify_one();
+}
+
+// Returns the most recently completed grid, or nullptr if no grid has been built yet.
+std::shared_ptr<const IlluminationGrid> IlluminationCache::snapshot() const
+{
+    std::lock_guard lock { m_mutex };
+    return m_pGrid;
+}
+
+// Incremented every time a new grid becomes available; used by the main loop to trigger a redraw.
+uint64_t IlluminationCache::generation() const
+{
+    return m_generation.load(std::memory_order_acquire);
+}
+
+void IlluminationCache::workerLoop()
+{
+    while (true) {
+        glm::vec3 lightDirection;
+        TransferFunctionOpacity tfOpacity;
+        {
+            std::unique_lock lock { m_mutex };
+            m_wakeUp.wait(lock, [this]() { return m_stop || m_hasRequest; });
+            if (m_stop)
+                return;
+            lightDirection = m_requestedLightDirection;
+            tfOpacity = m_requestedTFOpacity;
+            m_hasRequest = false;
+        }
+
+        std::shared_ptr<const IlluminationGrid> pGrid = build(lightDirection, tfOpacity);
+        {
+            std::lock_guard lock { m_mutex };
+            m_pGrid = std::move(pGrid);
+        }
+        m_generation.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// Compute the Phong lighting factor of every grid cell by averaging it over the block of voxels that the cell covers.
+// The voxels are weighted by their classified opacity: transparent voxels never show up in the image, so their (often
+// arbitrary) gradients should not darken or brighten the visible ones. Cells without any opaque voxel use the plain average.
+// Lighting is two-sided (the normal is flipped towards the light) and voxels without a gradient are black, matching computePhongShading.
+std::shared_ptr<IlluminationGrid> IlluminationCache::build(const glm::vec3& lightDirection, const TransferFunctionOpacity& tfOpacity) const
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    const glm::ivec3 volumeDims = m_pGradientVolume->dims();
+    const glm::ivec3 gridDims = (volumeDims + m_downsampleFactor - 1) / m_downsampleFactor;
+    auto pGrid = std::make_shared<IlluminationGrid>(gridDims, m_downsampleFactor, lightDirection, tfOpacity);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < gridDims.z; z++) {
+        for (int y = 0; y < gridDims.y; y++) {
+            for (int x = 0; x < gridDims.x; x++) {
+                const glm::ivec3 blockBegin = glm::ivec3(x, y, z) * m_downsampleFactor;
+                const glm::ivec3 blockEnd = glm::min(blockBegin + m_downsampleFactor, volumeDims);
+
+                float sum = 0.0f, weightedSum = 0.0f, sumOfWeights = 0.0f;
+                for (int vz = blockBegin.z; vz < blockEnd.z; vz++) {
+                    for (int vy = blockBegin.y; vy < blockEnd.y; vy++) {
+                        for (int vx = blockBegin.x; vx < blockEnd.x; vx++) {
+                            const float weight = tfOpacity.opacity(m_pVolume->getVoxel(vx, vy, vz));
+                            sumOfWeights += weight;
+                            const volume::GradientVoxel gradient = m_pGradientVolume->getGradient(vx, vy, vz);
+                            if (gradient.magnitude <= 0.0f)
+                                continue;
+                            const float NdotL = std::abs(glm::dot(gradient.dir, lightDirection)) / gradient.magnitude;
+                            // The reflection of the light about the normal (R) is compared with the view direction, which is L.
+                            const float RdotL = 2.0f * NdotL * NdotL - 1.0f;
+                            const float specular = std::pow(std::max(RdotL, 0.0f), float(m_specularPower));
+                            const float illumination = m_ambientCoefficient + m_diffuseCoefficient * NdotL + m_specularCoefficient * specular;
+                            sum += illumination;
+                            weightedSum += weight * illumination;
+                        }
+                    }
+                }
+
+                const glm::ivec3 blockSize = blockEnd - blockBegin;
+                pGrid->m_data[volume::voxelIndex(gridDims, x, y, z)] = sumOfWeights > 0.0f ? weightedSum / sumOfWeights : sum / float(blockSize.x * blockSize.y * blockSize.z);
+            }
+        }
+    }
+
+    const auto end = clock::now();
+    std::cout << "IlluminationCache::build() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+    return pGrid;
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "render/render_config.h"
+#include "volume/gradient_provider.h"
+#include "volume/volume.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace render {
+
+// Opacity part of the 1D transfer function, which the voxels of a grid cell are weighted with.
+struct TransferFunctionOpacity {
+    std::array<float, 256> opacities;
+    float indexStart;
+    float indexRange;
+
+    float opacity(float value) const;
+};
+
+inline bool operator==(const TransferFunctionOpacity& lhs, const TransferFunctionOpacity& rhs)
+{
+    return lhs.opacities == rhs.opacities && lhs.indexStart == rhs.indexStart && lhs.indexRange == rhs.indexRange;
+}
+inline bool operator!=(const TransferFunctionOpacity& lhs, const TransferFunctionOpacity& rhs)
+{
+    return !(lhs == rhs);
+}
+
+// A lower resolution grid of precomputed Phong lighting factors for a headlight (a single directional light that shines
+// along the view direction). Multiplying a sample color with the interpolated factor replaces the gradient lookup and the
+// Phong computation. For a headlight the reflection only depends on the angle between the normal and the light, so the
+// specular term is view independent and can be cached too, at the price of highlights blurred over a cell.
+class IlluminationGrid {
+public:
+    IlluminationGrid(const glm::ivec3& dim, int downsampleFactor, const glm::vec3& lightDirection, const TransferFunctionOpacity& tfOpacity);
+
+    float getIlluminationInterpolate(const glm::vec3& coord) const;
+    glm::vec3 lightDirection() const;
+    const TransferFunctionOpacity& tfOpacity() const;
+
+private:
+    float getValue(int x, int y, int z) const;
+
+private:
+    friend class IlluminationCache;
+
+    glm::ivec3 m_dim;
+    float m_invDownsampleFactor;
+    glm::vec3 m_lightDirection;
+    TransferFunctionOpacity m_tfOpacity;
+    std::vector<float> m_data;
+};
+
+// Owns the current IlluminationGrid and rebuilds it on a background thread whenever the light direction or the opacity of
+// the transfer function changes.
+// Renderers take a snapshot() once per frame so that a rebuild finishing halfway a frame does not affect that frame.
+class IlluminationCache {
+public:
+    IlluminationCache(const volume::Volume* pVolume, const volume::GradientProvider* pGradientVolume, int downsampleFactor = 2, float ambientCoefficient = 0.1f, float diffuseCoefficient = 0.7f, float specularCoefficient = 0.2f, int specularPower = 25);
+    ~IlluminationCache();
+
+    IlluminationCache(const IlluminationCache&) = delete;
+    IlluminationCache& operator=(const IlluminationCache&) = delete;
+
+    void requestUpdate(const glm::vec3& lightDirection, const RenderConfig& config);
+    std::shared_ptr<const IlluminationGrid> snapshot() const;
+    uint64_t generation() const;
+
+private:
+    void workerLoop();
+    std::shared_ptr<IlluminationGrid> build(const glm::vec3& lightDirection, const TransferFunctionOpacity& tfOpacity) const;
+
+private:
+    const volume::Volume* m_pVolume;
+    const volume::GradientProvider* m_pGradientVolume;
+    const int m_downsampleFactor;
+    const float m_ambientCoefficient, m_diffuseCoefficient, m_specularCoefficient;
+    const int m_specularPower;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::shared_ptr<const IlluminationGrid> m_pGrid;
+    glm::vec3 m_requestedLightDirection { 0.0f };
+    TransferFunctionOpacity m_requestedTFOpacity {};
+    bool m_hasRequest { false };
+    bool m_stop { false };
+    std::atomic<uint64_t> m_generation { 0 };
+
+    std::thread m_worker;
+};
+
+}
@@ -0,0 +1,101 @@
+#include "quality_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+
+namespace render {
+
+// Quality below which the resolution is reduced, above it only the step size changes.
+static constexpr float stepSizeQualityRange = 0.25f;
+static constexpr float maxStepSizeScale = 2.0f;
+static constexpr float minResolutionScale = 0.25f;
+// The quality only changes when the predicted frame time differs by more than this fraction from the budget.
+static constexpr double budgetTolerance = 0.15;
+// Weight of the newest frame in the running estimate of the full quality frame time.
+static constexpr double measurementWeight = 0.25;
+
+void QualityController::setFrameBudget(std::chrono::duration<double> frameBudget)
+{
+    m_frameBudget = frameBudget;
+}
+
+std::chrono::duration<double> QualityController::frameBudget() const
+{
+    return m_frameBudget;
+}
+
+// Report the render time of a frame and the settings that it was rendered with (as returned by settings(), or the
+// settings of the user for frames that are not rendered during interaction).
+void QualityController::addFrame(std::chrono::duration<double> renderTime, float resolutionScale, float stepSizeScale, bool nearestNeighbour)
+{
+    const int index = nearestNeighbour ? 1 : 0;
+    double& fullQualityTime = m_fullQualityTime[index];
+    const double previous = fullQualityTime;
+    const double measured = renderTime.count() / double(relativeCost(resolutionScale, stepSizeScale));
+    fullQualityTime = previous > 0.0 ? glm::mix(previous, measured, measurementWeight) : measured;
+    // Assume that the cost of the view changed by the same factor with the other interpolation mode.
+    if (previous > 0.0)
+        m_fullQualityTime[1 - index] *= fullQualityTime / previous;
+
+    const double budget = m_frameBudget.count();
+    const double linearTime = m_fullQualityTime[0] > 0.0 ? m_fullQualityTime[0] : fullQualityTime;
+    const double minimumCost = double(relativeCost(minResolutionScale, maxStepSizeScale));
+    if (!m_nearestNeighbour && linearTime * minimumCost > budget * (1.0 + budgetTolerance))
+        m_nearestNeighbour = true;
+    else if (m_nearestNeighbour && linearTime * minimumCost < budget * (1.0 - budgetTolerance))
+        m_nearestNeighbour = false;
+
+    // Without a measurement for nearest neighbour interpolation yet, assume that it is not any faster.
+    const double time = m_nearestNeighbour && m_fullQualityTime[1] > 0.0 ? m_fullQualityTime[1] : linearTime;
+    const QualitySettings current = settingsForQuality(m_quality);
+    const double predicted = time * double(relativeCost(current.resolutionScale, current.stepSizeScale));
+    if (predicted > budget * (1.0 + budgetTolerance) || predicted < budget * (1.0 - budgetTolerance)) {
+        const float target = qualityForCost(float(budget / time));
+        m_quality = std::abs(target - m_quality) < 0.02f ? target : (m_quality + target) / 2.0f;
+    }
+}
+
+QualitySettings QualityController::settings() const
+{
+    QualitySettings settings = settingsForQuality(m_quality);
+    settings.nearestNeighbour = m_nearestNeighbour;
+    return settings;
+}
+
+// The settings for a quality between 0 and 1 (without nearest neighbour interpolation).
+QualitySettings QualityController::settingsForQuality(float quality)
+{
+    quality = std::clamp(quality, 0.0f, 1.0f);
+    QualitySettings settings;
+    settings.quality = quality;
+    settings.stepSizeScale = glm::mix(maxStepSizeScale, 1.0f, std::clamp((quality - (1.0f - stepSizeQualityRange)) / stepSizeQualityRange, 0.0f, 1.0f));
+    settings.resolutionScale = glm::mix(minResolutionScale, 1.0f, std::min(quality / (1.0f - stepSizeQualityRange), 1.0f));
+    return settings;
+}
+
+// Cost of a frame relative to a frame with the settings of the user: proportional to the number of rays and the number
+// of samples per ray.
+float QualityController::relativeCost(float resolutionScale, float stepSizeScale)
+{
+    return resolutionScale * resolutionScale / stepSizeScale;
+}
+
+// The highest quality with at most the given relative cost (the cost increases monotonically with the quality).
+float QualityController::qualityForCost(float cost) const
+{
+    if (cost >= 1.0f)
+        return 1.0f;
+
+    float low = 0.0f, high = 1.0f;
+    for (int i = 0; i < 16; i++) {
+        const float quality = (low + high) / 2.0f;
+        const QualitySettings settings = settingsForQuality(quality);
+        if (relativeCost(settings.resolutionScale, settings.stepSizeScale) > cost)
+            high = quality;
+        else
+            low = quality;
+    }
+    return low;
+}
+
+}
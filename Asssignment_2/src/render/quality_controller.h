@@ -0,0 +1,46 @@
+#pragma once
+#include <chrono>
+
+namespace render {
+
+// Settings of the next frame rendered during interaction, relative to the settings chosen by the user.
+struct QualitySettings {
+    float quality { 1.0f }; // From 0 (cheapest) to 1 (the settings of the user).
+    float resolutionScale { 1.0f }; // Of the width and height of the image.
+    float stepSizeScale { 1.0f };
+    bool nearestNeighbour { false }; // Use nearest neighbour interpolation, whatever the user selected.
+};
+
+// Chooses the quality of the frames rendered during interaction such that they take a configurable time (the frame budget).
+// The time that a frame with the settings of the user would take is estimated from the render times of recent frames,
+// divided by the relative cost of the settings that they were rendered with (proportional to the number of samples).
+// Lowering the quality first increases the step size (up to twice the step size of the user), then continuously reduces
+// the resolution (down to a quarter of the width and height). If even that does not fit the budget, nearest neighbour
+// interpolation is used as well; the render times with and without it are tracked separately.
+//
+// To prevent oscillation the quality only changes when the predicted frame time leaves a band around the budget, it
+// moves only halfway to the quality that fits the budget per frame, and nearest neighbour interpolation is only turned off
+// again once the lowest quality fits well within the budget.
+class QualityController {
+public:
+    void setFrameBudget(std::chrono::duration<double> frameBudget);
+    std::chrono::duration<double> frameBudget() const;
+
+    void addFrame(std::chrono::duration<double> renderTime, float resolutionScale, float stepSizeScale, bool nearestNeighbour);
+    QualitySettings settings() const;
+
+    static QualitySettings settingsForQuality(float quality);
+    static float relativeCost(float resolutionScale, float stepSizeScale);
+
+private:
+    float qualityForCost(float cost) const;
+
+private:
+    std::chrono::duration<double> m_frameBudget { 1.0 / 60.0 };
+    // Estimated time of a frame with the settings of the user, with trilinear [0] and nearest neighbour [1] interpolation.
+    double m_fullQualityTime[2] { 0.0, 0.0 };
+    float m_quality { 1.0f };
+    bool m_nearestNeighbour { false };
+};
+
+}
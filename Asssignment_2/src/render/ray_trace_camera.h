@@ -2,6 +2,8 @@
 #include "ray.h"
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <memory>
+#include <optional>
 
 namespace render {
 
@@ -13,6 +15,12 @@ public:
     virtual glm::vec3 forward() const = 0;
 
     virtual render::Ray generateRay(const glm::vec2& pixel) const = 0;
+    // Inverse of generateRay(): the pixel (in NDC space) whose ray passes through the given point, or nothing if the
+    // point is behind the camera.
+    virtual std::optional<glm::vec2> project(const glm::vec3& point) const = 0;
+
+    // Copy of the current camera state, for renderers that run on another thread than the one that moves the camera.
+    virtual std::unique_ptr<RayTraceCamera> clone() const = 0;
 };
 
 }
\ No newline at end of file
@@ -14,22 +14,66 @@ enum class RenderMode {
     RenderSlicer = 0,
     RenderMIP = 1,
     RenderIso = 2,
-    RenderComposite = 3
+    RenderComposite = 3,
+    RenderTF2D = 4,
+    RenderSlab = 5
+};
+
+// How the samples inside the slab are combined in thick-slab mode.
+enum class SlabProjection {
+    Maximum = 0,
+    Minimum = 1,
+    Average = 2
 };
 
 struct RenderConfig {
     RenderMode renderMode { RenderMode::RenderSlicer };
     glm::ivec2 renderResolution;
     float stepSize { 1.0f };
+    // Once the view stops changing, refine the image over successive frames (coarse blocks first, then every pixel,
+    // then this many jittered samples per pixel in total) instead of rendering it at once.
+    bool progressiveRefinement { false };
+    int progressiveSamples { 16 };
+    // Trace only the corners of blocks of pixels and interpolate the pixels in between, unless the corner colors differ by
+    // more than the threshold (in which case the block is subdivided). Used when rendering a frame at once.
+    bool adaptiveSampling { false };
+    float adaptiveThreshold { 0.05f };
+    // While the camera moves, trace only one in interleaveFactor (2 or 4) pixels per frame at full resolution and
+    // reproject the others from the previous frame, instead of lowering the resolution.
+    bool interleavedRendering { false };
+    int interleaveFactor { 2 };
+    // Trace the rays of a tile brick by brick instead of one ray at a time (MIP and compositing only), see
+    // Renderer::renderTileBricked(). Used when rendering a frame at once.
+    bool brickOrderedTracing { false };
+    // Also write every pixel as 8-bit RGBA (see Renderer::compactFrameBuffer()), which is a quarter of the data to upload
+    // for display. The float framebuffer is still written, refinement and reprojection read it back.
+    bool compactFrameBuffer { false };
+    // Show the MIP, isosurface and compositing images of the view side by side (the render mode is ignored). The three
+    // images are rendered at once by Renderer::renderFused(), each at half the render resolution.
+    bool fusedView { false };
 
     bool volumeShading { false };
+    // Replace per-sample Phong shading by a lookup into a precomputed (headlight) illumination grid at half the volume
+    // resolution. Much cheaper, but the lighting (including the highlights) is averaged over blocks of 2^3 voxels, which
+    // blurs small details, and it is computed for the direction of the camera instead of for every ray.
+    bool useIlluminationCache { false };
+    bool ambientOcclusion { false }; // Darken compositing samples by the local ambient occlusion of the classified volume.
     bool clippingPlanes { false };
+    // Only the part of the volume inside this box (as fractions of the volume dimensions) is rendered.
+    glm::vec3 cropMin { 0.0f };
+    glm::vec3 cropMax { 1.0f };
 
     bool useOpacityModulation {false };
     glm::vec4 illustrativeParams { glm::vec4(0.0, 1.0, 1.0, 1.0) };
     
     bool updateTF { false }; // Used in the main loop to know when the TF should be updated. Defined as a parameter instead of a callback since the TF is already in this struct and seperating it would make thing more complex in other parts of the code
 
+    // Thick-slab projection (RenderSlab) of the part of the volume between two planes perpendicular to the viewing
+    // direction: the slab is slabThickness voxels thick and its center is slabOffset voxels in front of the volume center.
+    SlabProjection slabProjection { SlabProjection::Maximum };
+    float slabOffset { 0.0f };
+    float slabThickness { 10.0f };
+
     float isoValue { 95.0f };
     bool bisection { false };
     
@@ -42,6 +86,11 @@ struct RenderConfig {
     float tfColorMapIndexStart;
     float tfColorMapIndexRange;
     GLuint tfTexId; 
+
+    // 2D transfer function.
+    float TF2DIntensity;
+    float TF2DRadius;
+    glm::vec4 TF2DColor;
 };
 
 // NOTE(Mathijs): should be replaced by C++20 three-way operator (aka spaceship operator) if we require C++ 20 support from Linux users (GCC10 / Clang10).
@@ -1,22 +1,136 @@
 #include "renderer.h"
 #include <algorithm>
 #include <algorithm> // std::fill
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <fstream>
 #include <functional>
 #include <glm/common.hpp>
 #include <glm/gtx/component_wise.hpp>
 #include <iostream>
+#include <limits>
+#include <chrono>
 #include <tuple>
 
+// Size (in pixels) of the tiles that the image is rendered in.
+static constexpr int tileSize = 16;
+// Progressive refinement starts with blocks of 8x8 pixels and halves them until they are a single pixel (4 passes).
+static constexpr int refinementBlockSize = 8;
+static constexpr int numCoarseRefinementPasses = 4;
+// Adaptive sampling starts with blocks of 8x8 pixels, of which only the corners are traced.
+static constexpr int adaptiveBlockSize = 8;
+// Color of the isosurface of renderFused(), the same as the one of traceRayISO().
+static constexpr glm::vec3 fusedIsoColor { 0.8f, 0.8f, 0.2f };
+// Size (in voxels) of the bricks that brick-ordered tracing processes the rays of a tile in (128KB of float voxels).
+static constexpr int traversalBrickSize = 32;
+
+// 0 = sequential (single-core), 1 = OMP (multi-core)
+#ifdef NDEBUG
+// If NOT in debug mode then enable parallelism using the Open MP
+#define PARALLELISM 1
+#else
+// Disable multi threading in debug mode.
+#define PARALLELISM 0
+#endif
+
+// Depth of pixels whose ray misses the volume.
+static constexpr float missDepth = std::numeric_limits<float>::max();
+
+// Convert a color to 8-bit RGBA, with red in the lowest byte (GL_RGBA with GL_UNSIGNED_INT_8_8_8_8_REV).
+static uint32_t packColor(const glm::vec4& color)
+{
+    const glm::vec4 scaled = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return uint32_t(scaled.r) | (uint32_t(scaled.g) << 8) | (uint32_t(scaled.b) << 16) | (uint32_t(scaled.a) << 24);
+}
+
+// Whether a pixel is traced in the given frame of interleaved rendering (see Renderer::renderInterleaved()).
+static bool isInterleavedPixelTraced(int x, int y, int interleaveFactor, int phase)
+{
+    if (interleaveFactor == 2)
+        return (x + y + phase) % 2 == 0;
+    // Every second frame traces the pixel of the 2x2 block diagonally opposite the previous one.
+    constexpr int order[4] = { 0, 3, 1, 2 };
+    return (x % 2) + 2 * (y % 2) == order[phase];
+}
+
+// Van der Corput sequence in the given base, used for the sample positions of progressive refinement (Halton sequence).
+static float radicalInverse(int index, int base)
+{
+    float result = 0.0f;
+    float digitWeight = 1.0f / float(base);
+    for (; index > 0; index /= base, digitWeight /= float(base))
+        result += float(index % base) * digitWeight;
+    return result;
+}
+
 namespace render {
 
+// Distance along the ray at which it leaves the given brick (of brickSize voxels), or ray.tmax if that comes first.
+static float brickExit(const Ray& ray, const glm::ivec3& brick, int brickSize)
+{
+    const glm::vec3 lower = glm::vec3(brick * brickSize);
+    const glm::vec3 upper = lower + float(brickSize);
+
+    float tExit = ray.tmax;
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.direction[axis] > 0.0f)
+            tExit = std::min(tExit, (upper[axis] - ray.origin[axis]) / ray.direction[axis]);
+        else if (ray.direction[axis] < 0.0f)
+            tExit = std::min(tExit, (lower[axis] - ray.origin[axis]) / ray.direction[axis]);
+    }
+    return tExit;
+}
+
+// Generates the rays of a rectangle of pixels (the tile) of a larger image, so that a Renderer can render that image one
+// tile at a time. The horizontal NDC coordinates are multiplied by aspectScale, which widens (or narrows) the field of view
+// of the camera when the image has another aspect ratio than the camera.
+class TileCamera : public RayTraceCamera {
+public:
+    TileCamera(const RayTraceCamera* pCamera, const glm::ivec2& imageResolution, const glm::ivec2& tileOffset, const glm::ivec2& tileResolution, float aspectScale)
+        : m_pCamera(pCamera)
+        , m_imageResolution(imageResolution)
+        , m_tileOffset(tileOffset)
+        , m_tileResolution(tileResolution)
+        , m_aspectScale(aspectScale)
+    {
+    }
+
+    glm::vec3 position() const override { return m_pCamera->position(); }
+    glm::vec3 forward() const override { return m_pCamera->forward(); }
+
+    render::Ray generateRay(const glm::vec2& pixel) const override
+    {
+        const glm::vec2 imagePixel = (pixel + 1.0f) / 2.0f * glm::vec2(m_tileResolution) + glm::vec2(m_tileOffset);
+        const glm::vec2 imageNDC = imagePixel / glm::vec2(m_imageResolution) * 2.0f - 1.0f;
+        return m_pCamera->generateRay(glm::vec2(imageNDC.x * m_aspectScale, imageNDC.y));
+    }
+
+    std::optional<glm::vec2> project(const glm::vec3& point) const override
+    {
+        const std::optional<glm::vec2> optImagePos = m_pCamera->project(point);
+        if (!optImagePos)
+            return {};
+        const glm::vec2 imageNDC { optImagePos->x / m_aspectScale, optImagePos->y };
+        const glm::vec2 tilePixel = (imageNDC + 1.0f) / 2.0f * glm::vec2(m_imageResolution) - glm::vec2(m_tileOffset);
+        return tilePixel / glm::vec2(m_tileResolution) * 2.0f - 1.0f;
+    }
+
+    std::unique_ptr<RayTraceCamera> clone() const override { return std::make_unique<TileCamera>(*this); }
+
+private:
+    const RayTraceCamera* m_pCamera;
+    glm::ivec2 m_imageResolution, m_tileOffset, m_tileResolution;
+    float m_aspectScale;
+};
+
 // The renderer is passed a pointer to the volume, gradinet volume, camera and an initial renderConfig.
 // The camera being pointed to may change each frame (when the user interacts). When the renderConfig
 // changes the setConfig function is called with the updated render config. This gives the Renderer an
 // opportunity to resize the framebuffer.
 Renderer::Renderer(
-    const volume::Volume* pVolume,
-    const volume::GradientVolume* pGradientVolume,
+    const volume::VolumeSampler* pVolume,
+    const volume::GradientProvider* pGradientVolume,
     const render::RayTraceCamera* pCamera,
     const RenderConfig& initialConfig)
     : m_pVolume(pVolume)
@@ -30,22 +144,63 @@ Renderer::Renderer(
 // Set a new render config if the user changed the settings.
 void Renderer::setConfig(const RenderConfig& config)
 {
-    if (config.renderResolution != m_config.renderResolution)
-        resizeImage(config.renderResolution);
+    const bool resize = config.renderResolution != m_config.renderResolution || config.compactFrameBuffer != m_config.compactFrameBuffer;
+
+    // The 2D transfer function tables only depend on the widget (the color is applied per sample).
+    if (config.TF2DIntensity != m_config.TF2DIntensity || config.TF2DRadius != m_config.TF2DRadius || config.TF2DColor.a != m_config.TF2DColor.a)
+        m_tf2DTablesOutdated = true;
+
+    // The previous frame can only be reprojected if it was rendered with the same settings.
+    if (!(config == m_config))
+        m_pHistoryCamera = nullptr;
+    // The pixels of thick-slab mode are updated incrementally if only the slab changed.
+    RenderConfig slabConfig = config;
+    slabConfig.slabProjection = m_config.slabProjection;
+    slabConfig.slabOffset = m_config.slabOffset;
+    slabConfig.slabThickness = m_config.slabThickness;
+    if (!(slabConfig == m_config))
+        m_slabStateValid = false;
 
     m_config = config;
+    if (resize)
+        resizeImage(config.renderResolution);
+}
+
+// Set the camera that generates the rays of the next frames. It is owned by the caller.
+void Renderer::setCamera(const render::RayTraceCamera* pCamera)
+{
+    m_pCamera = pCamera;
+}
+
+// Set the (optional) illumination cache that replaces per-sample Phong shading in compositing mode.
+// The cache is owned by the caller and must outlive the renderer (or be reset to nullptr first).
+void Renderer::setIlluminationCache(IlluminationCache* pIlluminationCache)
+{
+    m_pIlluminationCache = pIlluminationCache;
+}
+
+// Set the (optional) ambient occlusion volume used in compositing mode. It is owned by the caller, which is also
+// responsible for updating it when the transfer function changes.
+void Renderer::setAmbientOcclusionVolume(const AmbientOcclusionVolume* pAmbientOcclusion)
+{
+    m_pAmbientOcclusion = pAmbientOcclusion;
 }
 
 // Resize the framebuffer and fill it with black pixels.
 void Renderer::resizeImage(const glm::ivec2& resolution)
 {
-    m_frameBuffer.resize(size_t(resolution.x) * size_t(resolution.y), glm::vec4(0.0f));
+    m_frameBuffer.resize(size_t(resolution.x) * size_t(resolution.y));
+    m_compactFrameBuffer.resize(m_config.compactFrameBuffer ? m_frameBuffer.size() : 0);
+    m_pHistoryCamera = nullptr;
+    resetImage();
 }
 
-// Clear the framebuffer by setting all pixels to black.
+// Clear the framebuffer by setting all pixels to black. This is done by all threads, which also makes sure that
+// the pages of a newly allocated framebuffer are placed on the NUMA nodes of the rendering threads.
 void Renderer::resetImage()
 {
-    std::fill(std::begin(m_frameBuffer), std::end(m_frameBuffer), glm::vec4(0.0f));
+    util::parallelFill<glm::vec4>(m_frameBuffer, glm::vec4(0.0f));
+    util::parallelFill<uint32_t>(m_compactFrameBuffer, 0);
 }
 
 // Return a VIEW into the framebuffer. This view is merely a reference to the m_frameBuffer member variable.
@@ -55,65 +210,819 @@ gsl::span<const glm::vec4> Renderer::frameBuffer() const
     return m_frameBuffer;
 }
 
+// Exchange the framebuffer with another buffer (e.g. the one on screen), so that a finished frame can be handed off
+// without copying it. The buffer that the renderer receives is resized to the render resolution.
+void Renderer::swapFrameBuffer(util::AlignedVector<glm::vec4>& frameBuffer)
+{
+    std::swap(m_frameBuffer, frameBuffer);
+    m_frameBuffer.resize(size_t(m_config.renderResolution.x) * size_t(m_config.renderResolution.y));
+}
+
+// Return a VIEW into the 8-bit framebuffer (empty unless compactFrameBuffer is enabled in the config).
+gsl::span<const uint32_t> Renderer::compactFrameBuffer() const
+{
+    return m_compactFrameBuffer;
+}
+
+// Exchange the 8-bit framebuffer with another buffer, see swapFrameBuffer().
+void Renderer::swapCompactFrameBuffer(util::AlignedVector<uint32_t>& compactFrameBuffer)
+{
+    std::swap(m_compactFrameBuffer, compactFrameBuffer);
+    m_compactFrameBuffer.resize(m_config.compactFrameBuffer ? m_frameBuffer.size() : 0);
+}
+
 // Main render function. It computes an image according to the current renderMode.
 // Multithreading is enabled in Release/RelWithDebInfo modes. In Debug mode multithreading is disabled to make debugging easier.
-void Renderer::render()
+// The image is rendered in tiles, which are handed out to the threads dynamically (the cost of a tile depends on how much
+// of the volume it covers). If pCancel is set during rendering the remaining tiles are skipped and false is returned.
+bool Renderer::render(const std::atomic_bool* pCancel)
 {
     resetImage();
 
     const glm::vec3 planeNormal = -glm::normalize(m_pCamera->forward());
     const glm::vec3 volumeCenter = glm::vec3(m_pVolume->dims()) / 2.0f;
-    const Bounds bounds {glm::vec3(0.0f),  glm::vec3(m_pVolume->dims() - glm::ivec3(1))};
+    const Bounds bounds = cropBounds();
+    updateIlluminationGrid();
+    updateTF2DTables();
+    // Interleaved rendering reprojects the frame, which needs the depth of every pixel.
+    const bool storeDepth = m_config.interleavedRendering && !m_config.adaptiveSampling;
+    if (storeDepth)
+        m_depthBuffer.resize(m_frameBuffer.size());
+    const bool brickOrdered = m_config.brickOrderedTracing && (m_config.renderMode == RenderMode::RenderMIP || m_config.renderMode == RenderMode::RenderComposite);
+    const bool slab = m_config.renderMode == RenderMode::RenderSlab;
+    if (slab)
+        updateSlabView();
+    const bool incrementalSlab = m_slabStateValid;
 
-    // 0 = sequential (single-core), 1 = OMP (multi-core)
-#ifdef NDEBUG
-    // If NOT in debug mode then enable parallelism using the Open MP
-#define PARALLELISM 1
-#else
-    // Disable multi threading in debug mode.
-#define PARALLELISM 0
+    const glm::ivec2 numTiles = (m_config.renderResolution + tileSize - 1) / tileSize;
+    const int numTilesTotal = numTiles.x * numTiles.y;
+#if PARALLELISM == 1
+    #pragma omp parallel for schedule(dynamic)
 #endif
+    for (int tile = 0; tile < numTilesTotal; tile++) {
+        if (pCancel && pCancel->load(std::memory_order_relaxed))
+            continue;
+
+        const glm::ivec2 tileStart = glm::ivec2(tile % numTiles.x, tile / numTiles.x) * tileSize;
+        if (slab) {
+            renderTileSlab(tileStart, bounds, volumeCenter, planeNormal, storeDepth, incrementalSlab);
+            continue;
+        }
+        if (m_config.adaptiveSampling) {
+            renderTileAdaptive(tileStart, bounds, volumeCenter, planeNormal);
+            continue;
+        }
+        if (brickOrdered) {
+            renderTileBricked(tileStart, bounds, volumeCenter, planeNormal, storeDepth);
+            continue;
+        }
+
+        const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, m_config.renderResolution);
+        for (int y = tileStart.y; y < tileEnd.y; y++) {
+            for (int x = tileStart.x; x < tileEnd.x; x++) {
+                // Compute a ray for the current pixel.
+                const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(m_config.renderResolution);
+                const Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+                // Write the resulting color to the screen.
+                float* pDepth = storeDepth ? &m_depthBuffer[size_t(m_config.renderResolution.x) * size_t(y) + size_t(x)] : nullptr;
+                fillColor(x, y, traceRay(ray, bounds, volumeCenter, planeNormal, pDepth));
+            }
+        }
+    }
+    // A cancelled frame leaves the slab state as valid as it was: the pixels that were not rendered yet still hold the
+    // state of the previous frame, which only belongs to the current view if this frame was incremental.
+    if (pCancel && pCancel->load())
+        return false;
+    if (slab)
+        m_slabStateValid = true;
 
+    if (storeDepth)
+        storeReprojectionHistory();
+    else
+        m_pHistoryCamera = nullptr;
+    return true;
+}
+
+// Interleaved rendering, for while the camera moves. Only one in m_config.interleaveFactor pixels is traced (a checkerboard
+// pattern for 2, one pixel of every 2x2 block for 4) and the pattern shifts every frame. The other pixels are reprojected
+// from the previous frame: the depth of a pixel is estimated from its traced neighbours, and the point at that depth is
+// looked up in the previous frame. If the previous frame did not see that point (it was outside of the image, or hidden
+// behind something else) the colors of the traced neighbours are averaged instead.
+// Without a previous frame (e.g. after the settings changed) the frame is rendered completely.
+bool Renderer::renderInterleaved(const std::atomic_bool* pCancel)
+{
+    if (!m_pHistoryCamera)
+        return render(pCancel);
+
+    const glm::vec3 planeNormal = -glm::normalize(m_pCamera->forward());
+    const glm::vec3 volumeCenter = glm::vec3(m_pVolume->dims()) / 2.0f;
+    const Bounds bounds = cropBounds();
+    updateIlluminationGrid();
+    updateTF2DTables();
+
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const int interleaveFactor = m_config.interleaveFactor >= 4 ? 4 : 2;
+    m_interleavePhase = (m_interleavePhase + 1) % interleaveFactor;
+    const int phase = m_interleavePhase;
+
+    const glm::ivec2 numTiles = (resolution + tileSize - 1) / tileSize;
+    const int numTilesTotal = numTiles.x * numTiles.y;
 #if PARALLELISM == 1
-    #pragma omp parallel for
+    #pragma omp parallel for schedule(dynamic)
 #endif
-    for (int x = 0; x < m_config.renderResolution.x; x++) {
-        for (int y = 0; y < m_config.renderResolution.y; y++) {
+    for (int tile = 0; tile < numTilesTotal; tile++) {
+        if (pCancel && pCancel->load(std::memory_order_relaxed))
+            continue;
 
-            // Compute a ray for the current pixel.
-            const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(m_config.renderResolution);
-            Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+        const glm::ivec2 tileStart = glm::ivec2(tile % numTiles.x, tile / numTiles.x) * tileSize;
+        const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, resolution);
+        for (int y = tileStart.y; y < tileEnd.y; y++) {
+            for (int x = tileStart.x; x < tileEnd.x; x++) {
+                if (!isInterleavedPixelTraced(x, y, interleaveFactor, phase))
+                    continue;
+
+                const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(resolution);
+                const size_t index = size_t(resolution.x) * size_t(y) + size_t(x);
+                fillColor(index, traceRay(m_pCamera->generateRay(pixelPos * 2.0f - 1.0f), bounds, volumeCenter, planeNormal, &m_depthBuffer[index]));
+            }
+        }
+    }
+    if (pCancel && pCancel->load())
+        return false;
 
-            // Compute where the ray enters and exists the volume.
-            // If the ray misses the volume then we continue to the next pixel.
-            if (!instersectRayVolumeBounds(ray, bounds))
+    // The depth estimate of a pixel is only accurate up to the distance between neighbouring pixels.
+    const float tolerance = std::max(4.0f * m_config.stepSize, 2.0f);
+#if PARALLELISM == 1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < resolution.y; y++) {
+        for (int x = 0; x < resolution.x; x++) {
+            if (isInterleavedPixelTraced(x, y, interleaveFactor, phase))
                 continue;
 
-            // Get a color for the current pixel according to the current render mode.
-            glm::vec4 color {};
-            switch (m_config.renderMode) {
-            case RenderMode::RenderSlicer: {
-                color = traceRaySlice(ray, volumeCenter, planeNormal);
-                break;
+            // Take the nearest depth of the traced neighbours, so that pixels on the silhouette reproject the foreground.
+            glm::vec4 colorSum { 0.0f };
+            int numNeighbours = 0;
+            float depth = missDepth;
+            for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, resolution.y - 1); ny++) {
+                for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, resolution.x - 1); nx++) {
+                    if (!isInterleavedPixelTraced(nx, ny, interleaveFactor, phase))
+                        continue;
+
+                    const size_t neighbour = size_t(resolution.x) * size_t(ny) + size_t(nx);
+                    colorSum += m_frameBuffer[neighbour];
+                    depth = std::min(depth, m_depthBuffer[neighbour]);
+                    numNeighbours++;
+                }
+            }
+
+            const size_t index = size_t(resolution.x) * size_t(y) + size_t(x);
+            const std::optional<glm::vec4> optReprojected = reprojectPixel(glm::ivec2(x, y), depth, tolerance);
+            fillColor(index, optReprojected ? *optReprojected : (numNeighbours > 0 ? colorSum / float(numNeighbours) : glm::vec4(0.0f)));
+            m_depthBuffer[index] = depth;
+        }
+    }
+
+    storeReprojectionHistory();
+    return true;
+}
+
+// Render the current view in MIP, isosurface and compositing mode at once (e.g. to show them side by side), see
+// fusedFrameBuffer(). Every ray samples the volume once and every sample is used by all three modes, instead of rendering
+// the view three times. The settings of the current render mode (m_config.renderMode) are ignored. Returns false if the
+// frame was cancelled.
+bool Renderer::renderFused(const std::atomic_bool* pCancel)
+{
+    for (util::AlignedVector<glm::vec4>* pFrameBuffer : { &m_fusedMIPFrameBuffer, &m_fusedIsoFrameBuffer, &m_fusedCompositeFrameBuffer })
+        pFrameBuffer->resize(m_frameBuffer.size());
+
+    const Bounds bounds = cropBounds();
+    updateIlluminationGrid();
+    updateTF2DTables();
+
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const glm::ivec2 numTiles = (resolution + tileSize - 1) / tileSize;
+    const int numTilesTotal = numTiles.x * numTiles.y;
+#if PARALLELISM == 1
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int tile = 0; tile < numTilesTotal; tile++) {
+        if (pCancel && pCancel->load(std::memory_order_relaxed))
+            continue;
+
+        const glm::ivec2 tileStart = glm::ivec2(tile % numTiles.x, tile / numTiles.x) * tileSize;
+        const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, resolution);
+        for (int y = tileStart.y; y < tileEnd.y; y++) {
+            for (int x = tileStart.x; x < tileEnd.x; x++) {
+                const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(resolution);
+                Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+                const FusedColors colors = instersectRayVolumeBounds(ray, bounds) ? traceRayFused(ray) : FusedColors { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+                const size_t index = size_t(resolution.x) * size_t(y) + size_t(x);
+                m_fusedMIPFrameBuffer[index] = colors.mip;
+                m_fusedIsoFrameBuffer[index] = colors.iso;
+                m_fusedCompositeFrameBuffer[index] = colors.composite;
+            }
+        }
+    }
+    return !(pCancel && pCancel->load());
+}
+
+// Return a VIEW into the image of the given render mode of the last renderFused() call (empty for other render modes).
+gsl::span<const glm::vec4> Renderer::fusedFrameBuffer(RenderMode renderMode) const
+{
+    switch (renderMode) {
+    case RenderMode::RenderMIP:
+        return m_fusedMIPFrameBuffer;
+    case RenderMode::RenderIso:
+        return m_fusedIsoFrameBuffer;
+    case RenderMode::RenderComposite:
+        return m_fusedCompositeFrameBuffer;
+    default:
+        return {};
+    }
+}
+
+// Render an image of the given resolution with the current camera and settings, and write it to a binary PPM file.
+// The image is rendered in strips of stripHeight rows (using all threads for every strip), which are written to the file
+// as soon as they are finished, so memory use does not depend on the height of the image. This makes it possible to
+// render images that are far larger than the screen (e.g. for printing). The camera keeps its vertical field of view, which
+// was set up for the current render resolution, and the horizontal one follows the aspect ratio of the image.
+// The fraction of the rows that is written is stored in pProgress (if given) after every strip, and if pCancel is set the
+// remaining strips are skipped. Returns false if the file could not be written or the poster was cancelled.
+bool Renderer::renderPoster(const glm::ivec2& resolution, const std::filesystem::path& file, int stripHeight, const std::atomic_bool* pCancel, std::atomic<float>* pProgress)
+{
+    std::ofstream out { file, std::ios::binary };
+    if (!out)
+        return false;
+    out << "P6\n" << resolution.x << " " << resolution.y << "\n255\n";
+
+    const RayTraceCamera* pCamera = m_pCamera;
+    const RenderConfig config = m_config;
+    const float cameraAspect = float(config.renderResolution.x) / float(config.renderResolution.y);
+    const float aspectScale = float(resolution.x) / float(resolution.y) / cameraAspect;
+    RenderConfig stripConfig = config;
+    stripConfig.progressiveRefinement = false;
+    stripConfig.interleavedRendering = false;
+    stripConfig.compactFrameBuffer = false;
+
+    std::vector<uint8_t> row(size_t(resolution.x) * 3);
+    bool cancelled = false;
+    // PPM rows go from the top to the bottom of the image, framebuffer rows from the bottom to the top.
+    for (int stripEnd = resolution.y; stripEnd > 0 && out; stripEnd -= stripHeight) {
+        const int stripStart = std::max(stripEnd - stripHeight, 0);
+        const TileCamera stripCamera { pCamera, resolution, glm::ivec2(0, stripStart), glm::ivec2(resolution.x, stripEnd - stripStart), aspectScale };
+        stripConfig.renderResolution = glm::ivec2(resolution.x, stripEnd - stripStart);
+        m_pCamera = &stripCamera;
+        setConfig(stripConfig);
+        if (!render(pCancel)) {
+            cancelled = true;
+            break;
+        }
+
+        for (int y = stripConfig.renderResolution.y - 1; y >= 0; y--) {
+            const glm::vec4* pPixels = m_frameBuffer.data() + size_t(resolution.x) * size_t(y);
+            for (size_t x = 0; x < size_t(resolution.x); x++) {
+                for (int c = 0; c < 3; c++)
+                    row[3 * x + size_t(c)] = uint8_t(std::clamp(pPixels[x][c], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+            out.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size()));
+        }
+        if (pProgress)
+            *pProgress = float(resolution.y - stripStart) / float(resolution.y);
+    }
+
+    m_pCamera = pCamera;
+    setConfig(config);
+    return bool(out) && !cancelled;
+}
+
+// Forget the previous frame, e.g. because the volume changed in a way that the render settings do not show. This also
+// makes thick-slab mode compute its pixels from scratch.
+void Renderer::resetReprojectionHistory()
+{
+    m_pHistoryCamera = nullptr;
+    m_slabStateValid = false;
+}
+
+// Keep the finished frame, its depth and its camera for reprojecting the next frame.
+void Renderer::storeReprojectionHistory()
+{
+    m_historyFrameBuffer.assign(std::begin(m_frameBuffer), std::end(m_frameBuffer));
+    std::swap(m_historyDepthBuffer, m_depthBuffer);
+    m_depthBuffer.resize(m_historyDepthBuffer.size());
+    m_pHistoryCamera = m_pCamera->clone();
+}
+
+// Color of the previous frame at the point where the ray through the given pixel reaches the given depth, or nothing if
+// the previous frame did not see that point (within the tolerance).
+std::optional<glm::vec4> Renderer::reprojectPixel(const glm::ivec2& pixel, float depth, float tolerance) const
+{
+    if (depth == missDepth)
+        return {};
+
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const Ray ray = m_pCamera->generateRay(glm::vec2(pixel) / glm::vec2(resolution) * 2.0f - 1.0f);
+    const glm::vec3 point = ray.origin + depth * ray.direction;
+    const std::optional<glm::vec2> optHistoryPos = m_pHistoryCamera->project(point);
+    if (!optHistoryPos)
+        return {};
+
+    const glm::ivec2 historyPixel = glm::ivec2(glm::floor((*optHistoryPos + 1.0f) / 2.0f * glm::vec2(resolution) + 0.5f));
+    if (glm::any(glm::lessThan(historyPixel, glm::ivec2(0))) || glm::any(glm::greaterThanEqual(historyPixel, resolution)))
+        return {};
+
+    const size_t historyIndex = size_t(resolution.x) * size_t(historyPixel.y) + size_t(historyPixel.x);
+    const float historyDepth = m_historyDepthBuffer[historyIndex];
+    if (historyDepth == missDepth)
+        return {};
+
+    const Ray historyRay = m_pHistoryCamera->generateRay(glm::vec2(historyPixel) / glm::vec2(resolution) * 2.0f - 1.0f);
+    if (glm::distance(historyRay.origin + historyDepth * historyRay.direction, point) > tolerance)
+        return {};
+    return m_historyFrameBuffer[historyIndex];
+}
+
+// Adaptive sampling of a tile. The tile is split into blocks of adaptiveBlockSize pixels and the rays through the corners of
+// every block are traced. A block whose corner colors differ by more than the threshold (in any channel) is split into four
+// blocks, the pixels of the other blocks are interpolated bilinearly from their corners. Neighbouring blocks share their
+// corners, so within a tile every ray is traced at most once.
+void Renderer::renderTileAdaptive(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal)
+{
+    const glm::ivec2 resolution = m_config.renderResolution;
+    // Blocks on the right and bottom border of the tile use the first column/row of the next tile as their corners.
+    constexpr size_t cornersPerRow = size_t(tileSize) + 1;
+    const glm::ivec2 lastCorner = glm::min(glm::ivec2(tileSize), resolution - 1 - tileStart);
+    std::array<glm::vec4, cornersPerRow * cornersPerRow> corners;
+    std::array<bool, cornersPerRow * cornersPerRow> traced {};
+    // Color of the ray through the given pixel (relative to the tile).
+    const auto sample = [&](int x, int y) -> glm::vec4 {
+        const size_t index = size_t(y) * cornersPerRow + size_t(x);
+        if (!traced[index]) {
+            const glm::vec2 pixelPos = glm::vec2(tileStart + glm::ivec2(x, y)) / glm::vec2(resolution);
+            corners[index] = traceRay(m_pCamera->generateRay(pixelPos * 2.0f - 1.0f), bounds, volumeCenter, planeNormal);
+            traced[index] = true;
+        }
+        return corners[index];
+    };
+
+    // Blocks (x, y, size) that still have to be processed. Every split replaces a block by four, so the stack never holds
+    // more than 3 blocks per level of subdivision (plus the initial blocks).
+    std::array<glm::ivec3, 16> stack;
+    size_t stackSize = 0;
+    for (int y = 0; y < tileSize; y += adaptiveBlockSize) {
+        for (int x = 0; x < tileSize; x += adaptiveBlockSize) {
+            if (x <= lastCorner.x && y <= lastCorner.y)
+                stack[stackSize++] = glm::ivec3(x, y, adaptiveBlockSize);
+        }
+    }
+
+    while (stackSize > 0) {
+        const glm::ivec3 block = stack[--stackSize];
+        const int x0 = block.x, y0 = block.y, size = block.z;
+        if (size == 1) {
+            fillColor(tileStart.x + x0, tileStart.y + y0, sample(x0, y0));
+            continue;
+        }
+
+        const int x1 = std::min(x0 + size, lastCorner.x), y1 = std::min(y0 + size, lastCorner.y);
+        const glm::vec4 c00 = sample(x0, y0), c10 = sample(x1, y0), c01 = sample(x0, y1), c11 = sample(x1, y1);
+        const glm::vec4 lower = glm::min(glm::min(c00, c10), glm::min(c01, c11));
+        const glm::vec4 upper = glm::max(glm::max(c00, c10), glm::max(c01, c11));
+        if (glm::compMax(upper - lower) > m_config.adaptiveThreshold) {
+            const int halfSize = size / 2;
+            for (int i = 0; i < 4; i++) {
+                const int x = x0 + (i % 2) * halfSize, y = y0 + (i / 2) * halfSize;
+                if (x <= lastCorner.x && y <= lastCorner.y)
+                    stack[stackSize++] = glm::ivec3(x, y, halfSize);
+            }
+            continue;
+        }
+
+        // The interpolated colors of the corners themselves are exact.
+        const int endX = std::min(x0 + size, lastCorner.x + 1), endY = std::min(y0 + size, lastCorner.y + 1);
+        for (int y = y0; y < endY; y++) {
+            const float fy = y1 > y0 ? float(y - y0) / float(y1 - y0) : 0.0f;
+            for (int x = x0; x < endX; x++) {
+                const float fx = x1 > x0 ? float(x - x0) / float(x1 - x0) : 0.0f;
+                fillColor(tileStart.x + x, tileStart.y + y, glm::mix(glm::mix(c00, c10, fx), glm::mix(c01, c11, fx), fy));
+            }
+        }
+    }
+}
+
+// Thick-slab mode has to compute its pixels from scratch if the camera changed since they were computed. Rays are
+// generated from the corners of the image, which determine the view.
+void Renderer::updateSlabView()
+{
+    if (m_slabPixels.size() != m_frameBuffer.size()) {
+        m_slabPixels.resize(m_frameBuffer.size());
+        m_slabStateValid = false;
+    }
+
+    const std::array<glm::vec2, 4> corners { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(-1.0f, 1.0f), glm::vec2(1.0f, 1.0f) };
+    for (size_t i = 0; i < corners.size(); i++) {
+        const Ray ray = m_pCamera->generateRay(corners[i]);
+        if (ray.origin != m_slabCornerRays[i].origin || ray.direction != m_slabCornerRays[i].direction) {
+            m_slabCornerRays[i] = ray;
+            m_slabStateValid = false;
+        }
+    }
+}
+
+// Thick-slab projection of a tile. The samples of a ray are taken at fixed positions (ray.tmin + k * stepSize, the same
+// as traceRayMIP()) whatever the position of the slab, so when the slab moves a pixel only has to sample the part of its
+// ray that entered the slab, and remove the part that left it from the sum. The minimum and maximum cannot be undone like
+// that, so the pixel remembers which samples they came from and is only computed from scratch if one of those left the
+// slab (or the slab moved by more than its thickness). Without a valid previous state (incremental is false) every pixel
+// is computed from scratch.
+void Renderer::renderTileSlab(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, bool storeDepth, bool incremental)
+{
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, resolution);
+    for (int y = tileStart.y; y < tileEnd.y; y++) {
+        for (int x = tileStart.x; x < tileEnd.x; x++) {
+            const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(resolution);
+            const size_t index = size_t(resolution.x) * size_t(y) + size_t(x);
+            Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+            SlabPixel& pixel = m_slabPixels[index];
+            if (!instersectRayVolumeBounds(ray, bounds)) {
+                if (storeDepth)
+                    m_depthBuffer[index] = missDepth;
+                computeSlabPixel(pixel, ray, glm::ivec2(0, -1));
+                fillColor(index, glm::vec4(0.0f));
+                continue;
+            }
+            if (storeDepth)
+                m_depthBuffer[index] = ray.tmin;
+
+            const glm::ivec2 range = slabSampleRange(ray, volumeCenter, planeNormal);
+            if (incremental)
+                updateSlabPixel(pixel, ray, range);
+            else
+                computeSlabPixel(pixel, ray, range);
+            fillColor(index, slabColor(pixel));
+        }
+    }
+}
+
+// Range of the indices k of the samples along a ray (at ray.tmin + k * stepSize) that lie inside both the volume and the
+// slab. The range is empty (first > last) if the ray does not cross the slab inside the volume.
+glm::ivec2 Renderer::slabSampleRange(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const
+{
+    const float lower = m_config.slabOffset - 0.5f * std::max(m_config.slabThickness, 0.0f);
+    const float upper = m_config.slabOffset + 0.5f * std::max(m_config.slabThickness, 0.0f);
+    const float distance = glm::dot(ray.origin - volumeCenter, planeNormal);
+    const float speed = glm::dot(ray.direction, planeNormal);
+
+    float tEnter = ray.tmin, tExit = ray.tmax;
+    if (speed != 0.0f) {
+        const float t0 = (lower - distance) / speed, t1 = (upper - distance) / speed;
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    } else if (distance < lower || distance > upper) {
+        return glm::ivec2(0, -1);
+    }
+    // Also rejects rays along a face of the volume (tmin is NaN).
+    if (!(tEnter <= tExit))
+        return glm::ivec2(0, -1);
+
+    return glm::ivec2(int(std::ceil((tEnter - ray.tmin) / m_config.stepSize)), int(std::floor((tExit - ray.tmin) / m_config.stepSize)));
+}
+
+// Compute the state of a pixel from the samples in the given range.
+void Renderer::computeSlabPixel(SlabPixel& pixel, const Ray& ray, const glm::ivec2& range) const
+{
+    pixel = SlabPixel { range.x, range.y, std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), range.x, range.x, 0.0 };
+    for (int k = range.x; k <= range.y; k++) {
+        const float val = m_pVolume->getSampleInterpolate(ray.origin + (ray.tmin + float(k) * m_config.stepSize) * ray.direction);
+        pixel.sum += double(val);
+        if (val < pixel.minVal) {
+            pixel.minVal = val;
+            pixel.minIndex = k;
+        }
+        if (val > pixel.maxVal) {
+            pixel.maxVal = val;
+            pixel.maxIndex = k;
+        }
+    }
+}
+
+// Move the state of a pixel to the given range of samples. Only the samples that entered or left the range are taken,
+// unless the minimum or maximum left it (see renderTileSlab()). The result is the same as that of computeSlabPixel(),
+// except for the rounding of the sum.
+void Renderer::updateSlabPixel(SlabPixel& pixel, const Ray& ray, const glm::ivec2& range) const
+{
+    const bool overlap = pixel.first <= pixel.last && range.x <= range.y && range.x <= pixel.last && range.y >= pixel.first;
+    const bool extremaInside = pixel.minIndex >= range.x && pixel.minIndex <= range.y && pixel.maxIndex >= range.x && pixel.maxIndex <= range.y;
+    if (!overlap || !extremaInside) {
+        computeSlabPixel(pixel, ray, range);
+        return;
+    }
+
+    const auto sample = [&](int k) {
+        return m_pVolume->getSampleInterpolate(ray.origin + (ray.tmin + float(k) * m_config.stepSize) * ray.direction);
+    };
+    const auto add = [&](int k) {
+        const float val = sample(k);
+        pixel.sum += double(val);
+        if (val < pixel.minVal) {
+            pixel.minVal = val;
+            pixel.minIndex = k;
+        }
+        if (val > pixel.maxVal) {
+            pixel.maxVal = val;
+            pixel.maxIndex = k;
+        }
+    };
+    for (int k = range.x; k < pixel.first; k++)
+        add(k);
+    for (int k = pixel.first; k < range.x; k++)
+        pixel.sum -= double(sample(k));
+    for (int k = pixel.last + 1; k <= range.y; k++)
+        add(k);
+    for (int k = range.y + 1; k <= pixel.last; k++)
+        pixel.sum -= double(sample(k));
+    pixel.first = range.x;
+    pixel.last = range.y;
+}
+
+// The color of a pixel in thick-slab mode, normalized like MIP. Transparent if the slab does not contain any sample.
+glm::vec4 Renderer::slabColor(const SlabPixel& pixel) const
+{
+    if (pixel.first > pixel.last)
+        return glm::vec4(0.0f);
+
+    float val;
+    switch (m_config.slabProjection) {
+    case SlabProjection::Minimum:
+        val = pixel.minVal;
+        break;
+    case SlabProjection::Average:
+        val = float(pixel.sum / double(pixel.last - pixel.first + 1));
+        break;
+    default:
+        val = pixel.maxVal;
+        break;
+    }
+    return glm::vec4(glm::vec3(std::max(val, 0.0f) / m_pVolume->maximum()), 1.0f);
+}
+
+// Thick-slab projection of a single ray (that intersects the volume) without a previous state, for the render paths
+// that do not keep the state of every pixel (e.g. progressive refinement).
+glm::vec4 Renderer::traceRaySlab(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const
+{
+    SlabPixel pixel;
+    computeSlabPixel(pixel, ray, slabSampleRange(ray, volumeCenter, planeNormal));
+    return slabColor(pixel);
+}
+
+// Ray that is traced brick by brick: the next sample, the brick that contains it and the result of the samples before it.
+struct RaySegment {
+    Ray ray;
+    glm::vec3 samplePos;
+    float t;
+    glm::ivec3 brick;
+    glm::vec4 accumulated; // Maximum value (in x) for MIP, premultiplied color and alpha for compositing.
+    size_t pixel;
+};
+
+// Brick-ordered tracing of a tile (for MIP and compositing), which gives the same image as tracing every ray on its own.
+// Instead of following a ray through the whole volume, the rays are split into segments at the borders of bricks of
+// traversalBrickSize voxels. The tile repeatedly picks the brick of a waiting segment and traces the segments of all rays
+// that are waiting in that brick, so that its voxels are read from the cache by all of them. A ray then waits in the brick
+// that it continues in, with its partial result (the maximum so far, or the composited color and opacity), until it
+// leaves the volume or is terminated early.
+void Renderer::renderTileBricked(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, bool storeDepth)
+{
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, resolution);
+    const bool composite = m_config.renderMode == RenderMode::RenderComposite;
+    const float stepSize = m_config.stepSize;
+    const glm::ivec3 numBricks = (m_pVolume->dims() + traversalBrickSize - 1) / traversalBrickSize;
+    const auto brickOf = [&](const glm::vec3& samplePos) {
+        return glm::clamp(glm::ivec3(samplePos) / traversalBrickSize, glm::ivec3(0), numBricks - 1);
+    };
+    const auto finalColor = [&](const RaySegment& segment) {
+        return composite ? segment.accumulated : glm::vec4(glm::vec3(segment.accumulated.x) / m_pVolume->maximum(), 1.0f);
+    };
+
+    std::array<RaySegment, tileSize * tileSize> segments;
+    std::array<int, tileSize * tileSize> waiting;
+    int numWaiting = 0;
+    for (int y = tileStart.y; y < tileEnd.y; y++) {
+        for (int x = tileStart.x; x < tileEnd.x; x++) {
+            const glm::vec2 pixelPos = glm::vec2(x, y) / glm::vec2(resolution);
+            const size_t index = size_t(resolution.x) * size_t(y) + size_t(x);
+            Ray ray = m_pCamera->generateRay(pixelPos * 2.0f - 1.0f);
+            if (!instersectRayVolumeBounds(ray, bounds)) {
+                if (storeDepth)
+                    m_depthBuffer[index] = missDepth;
+                fillColor(index, glm::vec4(0.0f));
+                continue;
             }
-            case RenderMode::RenderMIP: {
-                color = traceRayMIP(ray, m_config.stepSize);
-                break;
+            if (storeDepth)
+                m_depthBuffer[index] = hitDepth(ray, volumeCenter, planeNormal);
+
+            const glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
+            const RaySegment segment { ray, samplePos, ray.tmin, brickOf(samplePos), glm::vec4(0.0f), index };
+            // Like the sample loop of a whole ray, this also skips rays along a face of the box (tmin is NaN).
+            if (!(ray.tmin <= ray.tmax)) {
+                fillColor(index, finalColor(segment));
+                continue;
             }
-            case RenderMode::RenderComposite: {
-                color = traceRayComposite(ray, m_config.stepSize);
-                break;
+            segments[size_t(numWaiting)] = segment;
+            waiting[size_t(numWaiting)] = numWaiting;
+            numWaiting++;
+        }
+    }
+
+    // Take the samples of a ray inside its brick, the same way as traceRayMIP() and traceRayComposite() do. Returns whether
+    // the ray continues in another brick. At least one sample is taken, so that every segment makes progress even if
+    // rounding puts the first sample just outside of the brick.
+    const auto traceSegment = [&](RaySegment& segment) {
+        const Ray& ray = segment.ray;
+        const float tExit = brickExit(ray, segment.brick, traversalBrickSize);
+        const glm::vec3 increment = stepSize * ray.direction;
+        const glm::vec3 V = -glm::normalize(ray.direction);
+        do {
+            if (composite) {
+                const glm::vec4 sample = compositeSample(m_pVolume->getSampleInterpolate(segment.samplePos), segment.samplePos, V);
+                if (sample.a > 0.0f) {
+                    // The depth of the first visible sample, like traceRayComposite() records it.
+                    if (storeDepth && segment.accumulated.a == 0.0f)
+                        m_depthBuffer[segment.pixel] = segment.t;
+                    const float weight = (1.0f - segment.accumulated.a) * sample.a;
+                    segment.accumulated += glm::vec4(weight * glm::vec3(sample), weight);
+                    // Early ray termination.
+                    if (segment.accumulated.a >= 0.99f)
+                        return false;
+                }
+            } else {
+                segment.accumulated.x = std::max(m_pVolume->getSampleInterpolate(segment.samplePos), segment.accumulated.x);
             }
-            case RenderMode::RenderIso: {
-                color = traceRayISO(ray, m_config.stepSize);
-                break;
+            segment.t += stepSize;
+            segment.samplePos += increment;
+        } while (segment.t <= tExit);
+        return segment.t <= ray.tmax;
+    };
+
+    while (numWaiting > 0) {
+        const glm::ivec3 brick = segments[size_t(waiting[0])].brick;
+        int numRemaining = 0;
+        for (int i = 0; i < numWaiting; i++) {
+            RaySegment& segment = segments[size_t(waiting[size_t(i)])];
+            if (segment.brick != brick) {
+                waiting[size_t(numRemaining++)] = waiting[size_t(i)];
+            } else if (traceSegment(segment)) {
+                segment.brick = brickOf(segment.samplePos);
+                waiting[size_t(numRemaining++)] = waiting[size_t(i)];
+            } else {
+                fillColor(segment.pixel, finalColor(segment));
             }
-            };
-            // Write the resulting color to the screen.
-            fillColor(x, y, color);
+        }
+        numWaiting = numRemaining;
+    }
+}
 
+// Number of passes of renderRefinementPass() for the given settings.
+int Renderer::numRefinementPasses(const RenderConfig& config)
+{
+    return numCoarseRefinementPasses + std::max(config.progressiveSamples, 1) - 1;
+}
+
+// Progressive refinement, as an alternative to render(). Pass 0 traces one ray per block of 8x8 pixels and fills the whole
+// block with its color. Every following pass halves the block size and only traces the pixels that were not traced yet,
+// so that after pass 3 every pixel is traced once (which gives the same image as render()). The passes after that trace
+// every pixel again at a jittered position inside the pixel, and the image shows the average of all samples of a pixel.
+// After every pass the framebuffer contains the complete current image. Returns false if the pass was cancelled, in which
+// case the refinement has to start over at pass 0.
+bool Renderer::renderRefinementPass(int pass, const std::atomic_bool* pCancel)
+{
+    const glm::vec3 planeNormal = -glm::normalize(m_pCamera->forward());
+    const glm::vec3 volumeCenter = glm::vec3(m_pVolume->dims()) / 2.0f;
+    const Bounds bounds = cropBounds();
+    if (pass == 0) {
+        updateIlluminationGrid();
+        updateTF2DTables();
+    }
+
+    if (pass == 0) {
+        m_refinementBuffer.resize(m_frameBuffer.size());
+        m_pHistoryCamera = nullptr;
+    }
+
+    const bool coarse = pass < numCoarseRefinementPasses;
+    const int blockSize = coarse ? refinementBlockSize >> pass : 1;
+    // Index of the sample that is added to every pixel (0 for the last coarse pass, negative before that).
+    const int sampleIndex = pass - (numCoarseRefinementPasses - 1);
+    const glm::vec2 jitter = sampleIndex > 0 ? glm::vec2(radicalInverse(sampleIndex, 2), radicalInverse(sampleIndex, 3)) : glm::vec2(0.0f);
+
+    const glm::ivec2 resolution = m_config.renderResolution;
+    const glm::ivec2 numTiles = (resolution + tileSize - 1) / tileSize;
+    const int numTilesTotal = numTiles.x * numTiles.y;
+#if PARALLELISM == 1
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int tile = 0; tile < numTilesTotal; tile++) {
+        if (pCancel && pCancel->load(std::memory_order_relaxed))
+            continue;
+
+        // Tiles start at a multiple of the block size, so x and y are the corners of blocks.
+        const glm::ivec2 tileStart = glm::ivec2(tile % numTiles.x, tile / numTiles.x) * tileSize;
+        const glm::ivec2 tileEnd = glm::min(tileStart + tileSize, resolution);
+        for (int y = tileStart.y; y < tileEnd.y; y += blockSize) {
+            for (int x = tileStart.x; x < tileEnd.x; x += blockSize) {
+                // Skip the pixels that were traced by the previous (coarser) passes.
+                if (coarse && pass > 0 && x % (2 * blockSize) == 0 && y % (2 * blockSize) == 0)
+                    continue;
+
+                const glm::vec2 pixelPos = (glm::vec2(x, y) + jitter) / glm::vec2(resolution);
+                const glm::vec4 color = traceRay(m_pCamera->generateRay(pixelPos * 2.0f - 1.0f), bounds, volumeCenter, planeNormal);
+                if (sampleIndex > 0) {
+                    m_refinementBuffer[size_t(resolution.x) * size_t(y) + size_t(x)] += color;
+                } else {
+                    const int blockEndX = std::min(x + blockSize, resolution.x), blockEndY = std::min(y + blockSize, resolution.y);
+                    for (int by = y; by < blockEndY; by++)
+                        std::fill_n(m_refinementBuffer.begin() + size_t(resolution.x) * size_t(by) + size_t(x), blockEndX - x, color);
+                }
+            }
         }
     }
+    if (pCancel && pCancel->load())
+        return false;
+
+    // The refinement buffer holds the sum of the samples of every pixel.
+    const float weight = sampleIndex > 0 ? 1.0f / float(sampleIndex + 1) : 1.0f;
+    const int numPixels = int(m_refinementBuffer.size());
+#if PARALLELISM == 1
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < numPixels; i++)
+        fillColor(size_t(i), m_refinementBuffer[size_t(i)] * weight);
+    return true;
+}
+
+// The axis-aligned box that rays are clipped to: the volume, or the part of it inside the crop box. No samples are taken
+// outside of it.
+Bounds Renderer::cropBounds() const
+{
+    const glm::vec3 volumeUpper = glm::vec3(m_pVolume->dims() - glm::ivec3(1));
+    return Bounds { m_config.cropMin * volumeUpper, glm::max(m_config.cropMin, m_config.cropMax) * volumeUpper };
+}
+
+// The cached illumination is computed for a headlight and the current transfer function. Request a rebuild when the camera
+// turned or the transfer function changed (this returns immediately) and keep using the most recent grid for this frame,
+// even if it is slightly outdated.
+void Renderer::updateIlluminationGrid()
+{
+    m_pIlluminationGrid = nullptr;
+    if (m_pIlluminationCache && m_config.volumeShading && m_config.useIlluminationCache && m_config.renderMode == RenderMode::RenderComposite) {
+        m_pIlluminationCache->requestUpdate(-m_pCamera->forward(), m_config);
+        m_pIlluminationGrid = m_pIlluminationCache->snapshot();
+    }
+}
+
+// Returns the color of a ray according to the current render mode, or transparent black if it misses the volume.
+// Optionally also returns the depth of the ray (see hitDepth()).
+glm::vec4 Renderer::traceRay(Ray ray, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, float* pDepth) const
+{
+    // Compute where the ray enters and exists the volume.
+    if (!instersectRayVolumeBounds(ray, bounds)) {
+        if (pDepth)
+            *pDepth = missDepth;
+        return glm::vec4(0.0f);
+    }
+    // The modes that march until something is visible record the depth while they march.
+    if (pDepth)
+        *pDepth = hitDepth(ray, volumeCenter, planeNormal);
+
+    switch (m_config.renderMode) {
+    case RenderMode::RenderSlicer:
+        return traceRaySlice(ray, volumeCenter, planeNormal);
+    case RenderMode::RenderMIP:
+        return traceRayMIP(ray, m_config.stepSize);
+    case RenderMode::RenderComposite:
+        return traceRayComposite(ray, m_config.stepSize, pDepth);
+    case RenderMode::RenderIso:
+        return traceRayISO(ray, m_config.stepSize, pDepth);
+    case RenderMode::RenderTF2D:
+        return traceRayTF2D(ray, m_config.stepSize, pDepth);
+    case RenderMode::RenderSlab:
+        return traceRaySlab(ray, volumeCenter, planeNormal);
+    }
+    return glm::vec4(0.0f);
+}
+
+// Depth (ray parameter) of the first visible sample along a ray that intersects the volume, used to reproject pixels.
+// The slicer shows the plane through the center of the volume. MIP has no visible surface (neither do thick slabs), so
+// (like for rays that do not hit anything visible) the point where the ray enters the volume is used. The modes that
+// march until the first sample with a non-zero opacity (compositing, isosurface and the 2D transfer function) replace this
+// with the depth of that sample while they trace the ray, instead of marching it twice.
+float Renderer::hitDepth(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const
+{
+    if (m_config.renderMode == RenderMode::RenderSlicer)
+        return glm::dot(volumeCenter - ray.origin, planeNormal) / glm::dot(ray.direction, planeNormal);
+    return ray.tmin;
 }
 
 // ======= DO NOT MODIFY THIS FUNCTION ========
@@ -154,9 +1063,12 @@ glm::vec4 Renderer::traceRayMIP(const Ray& ray, float stepSize) const
 // If volume shading is ENABLED then return the phong-shaded color at that location using the local gradient (from m_pGradientVolume).
 //   Use the camera position (m_pCamera->position()) as the light position.
 // Use the bisectionAccuracy function (to be implemented) to get a more precise isosurface location between two steps.
-glm::vec4 Renderer::traceRayISO(const Ray& ray, float stepSize) const
+// If pFirstHit is given, store the ray parameter t of the isosurface in it (it is used to reproject pixels).
+glm::vec4 Renderer::traceRayISO(const Ray& ray, float stepSize, float* pFirstHit) const
 {
     static constexpr glm::vec3 isoColor { 0.8f, 0.8f, 0.2f };
+    if (pFirstHit)
+        *pFirstHit = ray.tmin;
     return glm::vec4(isoColor, 1.0f);
 }
 
@@ -169,24 +1081,298 @@ float Renderer::bisectionAccuracy(const Ray& ray, float t0, float t1, float isoV
     return 0.0f;
 }
 
-// ======= TODO: IMPLEMENT ========
 // Compute Phong Shading given the voxel color (material color), the gradient, the light vector and view vector.
+// L and V point from the sample towards the light and the viewer respectively. The normal is flipped towards the
+// viewer and a zero gradient results in black, the same way as the phongShading function in the GPU shaders.
 // You can find out more about the Phong shading model at:
 // https://en.wikipedia.org/wiki/Phong_reflection_model
-//
-// you are allowed to modify the default parameters in the .h file, if needed. DO NOT modify them inside the function.
-
 glm::vec3 Renderer::computePhongShading(const glm::vec3& color, const volume::GradientVoxel& gradient, const glm::vec3& L, const glm::vec3& V, float ambientCoefficient, float diffuseCoefficient, float specularCoefficient, int specularPower)
 {
-    return glm::vec3(0.0f);
+    if (gradient.magnitude == 0.0f)
+        return glm::vec3(0.0f);
+
+    glm::vec3 N = gradient.dir / gradient.magnitude;
+    if (glm::dot(N, V) < 0.0f)
+        N = -N;
+
+    const float NdotL = glm::dot(L, N);
+    const glm::vec3 R = 2.0f * NdotL * N - L;
+    const float diffuse = std::max(NdotL, 0.0f);
+    const float specular = std::pow(std::max(glm::dot(R, V), 0.0f), float(specularPower));
+    return color * (ambientCoefficient + diffuseCoefficient * diffuse + specularCoefficient * specular);
 }
 
-// ======= TODO: IMPLEMENT ========
-// In this function, implement 1D transfer function raycasting.
+// This function implements 1D transfer function raycasting with front-to-back compositing and early ray termination.
 // Use getTFValue to compute the color for a given volume value according to the 1D transfer function.
-glm::vec4 Renderer::traceRayComposite(const Ray& ray, float stepSize) const
+// When volume shading is enabled each sample is lit by a headlight, either with a full Phong evaluation or (when the
+// illumination cache is enabled) by a single lookup into the precomputed illumination grid.
+// Ambient occlusion (if enabled) is applied on top of that as another lookup into a precomputed grid.
+// The returned color is premultiplied by alpha. The depth of the first sample with a non-zero opacity (or, if there is
+// none, of the point where the ray enters the volume) is stored in pFirstHit if it is given.
+glm::vec4 Renderer::traceRayComposite(const Ray& ray, float stepSize, float* pFirstHit) const
 {
-    return glm::vec4(0.0f);
+    const glm::vec3 V = -glm::normalize(ray.direction);
+
+    glm::vec3 accumulatedColor { 0.0f };
+    float accumulatedAlpha = 0.0f;
+
+    glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
+    const glm::vec3 increment = stepSize * ray.direction;
+    for (float t = ray.tmin; t <= ray.tmax; t += stepSize, samplePos += increment) {
+        const glm::vec4 sample = compositeSample(m_pVolume->getSampleInterpolate(samplePos), samplePos, V);
+        if (sample.a <= 0.0f)
+            continue;
+        if (pFirstHit && accumulatedAlpha == 0.0f)
+            *pFirstHit = t;
+
+        const float weight = (1.0f - accumulatedAlpha) * sample.a;
+        accumulatedColor += weight * glm::vec3(sample);
+        accumulatedAlpha += weight;
+
+        // Early ray termination: the remaining samples would hardly contribute.
+        if (accumulatedAlpha >= 0.99f)
+            break;
+    }
+
+    return glm::vec4(accumulatedColor, accumulatedAlpha);
+}
+
+// Color (shaded, not premultiplied) and opacity of a compositing sample with the given value. V points from the sample
+// towards the viewer.
+glm::vec4 Renderer::compositeSample(float val, const glm::vec3& samplePos, const glm::vec3& V) const
+{
+    const glm::vec4 tfValue = getTFValue(val);
+    if (tfValue.a <= 0.0f)
+        return tfValue;
+
+    glm::vec3 color = glm::vec3(tfValue);
+    if (m_config.volumeShading) {
+        if (m_pIlluminationGrid)
+            color *= m_pIlluminationGrid->getIlluminationInterpolate(samplePos);
+        else
+            color = computePhongShading(color, m_pGradientVolume->getGradientInterpolate(samplePos), V, V);
+    }
+    if (m_config.ambientOcclusion && m_pAmbientOcclusion)
+        color *= m_pAmbientOcclusion->getAmbientOcclusionInterpolate(samplePos);
+    return glm::vec4(color, tfValue.a);
+}
+
+// Traces a ray that intersects the volume for renderFused(). The MIP and compositing colors are the same as those of
+// traceRayMIP() and traceRayComposite(); compositing stops after early ray termination while the other modes continue.
+// The isosurface is found at the first sample that reaches m_config.isoValue, and the crossing is placed between that
+// sample and the previous one by linear interpolation of their values (without taking more samples). It is shaded with
+// a headlight if volume shading is enabled.
+FusedColors Renderer::traceRayFused(const Ray& ray) const
+{
+    const glm::vec3 V = -glm::normalize(ray.direction);
+    const float stepSize = m_config.stepSize;
+
+    float maxVal = 0.0f;
+    glm::vec4 iso { 0.0f };
+    bool isoFound = false;
+    float previousVal = 0.0f;
+    glm::vec3 accumulatedColor { 0.0f };
+    float accumulatedAlpha = 0.0f;
+
+    glm::vec3 samplePos = ray.origin + ray.tmin * ray.direction;
+    const glm::vec3 increment = stepSize * ray.direction;
+    for (float t = ray.tmin; t <= ray.tmax; t += stepSize, samplePos += increment) {
+        const float val = m_pVolume->getSampleInterpolate(samplePos);
+        maxVal = std::max(val, maxVal);
+
+        if (!isoFound && val >= m_config.isoValue) {
+            const float fraction = t > ray.tmin && val > previousVal ? (m_config.isoValue - previousVal) / (val - previousVal) : 1.0f;
+            const glm::vec3 hitPos = samplePos - (1.0f - fraction) * increment;
+            const glm::vec3 color = m_config.volumeShading ? computePhongShading(fusedIsoColor, m_pGradientVolume->getGradientInterpolate(hitPos), V, V) : fusedIsoColor;
+            iso = glm::vec4(color, 1.0f);
+            isoFound = true;
+        }
+        previousVal = val;
+
+        if (accumulatedAlpha < 0.99f) {
+            const glm::vec4 sample = compositeSample(val, samplePos, V);
+            if (sample.a > 0.0f) {
+                const float weight = (1.0f - accumulatedAlpha) * sample.a;
+                accumulatedColor += weight * glm::vec3(sample);
+                accumulatedAlpha += weight;
+            }
+        }
+    }
+
+    return FusedColors { glm::vec4(glm::vec3(maxVal) / m_pVolume->maximum(), 1.0f), iso, glm::vec4(accumulatedColor, accumulatedAlpha) };
+}
+
+// This function implements 2D transfer function raycasting with front-to-back compositing and early ray termination.
+// The opacity of a sample is looked up from the precomputed 2D LUT (falling back to getTF2DOpacity when the tables
+// have not been built) and bricks that cannot contain any visible sample according to the LUT are skipped entirely.
+// The color of every sample is m_config.TF2DColor, optionally Phong shaded with a headlight.
+// The returned color is premultiplied by alpha. The depth of the first visible sample is stored in pFirstHit like
+// traceRayComposite() does.
+glm::vec4 Renderer::traceRayTF2D(const Ray& ray, float stepSize, float* pFirstHit) const
+{
+    const glm::vec3 V = -glm::normalize(ray.direction);
+    const bool useTables = m_tf2DTablesValid;
+    // Cubic interpolation may overshoot the value range of a brick, which makes skipping based on that range incorrect.
+    const bool skipEmptySpace = useTables && m_pVolume->interpolationMode != volume::InterpolationMode::Cubic;
+
+    glm::vec3 accumulatedColor { 0.0f };
+    float accumulatedAlpha = 0.0f;
+
+    for (float t = ray.tmin; t <= ray.tmax; t += stepSize) {
+        const glm::vec3 samplePos = ray.origin + t * ray.direction;
+
+        if (skipEmptySpace) {
+            const glm::ivec3 brick = glm::clamp(glm::ivec3(samplePos) / tf2DBrickSize, glm::ivec3(0), m_tf2DNumBricks - 1);
+            if (isTF2DBrickEmpty(brick)) {
+                // Move to the last sample inside the brick, the loop increment then steps to the first sample behind it.
+                const float stepsToExit = std::ceil((tf2DBrickExit(ray, brick) - t) / stepSize);
+                t += (std::max(stepsToExit, 1.0f) - 1.0f) * stepSize;
+                continue;
+            }
+        }
+
+        const float val = m_pVolume->getSampleInterpolate(samplePos);
+        const volume::GradientVoxel gradient = m_pGradientVolume->getGradientInterpolate(samplePos);
+        const float opacity = useTables ? lookupTF2DOpacity(val, gradient.magnitude) : getTF2DOpacity(val, gradient.magnitude);
+        if (opacity <= 0.0f)
+            continue;
+        if (pFirstHit && accumulatedAlpha == 0.0f)
+            *pFirstHit = t;
+
+        glm::vec3 color = glm::vec3(m_config.TF2DColor);
+        if (m_config.volumeShading)
+            color = computePhongShading(color, gradient, V, V);
+
+        const float weight = (1.0f - accumulatedAlpha) * opacity;
+        accumulatedColor += weight * color;
+        accumulatedAlpha += weight;
+
+        // Early ray termination: the remaining samples would hardly contribute.
+        if (accumulatedAlpha >= 0.99f)
+            break;
+    }
+
+    return glm::vec4(accumulatedColor, accumulatedAlpha);
+}
+
+// This function returns the opacity of the 2D transfer function for the given intensity and gradient magnitude.
+// The widget is a triangle with its apex at (m_config.TF2DIntensity, 0) that widens to m_config.TF2DRadius at the
+// maximum gradient magnitude. The opacity decreases linearly from m_config.TF2DColor.a on the center line to 0 at the edges.
+float Renderer::getTF2DOpacity(float intensity, float gradientMagnitude) const
+{
+    const float maxMagnitude = m_pGradientVolume->maxMagnitude();
+    if (maxMagnitude <= 0.0f)
+        return 0.0f;
+
+    const float radius = m_config.TF2DRadius * gradientMagnitude / maxMagnitude;
+    const float distance = std::abs(intensity - m_config.TF2DIntensity);
+    if (radius <= 0.0f || distance >= radius)
+        return 0.0f;
+    return m_config.TF2DColor.a * (1.0f - distance / radius);
+}
+
+// Rebuild the 2D transfer function opacity LUT, its summed-area table and the empty brick classification if the 2D transfer
+// function is rendered and changed. Every LUT entry stores getTF2DOpacity evaluated at the center of its (intensity, gradient
+// magnitude) bin. This runs at the start of a frame instead of in setConfig() or the constructor, so that the volume passes
+// of the brick ranges and of the gradient magnitude range never run on the (UI) thread that creates the renderer.
+void Renderer::updateTF2DTables()
+{
+    if (m_config.renderMode != RenderMode::RenderTF2D || !m_tf2DTablesOutdated)
+        return;
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    if (m_tf2DBrickRanges.empty())
+        computeTF2DBrickRanges();
+
+    m_tf2DBinScale = glm::vec2(tf2DTableSize) / glm::max(glm::vec2(m_pVolume->maximum(), m_pGradientVolume->maxMagnitude()), glm::vec2(1e-6f));
+    constexpr size_t tableSize = size_t(tf2DTableSize);
+    m_tf2DOpacityTable.resize(tableSize * tableSize);
+    for (size_t magnitudeBin = 0; magnitudeBin < tableSize; magnitudeBin++) {
+        for (size_t intensityBin = 0; intensityBin < tableSize; intensityBin++) {
+            const glm::vec2 binCenter = (glm::vec2(float(intensityBin), float(magnitudeBin)) + 0.5f) / m_tf2DBinScale;
+            m_tf2DOpacityTable[intensityBin + magnitudeBin * tableSize] = getTF2DOpacity(binCenter.x, binCenter.y);
+        }
+    }
+
+    // Entry (i, g) of the summed-area table contains the sum of the LUT entries in [0, i) x [0, g).
+    constexpr size_t tableStride = tableSize + 1;
+    m_tf2DSummedAreaTable.assign(tableStride * tableStride, 0.0);
+    for (size_t magnitudeBin = 0; magnitudeBin < tableSize; magnitudeBin++) {
+        double rowSum = 0.0;
+        for (size_t intensityBin = 0; intensityBin < tableSize; intensityBin++) {
+            rowSum += double(m_tf2DOpacityTable[intensityBin + magnitudeBin * tableSize]);
+            m_tf2DSummedAreaTable[(intensityBin + 1) + (magnitudeBin + 1) * tableStride] = rowSum + m_tf2DSummedAreaTable[(intensityBin + 1) + magnitudeBin * tableStride];
+        }
+    }
+
+    // A brick is empty if none of the LUT entries covered by its intensity and gradient magnitude range is visible.
+    m_tf2DBrickEmpty.resize(m_tf2DBrickRanges.size());
+#pragma omp parallel for
+    for (int i = 0; i < int(m_tf2DBrickRanges.size()); i++) {
+        const glm::vec4 range = m_tf2DBrickRanges[size_t(i)];
+        const glm::ivec2 lowerBin = glm::clamp(glm::ivec2(glm::vec2(range.x, range.z) * m_tf2DBinScale), glm::ivec2(0), glm::ivec2(tf2DTableSize - 1));
+        const glm::ivec2 upperBin = glm::clamp(glm::ivec2(glm::vec2(range.y, range.w) * m_tf2DBinScale), glm::ivec2(0), glm::ivec2(tf2DTableSize - 1)) + 1;
+        const size_t lowerX = size_t(lowerBin.x), lowerY = size_t(lowerBin.y), upperX = size_t(upperBin.x), upperY = size_t(upperBin.y);
+        const double sum = m_tf2DSummedAreaTable[upperX + upperY * tableStride] - m_tf2DSummedAreaTable[lowerX + upperY * tableStride]
+            - m_tf2DSummedAreaTable[upperX + lowerY * tableStride] + m_tf2DSummedAreaTable[lowerX + lowerY * tableStride];
+        m_tf2DBrickEmpty[size_t(i)] = sum <= 0.0;
+    }
+    m_tf2DTablesValid = true;
+    m_tf2DTablesOutdated = false;
+
+    const auto end = clock::now();
+    std::cout << "Renderer::updateTF2DTables() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+}
+
+// Compute the intensity and gradient magnitude range of every brick. The range includes the first voxel of the next
+// brick because (tri)linear interpolation at sample positions inside a brick also reads those voxels.
+void Renderer::computeTF2DBrickRanges()
+{
+    const glm::ivec3 dims = m_pVolume->dims();
+    m_tf2DNumBricks = (dims + tf2DBrickSize - 1) / tf2DBrickSize;
+    m_tf2DBrickRanges.resize(size_t(m_tf2DNumBricks.x) * size_t(m_tf2DNumBricks.y) * size_t(m_tf2DNumBricks.z));
+
+#pragma omp parallel for schedule(dynamic)
+    for (int bz = 0; bz < m_tf2DNumBricks.z; bz++) {
+        for (int by = 0; by < m_tf2DNumBricks.y; by++) {
+            for (int bx = 0; bx < m_tf2DNumBricks.x; bx++) {
+                const glm::ivec3 begin = glm::ivec3(bx, by, bz) * tf2DBrickSize;
+                const glm::ivec3 end = glm::min(begin + tf2DBrickSize + 1, dims);
+
+                glm::vec4 range { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+                for (int z = begin.z; z < end.z; z++) {
+                    for (int y = begin.y; y < end.y; y++) {
+                        for (int x = begin.x; x < end.x; x++) {
+                            const float val = m_pVolume->getVoxel(x, y, z);
+                            const float magnitude = m_pGradientVolume->getGradient(x, y, z).magnitude;
+                            range = glm::vec4(std::min(range.x, val), std::max(range.y, val), std::min(range.z, magnitude), std::max(range.w, magnitude));
+                        }
+                    }
+                }
+                m_tf2DBrickRanges[size_t(bx) + size_t(m_tf2DNumBricks.x) * (size_t(by) + size_t(m_tf2DNumBricks.y) * size_t(bz))] = range;
+            }
+        }
+    }
+}
+
+// Looks up the opacity of the 2D transfer function from the precomputed LUT.
+float Renderer::lookupTF2DOpacity(float val, float gradientMagnitude) const
+{
+    const glm::ivec2 bin = glm::clamp(glm::ivec2(glm::vec2(val, gradientMagnitude) * m_tf2DBinScale), glm::ivec2(0), glm::ivec2(tf2DTableSize - 1));
+    return m_tf2DOpacityTable[size_t(bin.x + bin.y * tf2DTableSize)];
+}
+
+bool Renderer::isTF2DBrickEmpty(const glm::ivec3& brick) const
+{
+    return m_tf2DBrickEmpty[size_t(brick.x) + size_t(m_tf2DNumBricks.x) * (size_t(brick.y) + size_t(m_tf2DNumBricks.y) * size_t(brick.z))];
+}
+
+// Returns the distance along the ray at which it leaves the given brick.
+float Renderer::tf2DBrickExit(const Ray& ray, const glm::ivec3& brick) const
+{
+    return brickExit(ray, brick, tf2DBrickSize);
 }
 
 // ======= DO NOT MODIFY THIS FUNCTION ========
@@ -235,7 +1421,15 @@ bool Renderer::instersectRayVolumeBounds(Ray& ray, const Bounds& bounds) const
 // This function inserts a color into the framebuffer at position x,y
 void Renderer::fillColor(int x, int y, const glm::vec4& color)
 {
-    const size_t index = static_cast<size_t>(m_config.renderResolution.x * y + x);
+    fillColor(size_t(m_config.renderResolution.x) * size_t(y) + size_t(x), color);
+}
+
+// Same, for the pixel at the given index. With compactFrameBuffer enabled the color is also written as 8-bit RGBA, while
+// it is still in a register, instead of converting the whole image in a separate pass.
+void Renderer::fillColor(size_t index, const glm::vec4& color)
+{
     m_frameBuffer[index] = color;
+    if (m_config.compactFrameBuffer)
+        m_compactFrameBuffer[index] = packColor(color);
 }
 }
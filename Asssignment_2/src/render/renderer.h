@@ -1,16 +1,24 @@
 #pragma once
 #include "render/ray.h"
 #include "render/ray_trace_camera.h"
+#include "render/ambient_occlusion.h"
+#include "render/illumination_cache.h"
 #include "render/render_config.h"
-#include "volume/gradient_volume.h"
-#include "volume/volume.h"
+#include "util/aligned_allocator.h"
+#include "volume/gradient_provider.h"
+#include "volume/volume_sampler.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <cstring> // memcmp
+#include <filesystem>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <gsl/span>
 #include <memory>
+#include <optional>
 #include <tuple>
 #include <vector>
 
@@ -24,27 +32,58 @@ union Bounds {
     std::array<glm::vec3, 2> lowerUpper;
 };
 
+// State of a pixel in thick-slab mode: the range of samples along its ray that lie inside the slab and their statistics,
+// which are updated incrementally when the slab moves (see Renderer::renderTileSlab()).
+struct SlabPixel {
+    int first, last; // Sample indices, the range is empty if first > last.
+    float minVal, maxVal;
+    int minIndex, maxIndex;
+    double sum;
+};
+
+// Colors of a ray in the render modes that Renderer::renderFused() renders at once.
+struct FusedColors {
+    glm::vec4 mip;
+    glm::vec4 iso;
+    glm::vec4 composite;
+};
+
 class Renderer {
 public:
     Renderer(
-        const volume::Volume* pVolume,
-        const volume::GradientVolume* pGradientVolume,
+        const volume::VolumeSampler* pVolume,
+        const volume::GradientProvider* pGradientVolume,
         const render::RayTraceCamera* pCamera,
         const RenderConfig& config);
 
     void setConfig(const RenderConfig& config);
-    void render();
+    void setCamera(const render::RayTraceCamera* pCamera);
+    void setIlluminationCache(IlluminationCache* pIlluminationCache);
+    void setAmbientOcclusionVolume(const AmbientOcclusionVolume* pAmbientOcclusion);
+    bool render(const std::atomic_bool* pCancel = nullptr);
+    static int numRefinementPasses(const RenderConfig& config);
+    bool renderRefinementPass(int pass, const std::atomic_bool* pCancel = nullptr);
+    bool renderInterleaved(const std::atomic_bool* pCancel = nullptr);
+    void resetReprojectionHistory();
+    bool renderFused(const std::atomic_bool* pCancel = nullptr);
+    gsl::span<const glm::vec4> fusedFrameBuffer(RenderMode renderMode) const;
+    bool renderPoster(const glm::ivec2& resolution, const std::filesystem::path& file, int stripHeight = 64, const std::atomic_bool* pCancel = nullptr, std::atomic<float>* pProgress = nullptr);
     gsl::span<const glm::vec4> frameBuffer() const;
+    void swapFrameBuffer(util::AlignedVector<glm::vec4>& frameBuffer);
+    gsl::span<const uint32_t> compactFrameBuffer() const;
+    void swapCompactFrameBuffer(util::AlignedVector<uint32_t>& compactFrameBuffer);
 
 protected:
     // These functions will be automatically tested.
     glm::vec4 traceRaySlice(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const;
     glm::vec4 traceRayMIP(const Ray& ray, float sampleStep) const;
-    glm::vec4 traceRayISO(const Ray& ray, float sampleStep) const;
-    glm::vec4 traceRayComposite(const Ray& ray, float sampleStep) const;
+    glm::vec4 traceRayISO(const Ray& ray, float sampleStep, float* pFirstHit = nullptr) const;
+    glm::vec4 traceRayComposite(const Ray& ray, float sampleStep, float* pFirstHit = nullptr) const;
+    glm::vec4 traceRayTF2D(const Ray& ray, float sampleStep, float* pFirstHit = nullptr) const;
     float bisectionAccuracy(const Ray& ray, float t0, float t1, float isoValue) const;
 
     static glm::vec3 computePhongShading(const glm::vec3& color, const volume::GradientVoxel& gradient, const glm::vec3& L, const glm::vec3& V, float ambientCoefficient=0.1f, float diffuseCoefficient=0.7f, float specularCoefficient=0.2f, int specularPower=25);
+    float getTF2DOpacity(float val, float gradientMagnitude) const;
 
 
 
@@ -52,17 +91,83 @@ private:
     void resizeImage(const glm::ivec2& resolution);
     void resetImage();
 
+    Bounds cropBounds() const;
+    void updateIlluminationGrid();
+    void renderTileAdaptive(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal);
+    void updateSlabView();
+    void renderTileSlab(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, bool storeDepth, bool incremental);
+    glm::ivec2 slabSampleRange(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const;
+    void computeSlabPixel(SlabPixel& pixel, const Ray& ray, const glm::ivec2& range) const;
+    void updateSlabPixel(SlabPixel& pixel, const Ray& ray, const glm::ivec2& range) const;
+    glm::vec4 slabColor(const SlabPixel& pixel) const;
+    glm::vec4 traceRaySlab(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const;
+    void renderTileBricked(const glm::ivec2& tileStart, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, bool storeDepth);
+    glm::vec4 traceRay(Ray ray, const Bounds& bounds, const glm::vec3& volumeCenter, const glm::vec3& planeNormal, float* pDepth = nullptr) const;
+    float hitDepth(const Ray& ray, const glm::vec3& volumeCenter, const glm::vec3& planeNormal) const;
+    void storeReprojectionHistory();
+    std::optional<glm::vec4> reprojectPixel(const glm::ivec2& pixel, float depth, float tolerance) const;
     glm::vec4 getTFValue(float val) const;
+    glm::vec4 compositeSample(float val, const glm::vec3& samplePos, const glm::vec3& V) const;
+    FusedColors traceRayFused(const Ray& ray) const;
+
+    void updateTF2DTables();
+    void computeTF2DBrickRanges();
+    float lookupTF2DOpacity(float val, float gradientMagnitude) const;
+    bool isTF2DBrickEmpty(const glm::ivec3& brick) const;
+    float tf2DBrickExit(const Ray& ray, const glm::ivec3& brick) const;
     bool instersectRayVolumeBounds(Ray& ray, const Bounds& volumeBounds) const;
     void fillColor(int x, int y, const glm::vec4& color);
+    void fillColor(size_t index, const glm::vec4& color);
 
 protected:
-    const volume::Volume* m_pVolume;
-    const volume::GradientVolume* m_pGradientVolume;
+    const volume::VolumeSampler* m_pVolume;
+    const volume::GradientProvider* m_pGradientVolume;
     const render::RayTraceCamera* m_pCamera;
     RenderConfig m_config {};
 
-    std::vector<glm::vec4> m_frameBuffer;
+    IlluminationCache* m_pIlluminationCache { nullptr };
+    // Grid used during the current frame (nullptr if the illumination cache is disabled or not built yet).
+    std::shared_ptr<const IlluminationGrid> m_pIlluminationGrid;
+
+    const AmbientOcclusionVolume* m_pAmbientOcclusion { nullptr };
+
+    // Number of intensity and gradient magnitude bins of the 2D transfer function opacity LUT.
+    static constexpr int tf2DTableSize = 256;
+    // Size (in voxels) of the bricks used for empty space skipping in 2D transfer function mode.
+    static constexpr int tf2DBrickSize = 8;
+    // 2D transfer function tables, rebuilt by the first frame after the 2D transfer function changed.
+    // The opacity LUT is indexed by (gradient magnitude bin, intensity bin). Its summed-area table is used to test whether
+    // a brick contains any visible (intensity, gradient magnitude) combination so that empty bricks can be skipped.
+    bool m_tf2DTablesValid { false };
+    bool m_tf2DTablesOutdated { true };
+    std::vector<float> m_tf2DOpacityTable;
+    std::vector<double> m_tf2DSummedAreaTable;
+    glm::vec2 m_tf2DBinScale { 0.0f }; // Converts (intensity, gradient magnitude) to LUT bins.
+    glm::ivec3 m_tf2DNumBricks { 0 };
+    std::vector<glm::vec4> m_tf2DBrickRanges; // (min intensity, max intensity, min gradient magnitude, max gradient magnitude)
+    std::vector<char> m_tf2DBrickEmpty;
+
+    util::AlignedVector<glm::vec4> m_frameBuffer;
+    // The framebuffer as packed 8-bit RGBA (red in the lowest byte), empty unless m_config.compactFrameBuffer is set.
+    util::AlignedVector<uint32_t> m_compactFrameBuffer;
+    // Images of renderFused(), allocated by its first call.
+    util::AlignedVector<glm::vec4> m_fusedMIPFrameBuffer, m_fusedIsoFrameBuffer, m_fusedCompositeFrameBuffer;
+    // Sum of the samples of every pixel during progressive refinement.
+    util::AlignedVector<glm::vec4> m_refinementBuffer;
+
+    // Interleaved rendering: depth of every pixel of the current frame, and the previous frame that is reprojected
+    // (m_pHistoryCamera is nullptr if there is no previous frame with the current settings).
+    std::vector<float> m_depthBuffer;
+    util::AlignedVector<glm::vec4> m_historyFrameBuffer;
+    std::vector<float> m_historyDepthBuffer;
+    std::unique_ptr<render::RayTraceCamera> m_pHistoryCamera;
+    int m_interleavePhase { 0 };
+
+    // Thick-slab mode: the state of every pixel, and the rays through the corners of the image that it was computed for
+    // (m_slabStateValid is false if the pixels have to be computed from scratch).
+    std::vector<SlabPixel> m_slabPixels;
+    std::array<Ray, 4> m_slabCornerRays {};
+    bool m_slabStateValid { false };
 };
 
 }
@@ -3,6 +3,7 @@
 #include "ui/gl_error.h"
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/vec3.hpp>
+#include <cstring>
 
 namespace ui {
 
@@ -68,6 +69,10 @@ FullScreenTextureGL::FullScreenTextureGL()
     glBindTexture(GL_TEXTURE_2D, m_texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, 1, 1, 0, GL_RGB, GL_FLOAT, glm::value_ptr(black));
     glBindTexture(GL_TEXTURE_2D, 0);
+    m_textureInternalFormat = GL_RGB32F;
+    m_textureResolution = glm::ivec2(1);
+
+    glGenBuffers(GLsizei(m_pixelBuffers.size()), m_pixelBuffers.data());
 }
 
 FullScreenTextureGL::~FullScreenTextureGL()
@@ -75,19 +80,55 @@ FullScreenTextureGL::~FullScreenTextureGL()
     glDeleteTextures(1, &m_texture);
     glDeleteVertexArrays(1, &m_vao);
     glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(GLsizei(m_pixelBuffers.size()), m_pixelBuffers.data());
     glDeleteProgram(m_shader);
 }
 
 void FullScreenTextureGL::update(gsl::span<const glm::vec3> frameBuffer, const glm::ivec2& resolution)
 {
     glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, resolution.x, resolution.y, 0, GL_RGB, GL_FLOAT, frameBuffer.data());
+    specifyTexture(GL_RGB32F, resolution, GL_RGB, GL_FLOAT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution.x, resolution.y, GL_RGB, GL_FLOAT, frameBuffer.data());
 }
 
 void FullScreenTextureGL::update(gsl::span<const glm::vec4> frameBuffer, const glm::ivec2& resolution)
 {
     glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, resolution.x, resolution.y, 0, GL_RGBA, GL_FLOAT, frameBuffer.data());
+    specifyTexture(GL_RGBA32F, resolution, GL_RGBA, GL_FLOAT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution.x, resolution.y, GL_RGBA, GL_FLOAT, frameBuffer.data());
+}
+
+// Upload a frame of packed 8-bit RGBA pixels (red in the lowest byte) through the next pixel buffer of the ring. The
+// texture is only updated from the pixel buffer by the driver, so this returns as soon as the frame is copied into it.
+void FullScreenTextureGL::update(gsl::span<const uint32_t> frameBuffer, const glm::ivec2& resolution)
+{
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    specifyTexture(GL_RGBA8, resolution, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV);
+
+    const GLsizeiptr size = GLsizeiptr(frameBuffer.size_bytes());
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[size_t(m_nextPixelBuffer)]);
+    m_nextPixelBuffer = (m_nextPixelBuffer + 1) % numPixelBuffers;
+    // Invalidating the buffer lets the driver hand out new storage if the old one is still being read.
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    if (void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) {
+        std::memcpy(pMapped, frameBuffer.data(), size_t(size));
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        // With a pixel unpack buffer bound the data pointer is an offset into the buffer.
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, resolution.x, resolution.y, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// (Re)allocate the texture storage, only if the format or the resolution changed. The texture has to be bound (and no
+// pixel unpack buffer).
+void FullScreenTextureGL::specifyTexture(GLint internalFormat, const glm::ivec2& resolution, GLenum format, GLenum type)
+{
+    if (internalFormat == m_textureInternalFormat && resolution == m_textureResolution)
+        return;
+
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, resolution.x, resolution.y, 0, format, type, nullptr);
+    m_textureInternalFormat = internalFormat;
+    m_textureResolution = resolution;
 }
 
 void FullScreenTextureGL::draw()
@@ -1,5 +1,7 @@
 #pragma once
 #include "ui/window.h"
+#include <array>
+#include <cstdint>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -14,10 +16,21 @@ public:
 
     void update(gsl::span<const glm::vec3> frameBuffer, const glm::ivec2& resolution);
     void update(gsl::span<const glm::vec4> frameBuffer, const glm::ivec2& resolution);
+    void update(gsl::span<const uint32_t> frameBuffer, const glm::ivec2& resolution);
     void draw();
 
+private:
+    void specifyTexture(GLint internalFormat, const glm::ivec2& resolution, GLenum format, GLenum type);
+
 private:
     GLuint m_texture;
+    GLint m_textureInternalFormat { 0 };
+    glm::ivec2 m_textureResolution { 0 };
+    // Ring of pixel buffers that 8-bit frames are uploaded through. The buffer that is written was last used a few
+    // frames ago, so the copy into it does not have to wait for the transfer of the previous frame to finish.
+    static constexpr int numPixelBuffers = 3;
+    std::array<GLuint, numPixelBuffers> m_pixelBuffers;
+    int m_nextPixelBuffer { 0 };
     GLuint m_vbo, m_vao;
     GLuint m_shader;
 };
@@ -5,6 +5,8 @@
 #include <imgui.h>
 #include <iostream>
 #include <nfd.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
 #include <glm/gtx/component_wise.hpp>
 
 namespace ui {
@@ -40,6 +42,11 @@ void Menu::setInterpolationModeChangedCallback(InterpolationModeChangedCallback&
     m_optInterpolationModeChangedCallback = std::move(callback);
 }
 
+void Menu::setRenderPosterCallback(RenderPosterCallback&& callback)
+{
+    m_optRenderPosterCallback = std::move(callback);
+}
+
 render::RenderConfig Menu::renderConfig() const
 {
     return m_renderConfig;
@@ -60,6 +67,40 @@ volume::InterpolationMode Menu::interpolationMode() const
     return m_interpolationMode;
 }
 
+std::optional<volume::VolumeRegion> Menu::loadRegion() const
+{
+    if (m_loadRegionOnly)
+        return m_loadRegion;
+    return {};
+}
+
+CPUVolumeFormat Menu::cpuVolumeFormat() const
+{
+    return m_cpuVolumeFormat;
+}
+
+std::chrono::duration<double> Menu::frameBudget() const
+{
+    return std::chrono::duration<double, std::milli>(m_frameBudgetMs);
+}
+
+void Menu::setInteractiveQuality(const render::QualitySettings& quality)
+{
+    m_interactiveQuality = quality;
+}
+
+// The poster is rendered in the background; the button is replaced by a progress bar until setPosterFinished() is called.
+void Menu::setPosterProgress(float progress)
+{
+    m_optPosterProgress = progress;
+}
+
+void Menu::setPosterFinished(const std::string& message)
+{
+    m_optPosterProgress.reset();
+    m_posterStatus = message;
+}
+
 bool Menu::getCPURendererInUse()
 {
     return CPURendererInUse;
@@ -79,10 +120,12 @@ void Menu::setBaseRenderResolution(const glm::ivec2& baseRenderResolution)
 
 // This function handles a part of the volume loading where we create the widget histograms, set some config values
 //  and set the menu volume information
-void Menu::setLoadedVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume)
+void Menu::setLoadedVolume(const volume::Volume& volume, const volume::GradientProvider& gradientVolume)
 {
     m_tfWidget = TransferFunctionWidget(volume);
     m_tfWidget->updateRenderConfig(m_renderConfig);
+    m_tf2DWidget.emplace(volume, gradientVolume);
+    m_tf2DWidget->updateRenderConfig(m_renderConfig);
 
     const glm::ivec3 dim = volume.dims();
     m_volumeInfo = fmt::format("Volume info:\n{}\nDimensions: ({}, {}, {})\nVoxel value range: {} - {}\n",
@@ -96,6 +139,32 @@ void Menu::setLoadedVolume(const volume::Volume& volume, const volume::GradientV
     m_renderConfig.renderMode = render::RenderMode::RenderSlicer;
 }
 
+// Called when a new volume starts loading. The widgets refer to the previous volume, which is destroyed at this point,
+//  and the volume dependent tabs are hidden until setLoadedVolume() is called.
+void Menu::setVolumeLoading(const std::filesystem::path& file)
+{
+    m_tfWidget.reset();
+    m_tf2DWidget.reset();
+    m_volumeLoaded = false;
+    m_volumeInfo = fmt::format("Loading {}...", file.filename().string());
+}
+
+// Called when loading the volume failed. Nothing is loaded anymore, so the menu only shows the error.
+void Menu::setVolumeLoadFailed(const std::string& error)
+{
+    m_tfWidget.reset();
+    m_tf2DWidget.reset();
+    m_volumeLoaded = false;
+    m_volumeInfo = fmt::format("Could not load the volume:\n{}", error);
+}
+
+// The joint histogram of the loaded volume, which the 2D transfer function widget shows once it is computed.
+void Menu::setJointHistogram(const volume::JointHistogram& histogram)
+{
+    if (m_tf2DWidget)
+        m_tf2DWidget->setHistogram(histogram);
+}
+
 //This overloaded function is used for the vector fields instead of the DVR implementation
 void Menu::setLoadedVolume(const volume::Volume& volume)
 {
@@ -129,6 +198,7 @@ void Menu::drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::
             showRayCastTab(renderTime, renderTimeFrame);
             showGPURayCastTab(renderTime, renderTimeFrame);
             showTransFuncTab();
+            showTransFunc2DTab();
         } else {
             showTransFuncTab();
         }
@@ -168,7 +238,22 @@ void Menu::showLoadVolTab()
             }
         }
 
-        if (m_volumeLoaded)
+        // Only the rows of voxels inside the region are read, which makes it possible to look at a part of a volume that
+        // is too large to load in full.
+        ImGui::Checkbox("Load region of interest only", &m_loadRegionOnly);
+        if (m_loadRegionOnly) {
+            ImGui::InputInt3("Region begin (voxels)", &m_loadRegion.begin.x);
+            ImGui::InputInt3("Region end (voxels)", &m_loadRegion.end.x);
+        }
+        // The compressed and quantized copies are built after loading, so this takes effect with the next load.
+        int* pCPUVolumeFormatInt = reinterpret_cast<int*>(&m_cpuVolumeFormat);
+        ImGui::Text("CPU renderer samples:");
+        ImGui::RadioButton("Full volume", pCPUVolumeFormatInt, int(CPUVolumeFormat::Full));
+        ImGui::RadioButton("Compressed volume (lossless)", pCPUVolumeFormatInt, int(CPUVolumeFormat::Compressed));
+        ImGui::RadioButton("Quantized volume (lossy)", pCPUVolumeFormatInt, int(CPUVolumeFormat::Quantized));
+        ImGui::NewLine();
+
+        if (!m_volumeInfo.empty())
             ImGui::Text("%s", m_volumeInfo.c_str());
 
         ImGui::EndTabItem();
@@ -185,6 +270,11 @@ void Menu::showRayCastTab(std::chrono::duration<double> renderTime, std::chrono:
         const std::string renderText = fmt::format("rendering time(last new frame): {}ms\n{} FPS\nrendering resolution: ({}, {})\n",
             std::chrono::duration_cast<std::chrono::milliseconds>(renderTime).count(), 1.0 / renderTimeFrame.count() , m_renderConfig.renderResolution.x, m_renderConfig.renderResolution.y);
         ImGui::Text("%s", renderText.c_str());
+        const std::string qualityText = fmt::format("quality during interaction: {:.0f}% (resolution {:.0f}%, step size x{:.2f}{})",
+            100.0f * m_interactiveQuality.quality, 100.0f * m_interactiveQuality.resolutionScale, m_interactiveQuality.stepSizeScale,
+            m_interactiveQuality.nearestNeighbour ? ", nearest neighbour" : "");
+        ImGui::Text("%s", qualityText.c_str());
+        ImGui::DragFloat("Frame Budget (ms)", &m_frameBudgetMs, 0.5f, 2.0f, 200.0f);
         ImGui::NewLine();
 
         int* pRenderModeInt = reinterpret_cast<int*>(&m_renderConfig.renderMode);
@@ -193,9 +283,26 @@ void Menu::showRayCastTab(std::chrono::duration<double> renderTime, std::chrono:
         ImGui::RadioButton("MIP", pRenderModeInt, int(render::RenderMode::RenderMIP));
         ImGui::RadioButton("IsoSurface Rendering", pRenderModeInt, int(render::RenderMode::RenderIso));
         ImGui::RadioButton("Compositing", pRenderModeInt, int(render::RenderMode::RenderComposite));
+        ImGui::RadioButton("2D Transfer Function", pRenderModeInt, int(render::RenderMode::RenderTF2D));
+        ImGui::RadioButton("Thick Slab", pRenderModeInt, int(render::RenderMode::RenderSlab));
+        ImGui::Checkbox("Fused View (MIP, Iso, Compositing)", &m_renderConfig.fusedView);
+
+        ImGui::NewLine();
+        int* pSlabProjectionInt = reinterpret_cast<int*>(&m_renderConfig.slabProjection);
+        ImGui::Text("Slab Projection:");
+        ImGui::RadioButton("Maximum", pSlabProjectionInt, int(render::SlabProjection::Maximum));
+        ImGui::SameLine();
+        ImGui::RadioButton("Minimum", pSlabProjectionInt, int(render::SlabProjection::Minimum));
+        ImGui::SameLine();
+        ImGui::RadioButton("Average", pSlabProjectionInt, int(render::SlabProjection::Average));
+        const float halfDiagonal = 0.5f * glm::length(glm::vec3(m_volumeDimensions));
+        ImGui::DragFloat("Slab Offset", &m_renderConfig.slabOffset, 0.25f, -halfDiagonal, halfDiagonal);
+        ImGui::DragFloat("Slab Thickness", &m_renderConfig.slabThickness, 0.25f, 0.0f, 2.0f * halfDiagonal);
         
         ImGui::NewLine();
         ImGui::Checkbox("Volume Shading", &m_renderConfig.volumeShading);
+        ImGui::Checkbox("Cached Illumination", &m_renderConfig.useIlluminationCache);
+        ImGui::Checkbox("Ambient Occlusion", &m_renderConfig.ambientOcclusion);
 
         ImGui::NewLine();
         ImGui::DragFloat("Iso Value", &m_renderConfig.isoValue, 1.0f, 0.0f, float(m_volumeMax));
@@ -205,12 +312,45 @@ void Menu::showRayCastTab(std::chrono::duration<double> renderTime, std::chrono:
         ImGui::NewLine();
         ImGui::DragFloat("Step Size", &m_renderConfig.stepSize, 0.25f, 0.25f, 5.0f);
 
+        ImGui::NewLine();
+        ImGui::Checkbox("Progressive Refinement", &m_renderConfig.progressiveRefinement);
+        ImGui::DragInt("Samples Per Pixel", &m_renderConfig.progressiveSamples, 1.0f, 1, 64);
+        ImGui::Checkbox("Adaptive Sampling", &m_renderConfig.adaptiveSampling);
+        ImGui::DragFloat("Adaptive Threshold", &m_renderConfig.adaptiveThreshold, 0.005f, 0.0f, 0.5f);
+        ImGui::Checkbox("Brick-Ordered Tracing", &m_renderConfig.brickOrderedTracing);
+        ImGui::Checkbox("Interleaved Rendering While Moving", &m_renderConfig.interleavedRendering);
+        ImGui::Text("Traced Pixels Per Frame:");
+        ImGui::RadioButton("1/2 (checkerboard)", &m_renderConfig.interleaveFactor, 2);
+        ImGui::SameLine();
+        ImGui::RadioButton("1/4", &m_renderConfig.interleaveFactor, 4);
+        ImGui::Checkbox("8-bit Framebuffer (Faster Upload)", &m_renderConfig.compactFrameBuffer);
+
+        ImGui::NewLine();
+        showCropBox();
+
         ImGui::NewLine();
         int* pInterpolationModeInt = reinterpret_cast<int*>(&m_interpolationMode);
         ImGui::Text("Interpolation:");
         ImGui::RadioButton("Nearest Neighbour", pInterpolationModeInt, int(volume::InterpolationMode::NearestNeighbour));
         ImGui::RadioButton("Linear", pInterpolationModeInt, int(volume::InterpolationMode::Linear));
 
+        // Posters are rendered in strips that are written to the file directly, so they can be much larger than the screen.
+        ImGui::NewLine();
+        ImGui::InputInt2("Poster Resolution", &m_posterResolution.x);
+        m_posterResolution = glm::max(m_posterResolution, glm::ivec2(1));
+        if (m_optPosterProgress) {
+            ImGui::Text("Rendering poster...");
+            ImGui::ProgressBar(*m_optPosterProgress);
+        } else if (ImGui::Button("Render Poster (PPM)")) {
+            nfdchar_t* pOutPath = nullptr;
+            nfdresult_t result = NFD_SaveDialog("ppm", nullptr, &pOutPath);
+
+            if (result == NFD_OKAY && m_optRenderPosterCallback)
+                (*m_optRenderPosterCallback)(std::filesystem::path(pOutPath), m_posterResolution);
+        }
+        if (!m_optPosterProgress && !m_posterStatus.empty())
+            ImGui::TextWrapped("%s", m_posterStatus.c_str());
+
         ImGui::EndTabItem();
     }
 }
@@ -225,7 +365,7 @@ void Menu::showGPURayCastTab(std::chrono::duration<double> renderTime, std::chro
             std::chrono::duration_cast<std::chrono::milliseconds>(renderTime).count(), 1.0 / renderTimeFrame.count(), m_renderConfig.renderResolution.x, m_renderConfig.renderResolution.y);
         ImGui::Text("%s", renderText.c_str());
         ImGui::NewLine();
-        if (m_renderConfig.renderMode == render::RenderMode::RenderSlicer ) {
+        if (m_renderConfig.renderMode == render::RenderMode::RenderSlicer || m_renderConfig.renderMode == render::RenderMode::RenderTF2D || m_renderConfig.renderMode == render::RenderMode::RenderSlab) {
             m_renderConfig.renderMode = render::RenderMode::RenderMIP;
         }
 
@@ -240,6 +380,7 @@ void Menu::showGPURayCastTab(std::chrono::duration<double> renderTime, std::chro
 
         ImGui::NewLine();
         ImGui::Checkbox("Volume Shading", &m_renderConfig.volumeShading);
+        ImGui::Checkbox("Ambient Occlusion", &m_renderConfig.ambientOcclusion);
 
         ImGui::NewLine();
         ImGui::DragFloat("Iso Value", &m_renderConfig.isoValue, 1.0f, 0.0f, float(m_volumeMax));
@@ -260,6 +401,10 @@ void Menu::showGPURayCastTab(std::chrono::duration<double> renderTime, std::chro
         ImGui::NewLine();
         ImGui::Checkbox("Use volume bricking", &m_gpuVolumeConfig.useVolumeBricking);
         ImGui::DragInt("Brick size", &m_gpuVolumeConfig.brickSize, 1, 8, glm::compMax(m_volumeDimensions));
+        ImGui::Checkbox("Quantized 8 bit volume (lossy)", &m_gpuVolumeConfig.useQuantizedVolume);
+
+        ImGui::NewLine();
+        showCropBox();
 
         ImGui::NewLine();
 
@@ -289,6 +434,24 @@ void Menu::showTransFuncTab()
     }
 }
 
+void Menu::showTransFunc2DTab()
+{
+    if (ImGui::BeginTabItem("2D transfer function")) {
+        m_tf2DWidget->draw();
+        m_tf2DWidget->updateRenderConfig(m_renderConfig);
+        ImGui::EndTabItem();
+    }
+}
+
+// This renders the sliders of the crop box, which is shared by the CPU and GPU raycasters.
+void Menu::showCropBox()
+{
+    ImGui::Text("Crop box:");
+    ImGui::DragFloatRange2("Crop X", &m_renderConfig.cropMin.x, &m_renderConfig.cropMax.x, 0.005f, 0.0f, 1.0f);
+    ImGui::DragFloatRange2("Crop Y", &m_renderConfig.cropMin.y, &m_renderConfig.cropMax.y, 0.005f, 0.0f, 1.0f);
+    ImGui::DragFloatRange2("Crop Z", &m_renderConfig.cropMin.z, &m_renderConfig.cropMax.z, 0.005f, 0.0f, 1.0f);
+}
+
 void Menu::callRenderConfigChangedCallback() const
 {
     if (m_optRenderConfigChangedCallback)
@@ -2,8 +2,10 @@
 #include "render/render_config.h"
 #include "render/gpu_mesh_config.h"
 #include "render/gpu_volume_config.h"
+#include "render/quality_controller.h"
 #include "ui/transfer_func.h"
-#include "volume/gradient_volume.h"
+#include "ui/transfer_func_2d.h"
+#include "volume/gradient_provider.h"
 #include "volume/volume.h"
 #include <chrono>
 #include <filesystem>
@@ -21,6 +23,13 @@ class GPURenderer;
 }
 
 namespace ui {
+// Representation of the volume that the CPU renderer samples (see volume::VolumeSampler).
+enum class CPUVolumeFormat {
+    Full = 0,
+    Compressed,
+    Quantized
+};
+
 class Menu {
 public:
     Menu(const glm::ivec2& baseRenderResolution);
@@ -35,15 +44,28 @@ public:
     void setGPUVolumeConfigChangedCallback(GPUVolumeConfigChangedCallback&& callback);
     using InterpolationModeChangedCallback = std::function<void(volume::InterpolationMode)>;
     void setInterpolationModeChangedCallback(InterpolationModeChangedCallback&& callback);
+    using RenderPosterCallback = std::function<void(const std::filesystem::path&, const glm::ivec2&)>;
+    void setRenderPosterCallback(RenderPosterCallback&& callback);
 
     render::RenderConfig renderConfig() const;
     render::GPUMeshConfig meshConfig() const;
     render::GPUVolumeConfig volumeConfig() const;
     volume::InterpolationMode interpolationMode() const;
+    // The region of interest that the user selected to load instead of the whole volume.
+    std::optional<volume::VolumeRegion> loadRegion() const;
+    CPUVolumeFormat cpuVolumeFormat() const;
+    // Time that frames rendered during interaction should take.
+    std::chrono::duration<double> frameBudget() const;
 
     void setBaseRenderResolution(const glm::ivec2& baseRenderResolution);
-    void setLoadedVolume(const volume::Volume& volume, const volume::GradientVolume& gradientVolume);
+    void setVolumeLoading(const std::filesystem::path& file);
+    void setVolumeLoadFailed(const std::string& error);
+    void setLoadedVolume(const volume::Volume& volume, const volume::GradientProvider& gradientVolume);
     void setLoadedVolume(const volume::Volume& volume);
+    void setJointHistogram(const volume::JointHistogram& histogram);
+    void setInteractiveQuality(const render::QualitySettings& quality);
+    void setPosterProgress(float progress);
+    void setPosterFinished(const std::string& message);
 
     void drawMenu(const glm::ivec2& pos, const glm::ivec2& size, std::chrono::duration<double> renderTime, std::chrono::duration<double> renderTimeFrame);
 
@@ -56,6 +78,8 @@ private:
     void showRayCastTab(std::chrono::duration<double> renderTime, std::chrono::duration<double> renderTimeFrame);
     void showGPURayCastTab(std::chrono::duration<double> renderTime, std::chrono::duration<double> renderTimeFrame);
     void showTransFuncTab();
+    void showTransFunc2DTab();
+    void showCropBox();
 
     void callRenderConfigChangedCallback() const;
     void callGPUMeshConfigChangedCallback() const;
@@ -72,9 +96,19 @@ private:
 
     glm::vec4 m_mouseRect;
 
+    bool m_loadRegionOnly { false };
+    volume::VolumeRegion m_loadRegion { glm::ivec3(0), glm::ivec3(256) };
+    CPUVolumeFormat m_cpuVolumeFormat { CPUVolumeFormat::Full };
+
     std::optional<TransferFunctionWidget> m_tfWidget;
+    std::optional<TransferFunction2DWidget> m_tf2DWidget;
 
     glm::ivec2 m_baseRenderResolution;
+    glm::ivec2 m_posterResolution { 8192, 8192 };
+    std::optional<float> m_optPosterProgress; // Set while a poster is rendering.
+    std::string m_posterStatus;
+    float m_frameBudgetMs { 1000.0f / 60.0f };
+    render::QualitySettings m_interactiveQuality {};
     float m_resolutionScale { 1.0f };
     render::RenderConfig m_renderConfig {};
     render::GPUMeshConfig m_gpuMeshConfig {};
@@ -86,6 +120,7 @@ private:
     std::optional<GPUMeshConfigChangedCallback> m_optGPUMeshConfigChangedCallback;
     std::optional<GPUVolumeConfigChangedCallback> m_optGPUVolumeConfigChangedCallback;
     std::optional<InterpolationModeChangedCallback> m_optInterpolationModeChangedCallback;
+    std::optional<RenderPosterCallback> m_optRenderPosterCallback;
 };
 
 }
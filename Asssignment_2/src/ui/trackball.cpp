@@ -61,6 +61,14 @@ void Trackball::setWorldScale(float scale)
     m_worldScale = scale;
 }
 
+void Trackball::scaleWorld(float factor)
+{
+    m_lookAt *= factor;
+    m_distanceFromLookAt *= factor;
+    m_worldScale *= factor;
+    updateCameraPos();
+}
+
 glm::vec3 Trackball::position() const
 {
     return m_cameraPos;
@@ -106,6 +114,22 @@ render::Ray Trackball::generateRay(const glm::vec2& pixel) const
     return ray;
 }
 
+std::optional<glm::vec2> Trackball::project(const glm::vec3& point) const
+{
+    const glm::vec3 cameraSpacePoint = glm::inverse(m_rotation) * (point - m_cameraPos);
+    if (cameraSpacePoint.z <= 0.0f)
+        return {};
+
+    const float halfScreenPlaceHeight = std::tan(m_fovy / 2.0f);
+    const float halfScreenPlaceWidth = m_aspectRatio * halfScreenPlaceHeight;
+    return glm::vec2(cameraSpacePoint) / cameraSpacePoint.z / glm::vec2(halfScreenPlaceWidth, halfScreenPlaceHeight);
+}
+
+std::unique_ptr<render::RayTraceCamera> Trackball::clone() const
+{
+    return std::make_unique<Trackball>(*this);
+}
+
 glm::vec4 Trackball::getRectByMouse() const
 {
     return m_mouseRect;
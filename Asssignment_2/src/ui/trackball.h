@@ -20,6 +20,9 @@ public:
     void setLookAt(const glm::vec3& lookAt);
     void setDistance(float distance);
     void setWorldScale(float scale);
+    // Scale the scene around the origin without changing the rotation, e.g. when a volume is replaced by a
+    // version with a different resolution.
+    void scaleWorld(float factor);
 
     glm::vec3 position() const override;
     glm::mat4 viewMatrix() const override;
@@ -31,6 +34,8 @@ public:
 
     // Generate ray given pixel in NDC space (-1 to +1)
     render::Ray generateRay(const glm::vec2& pixel) const override;
+    std::optional<glm::vec2> project(const glm::vec3& point) const override;
+    std::unique_ptr<render::RayTraceCamera> clone() const override;
 
     glm::vec4 getRectByMouse()const;
 
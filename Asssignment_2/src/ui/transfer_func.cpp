@@ -10,7 +10,7 @@
 #include <iostream>
 
 static GLuint createTexture();
-static std::vector<glm::vec4> createHistogramImage(gsl::span<const int> data, float opacity);
+static std::vector<glm::vec4> createHistogramImage(gsl::span<const int64_t> data, float opacity);
 static ImVec2 glmToIm(const glm::vec2& v);
 static glm::vec2 ImToGlm(const ImVec2& v);
 
@@ -275,9 +275,9 @@ GLuint createTexture()
 }
 
 // Compute a histogram texture from the histogram vector
-static std::vector<glm::vec4> createHistogramImage(gsl::span<const int> data, float opacity)
+static std::vector<glm::vec4> createHistogramImage(gsl::span<const int64_t> data, float opacity)
 {
-    const int maxVal = *std::max_element(std::begin(data), std::end(data));
+    const int64_t maxVal = *std::max_element(std::begin(data), std::end(data));
     const glm::uvec2 res { data.size(), widgetSize.y };
 
     const float scale = float(widgetSize.y) / (float(maxVal) * 1.1f);
@@ -0,0 +1,204 @@
+#include "ui/transfer_func_2d.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <imgui.h>
+#include <utility>
+
+static GLuint createTexture();
+static std::vector<glm::vec4> createHistogramImage(const volume::JointHistogram& histogram, float opacity);
+static ImVec2 glmToIm(const glm::vec2& v);
+static glm::vec2 ImToGlm(const ImVec2& v);
+
+// Radius of the control points of the triangle.
+static constexpr float pointRadius = 8.0f;
+static constexpr glm::ivec2 widgetSize { 475, 300 };
+static constexpr float histogramOpacity = 0.8f;
+
+namespace ui {
+
+TransferFunction2DWidget::TransferFunction2DWidget(const volume::Volume& volume, const volume::GradientProvider& gradient)
+    : m_pGradient(&gradient)
+    , m_histogramImg(createTexture())
+    , m_intensity(volume.maximum() / 2.0f)
+    , m_maxIntensity(volume.maximum())
+    , m_radius(volume.maximum() / 8.0f)
+    , m_color(0.0f, 0.8f, 0.6f, 0.3f)
+{
+}
+
+TransferFunction2DWidget::TransferFunction2DWidget(TransferFunction2DWidget&& other) noexcept
+    : m_pGradient(other.m_pGradient)
+    , m_histogramImg(std::exchange(other.m_histogramImg, 0))
+    , m_histogramValid(other.m_histogramValid)
+    , m_intensity(other.m_intensity)
+    , m_maxIntensity(other.m_maxIntensity)
+    , m_radius(other.m_radius)
+    , m_maxMagnitude(other.m_maxMagnitude)
+    , m_color(other.m_color)
+    , m_interactingPoint(other.m_interactingPoint)
+{
+}
+
+TransferFunction2DWidget& TransferFunction2DWidget::operator=(TransferFunction2DWidget&& other) noexcept
+{
+    if (this != &other) {
+        glDeleteTextures(1, &m_histogramImg);
+        m_pGradient = other.m_pGradient;
+        m_histogramImg = std::exchange(other.m_histogramImg, 0);
+        m_histogramValid = other.m_histogramValid;
+        m_intensity = other.m_intensity;
+        m_maxIntensity = other.m_maxIntensity;
+        m_radius = other.m_radius;
+        m_maxMagnitude = other.m_maxMagnitude;
+        m_color = other.m_color;
+        m_interactingPoint = other.m_interactingPoint;
+    }
+    return *this;
+}
+
+// Deleting texture 0 (of a widget that was moved from) is ignored by OpenGL.
+TransferFunction2DWidget::~TransferFunction2DWidget()
+{
+    glDeleteTextures(1, &m_histogramImg);
+}
+
+// The histogram needs the gradient of every voxel, so the application computes it on a worker thread after loading and
+// the widget only shows it once it is ready. The gradient magnitude range is known at that point.
+void TransferFunction2DWidget::setHistogram(const volume::JointHistogram& histogram)
+{
+    m_maxMagnitude = m_pGradient->maxMagnitude();
+
+    const auto imgData = createHistogramImage(histogram, histogramOpacity);
+
+    glBindTexture(GL_TEXTURE_2D, m_histogramImg);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, GLsizei(histogram.numBins().x), GLsizei(histogram.numBins().y), 0, GL_RGBA, GL_FLOAT, imgData.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_histogramValid = true;
+}
+
+void TransferFunction2DWidget::updateRenderConfig(render::RenderConfig& renderConfig) const
+{
+    renderConfig.TF2DIntensity = m_intensity;
+    renderConfig.TF2DRadius = m_radius;
+    renderConfig.TF2DColor = m_color;
+}
+
+// Draw the widget and handle interactions.
+void TransferFunction2DWidget::draw()
+{
+    const ImGuiIO& io = ImGui::GetIO();
+
+    ImGui::Text("2D Transfer Function");
+    ImGui::TextWrapped("Left click + drag the bottom point to change the intensity and the top right point to change the radius.");
+    if (!m_histogramValid)
+        ImGui::Text("Computing the joint histogram...");
+
+    const glm::vec2 canvasSize { widgetSize.x, widgetSize.y - 20 };
+    glm::vec2 canvasPos = ImToGlm(ImGui::GetCursorScreenPos()); // this is the imgui draw cursor, not mouse cursor
+    const float xOffset = (ImToGlm(ImGui::GetContentRegionAvail()).x - canvasSize.x);
+    canvasPos.x += xOffset; // center widget
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(glmToIm(canvasPos), glmToIm(canvasPos + canvasSize));
+    drawList->AddRect(glmToIm(canvasPos), glmToIm(canvasPos + canvasSize), ImColor(180, 180, 180, 255));
+
+    // Draw the joint histogram that we uploaded to the GPU using OpenGL.
+    const ImVec2 cursorPos = ImVec2(ImGui::GetCursorPosX() + xOffset, ImGui::GetCursorPosY());
+    ImGui::SetCursorPos(cursorPos);
+    ImTextureID imguiTexture;
+    std::memcpy(&imguiTexture, &m_histogramImg, sizeof(m_histogramImg));
+    ImGui::Image(imguiTexture, glmToIm(canvasSize - glm::vec2(1)));
+
+    // Place an invisible button on top of the canvas to detect whether the cursor is inside of it.
+    ImGui::SetCursorPos(cursorPos);
+    ImGui::InvisibleButton("tfn2d_canvas", glmToIm(canvasSize));
+
+    // Maps (intensity, gradient magnitude) to screen space; gradient magnitude increases upwards.
+    const glm::vec2 valueRange { std::max(m_maxIntensity, 1e-6f), std::max(m_maxMagnitude, 1e-6f) };
+    const glm::vec2 viewScale = glm::vec2(canvasSize.x - 1, -(canvasSize.y - 1)) / valueRange;
+    const glm::vec2 viewOffset(canvasPos.x, canvasPos.y + canvasSize.y);
+
+    const glm::vec2 apex = glm::vec2(m_intensity, 0.0f) * viewScale + viewOffset;
+    const glm::vec2 topLeft = glm::vec2(m_intensity - m_radius, m_maxMagnitude) * viewScale + viewOffset;
+    const glm::vec2 topRight = glm::vec2(m_intensity + m_radius, m_maxMagnitude) * viewScale + viewOffset;
+
+    if (!io.MouseDown[0])
+        m_interactingPoint = InteractingPoint::None;
+
+    if (ImGui::IsItemHovered() && io.MouseDown[0]) {
+        const glm::vec2 mousePos = ImToGlm(io.MousePos);
+        if (m_interactingPoint == InteractingPoint::None) {
+            if (glm::distance(mousePos, apex) < pointRadius)
+                m_interactingPoint = InteractingPoint::Apex;
+            else if (glm::distance(mousePos, topRight) < pointRadius)
+                m_interactingPoint = InteractingPoint::Radius;
+        }
+
+        const float mouseIntensity = std::clamp((mousePos.x - viewOffset.x) / viewScale.x, 0.0f, m_maxIntensity);
+        if (m_interactingPoint == InteractingPoint::Apex)
+            m_intensity = mouseIntensity;
+        else if (m_interactingPoint == InteractingPoint::Radius)
+            m_radius = std::max(mouseIntensity - m_intensity, 0.0f);
+    }
+
+    // Draw the triangle and its control points.
+    const ImU32 fillColor = ImColor(m_color.r, m_color.g, m_color.b, std::max(m_color.a, 0.1f));
+    drawList->AddTriangleFilled(glmToIm(apex), glmToIm(topLeft), glmToIm(topRight), fillColor);
+    drawList->AddTriangle(glmToIm(apex), glmToIm(topLeft), glmToIm(topRight), 0xFFFFFFFF);
+    drawList->AddCircleFilled(glmToIm(apex), pointRadius, m_interactingPoint == InteractingPoint::Apex ? 0xFFAAFFFF : 0xFFFFFFFF);
+    drawList->AddCircleFilled(glmToIm(topRight), pointRadius, m_interactingPoint == InteractingPoint::Radius ? 0xFFAAFFFF : 0xFFFFFFFF);
+
+    drawList->PopClipRect();
+
+    // Bottom text
+    ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset + canvasSize.x / 2 - 80);
+    ImGui::Text("Voxel Value / Gradient Magnitude");
+
+    ImGui::NewLine();
+    ImGui::SetCursorPosX(ImGui::GetCursorPosX() + xOffset / 2);
+    ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth() * 0.4f);
+    ImGui::ColorPicker4("Color", glm::value_ptr(m_color));
+}
+
+}
+
+static GLuint createTexture()
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return tex;
+}
+
+// Compute a (log scaled) histogram texture. The first image row is the top of the widget, so it contains the highest gradient magnitudes.
+static std::vector<glm::vec4> createHistogramImage(const volume::JointHistogram& histogram, float opacity)
+{
+    const glm::ivec2 res = histogram.numBins();
+    const std::vector<float> logCounts = histogram.logScaled();
+
+    std::vector<glm::vec4> imgData(static_cast<size_t>(res.x * res.y));
+    for (int y = 0; y < res.y; y++) {
+        const int magnitudeBin = res.y - 1 - y;
+        for (int x = 0; x < res.x; x++)
+            imgData[static_cast<size_t>(x + y * res.x)] = glm::vec4(1.0f, 1.0f, 1.0f, opacity * logCounts[static_cast<size_t>(x + magnitudeBin * res.x)]);
+    }
+    return imgData;
+}
+
+// Vector conversion functions for glm - Imgui interaction
+static ImVec2 glmToIm(const glm::vec2& v)
+{
+    return ImVec2(v.x, v.y);
+}
+
+static glm::vec2 ImToGlm(const ImVec2& v)
+{
+    return glm::vec2(v.x, v.y);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "render/render_config.h"
+#include "volume/gradient_provider.h"
+#include "volume/joint_histogram.h"
+#include "volume/volume.h"
+#include <GL/glew.h> // Include before glfw3
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+namespace ui {
+
+// Widget for the 2D (intensity x gradient magnitude) transfer function. The transfer function is a single triangle
+// with its apex at (intensity, 0) that widens to the given radius at the maximum gradient magnitude.
+class TransferFunction2DWidget {
+public:
+    TransferFunction2DWidget(const volume::Volume& volume, const volume::GradientProvider& gradient);
+    // The widget owns the histogram texture, so it can only be moved.
+    TransferFunction2DWidget(TransferFunction2DWidget&& other) noexcept;
+    TransferFunction2DWidget& operator=(TransferFunction2DWidget&& other) noexcept;
+    ~TransferFunction2DWidget();
+
+    void setHistogram(const volume::JointHistogram& histogram);
+    void draw();
+    void updateRenderConfig(render::RenderConfig& renderConfig) const;
+
+private:
+    enum class InteractingPoint {
+        None,
+        Apex,
+        Radius
+    };
+
+    const volume::GradientProvider* m_pGradient;
+
+    GLuint m_histogramImg;
+    bool m_histogramValid { false };
+
+    float m_intensity, m_maxIntensity;
+    float m_radius;
+    float m_maxMagnitude { 1.0f };
+    glm::vec4 m_color;
+
+    InteractingPoint m_interactingPoint { InteractingPoint::None };
+};
+}
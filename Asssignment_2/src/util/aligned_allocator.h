@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <gsl/span>
+#include <new>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace util {
+
+// Allocator for the large buffers (voxels, gradients and the framebuffer). It is enabled with the VOLVIS_ALIGNED_ALLOCATOR
+// CMake option; without it, it behaves like std::allocator so that both can be compared.
+//
+// Every buffer is aligned to a cache line. Buffers of at least one huge page (2MB) are aligned to the huge page size and
+// marked with madvise(MADV_HUGEPAGE), so that Linux backs them with transparent huge pages: random 3D accesses into a
+// multi-GB volume otherwise miss the TLB on almost every sample.
+//
+// The elements are default initialized instead of value initialized, so resize() does not write to the memory. A page
+// is placed on the NUMA node of the thread that first writes to it, so buffers have to be initialized in parallel
+// (see parallelFill()) instead of by the single thread that allocates them.
+template <typename T>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    static constexpr size_t cacheLineSize = 64;
+    static constexpr size_t hugePageSize = size_t(2) << 20;
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) noexcept { }
+
+    T* allocate(size_t n)
+    {
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+        const size_t alignment = std::max(n * sizeof(T) >= hugePageSize ? hugePageSize : cacheLineSize, alignof(T));
+        // aligned_alloc requires the size to be a multiple of the alignment.
+        const size_t sizeInBytes = (n * sizeof(T) + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+        void* p = _aligned_malloc(sizeInBytes, alignment);
+#else
+        void* p = std::aligned_alloc(alignment, sizeInBytes);
+#endif
+        if (!p)
+            throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (alignment == hugePageSize)
+            madvise(p, sizeInBytes, MADV_HUGEPAGE); // Only a hint; fails harmlessly when THP is disabled.
+#endif
+        return static_cast<T*>(p);
+#else
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+#endif
+    }
+
+    void deallocate(T* p, size_t) noexcept
+    {
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+#else
+        ::operator delete(p);
+#endif
+    }
+
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+    template <typename U>
+    void construct(U* p) noexcept(noexcept(U()))
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+#endif
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const noexcept { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Fill a buffer from all OpenMP threads, so that its pages are spread over the NUMA nodes that the rendering threads
+// run on. Each thread writes a contiguous range, like the static schedule of the loops that use the buffers.
+template <typename T>
+void parallelFill(gsl::span<T> data, const T& value)
+{
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+    constexpr size_t blockSize = std::max(AlignedAllocator<T>::hugePageSize / sizeof(T), size_t(1));
+    const size_t size = size_t(data.size());
+    const int numBlocks = int((size + blockSize - 1) / blockSize);
+#pragma omp parallel for schedule(static)
+    for (int block = 0; block < numBlocks; block++) {
+        const size_t begin = size_t(block) * blockSize;
+        const auto blockData = data.subspan(begin, std::min(blockSize, size - begin));
+        std::fill(blockData.begin(), blockData.end(), value);
+    }
+#else
+    std::fill(data.begin(), data.end(), value);
+#endif
+}
+
+// Copy a buffer into one of the same size from all OpenMP threads, with the same distribution as parallelFill(), so that
+// the pages of a newly allocated buffer are first touched by the threads that render from it.
+template <typename T>
+void parallelCopy(gsl::span<const T> source, gsl::span<T> destination)
+{
+    assert(source.size() == destination.size());
+#ifdef VOLVIS_ALIGNED_ALLOCATOR
+    constexpr size_t blockSize = std::max(AlignedAllocator<T>::hugePageSize / sizeof(T), size_t(1));
+    const size_t size = size_t(source.size());
+    const int numBlocks = int((size + blockSize - 1) / blockSize);
+#pragma omp parallel for schedule(static)
+    for (int block = 0; block < numBlocks; block++) {
+        const size_t begin = size_t(block) * blockSize;
+        const auto blockData = source.subspan(begin, std::min(blockSize, size - begin));
+        std::copy(blockData.begin(), blockData.end(), destination.begin() + begin);
+    }
+#else
+    std::copy(source.begin(), source.end(), destination.begin());
+#endif
+}
+}
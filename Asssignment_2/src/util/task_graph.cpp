@@ -0,0 +1,190 @@
+#include "task_graph.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <utility>
+
+namespace util {
+
+TaskGraph::TaskGraph(unsigned numWorkers)
+    : m_numWorkers(std::max(numWorkers, 1u))
+    , m_creationTime(std::chrono::steady_clock::now())
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+    }
+    m_stateChanged.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+// The tasks themselves are mostly parallelized with OpenMP, so a few workers are enough to overlap them.
+unsigned TaskGraph::defaultNumWorkers()
+{
+    return std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+}
+
+// Add a task that runs after all of its dependencies finished. Dependencies have to be added before their dependents.
+TaskGraph::TaskID TaskGraph::addTask(std::string name, Thread thread, std::vector<TaskID> dependencies, std::function<void()> func)
+{
+    std::lock_guard lock { m_mutex };
+    assert(!m_started);
+
+    const TaskID id = m_tasks.size();
+    for (TaskID dependency : dependencies) {
+        assert(dependency < id);
+        m_tasks[dependency].dependents.push_back(id);
+    }
+    m_tasks.push_back(Task { std::move(name), thread, std::move(func), {}, dependencies.size(), State::Waiting });
+    m_numUnfinishedTasks++;
+    return id;
+}
+
+// Schedule the tasks without dependencies and start the worker threads.
+void TaskGraph::start()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_started = true;
+        for (TaskID task = 0; task < m_tasks.size(); task++) {
+            if (m_tasks[task].numPendingDependencies == 0)
+                markReady(task);
+        }
+    }
+
+    for (unsigned i = 0; i < m_numWorkers; i++)
+        m_workers.emplace_back([this]() { workerLoop(); });
+}
+
+// Run all main thread tasks that are ready, including those that become ready while doing so. Does not block otherwise.
+void TaskGraph::runMainThreadTasks()
+{
+    std::unique_lock lock { m_mutex };
+    while (!m_readyMainThreadTasks.empty()) {
+        const TaskID task = m_readyMainThreadTasks.front();
+        m_readyMainThreadTasks.erase(std::begin(m_readyMainThreadTasks));
+        execute(lock, task);
+    }
+    rethrowError();
+}
+
+// Block until all tasks finished, running the main thread tasks in the meantime.
+void TaskGraph::wait()
+{
+    std::unique_lock lock { m_mutex };
+    while (m_numUnfinishedTasks > 0) {
+        m_stateChanged.wait(lock, [this]() { return m_numUnfinishedTasks == 0 || hasReadyMainThreadTask(); });
+        while (!m_readyMainThreadTasks.empty()) {
+            const TaskID task = m_readyMainThreadTasks.front();
+            m_readyMainThreadTasks.erase(std::begin(m_readyMainThreadTasks));
+            execute(lock, task);
+        }
+    }
+    rethrowError();
+}
+
+bool TaskGraph::isFinished(TaskID task) const
+{
+    std::lock_guard lock { m_mutex };
+    return m_tasks[task].state == State::Finished;
+}
+
+// Returns true when every task either finished or was cancelled because a dependency failed.
+bool TaskGraph::isFinished() const
+{
+    std::lock_guard lock { m_mutex };
+    return m_numUnfinishedTasks == 0;
+}
+
+void TaskGraph::workerLoop()
+{
+    std::unique_lock lock { m_mutex };
+    while (true) {
+        m_stateChanged.wait(lock, [this]() { return m_stop || m_numUnfinishedTasks == 0 || !m_readyWorkerTasks.empty(); });
+        if (m_stop || m_numUnfinishedTasks == 0)
+            return;
+
+        const TaskID task = m_readyWorkerTasks.front();
+        m_readyWorkerTasks.erase(std::begin(m_readyWorkerTasks));
+        execute(lock, task);
+    }
+}
+
+// Run a task with the lock released and schedule its dependents afterwards (or cancel them if it failed).
+void TaskGraph::execute(std::unique_lock<std::mutex>& lock, TaskID taskID)
+{
+    m_tasks[taskID].state = State::Running;
+    const std::function<void()> func = std::move(m_tasks[taskID].func);
+    lock.unlock();
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    std::exception_ptr error;
+    try {
+        func();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    const auto end = clock::now();
+
+    lock.lock();
+    Task& task = m_tasks[taskID];
+    std::cout << "Task " << task.name << " executed in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << "ms (finished " << std::chrono::duration<double, std::milli>(end - m_creationTime).count() << "ms after the graph was created)" << std::endl;
+
+    m_numUnfinishedTasks--;
+    if (error) {
+        task.state = State::Cancelled;
+        if (!m_error)
+            m_error = error;
+        for (TaskID dependent : task.dependents)
+            cancel(dependent);
+    } else {
+        task.state = State::Finished;
+        for (TaskID dependent : task.dependents) {
+            if (--m_tasks[dependent].numPendingDependencies == 0 && m_tasks[dependent].state == State::Waiting)
+                markReady(dependent);
+        }
+    }
+    m_stateChanged.notify_all();
+}
+
+void TaskGraph::markReady(TaskID task)
+{
+    m_tasks[task].state = State::Ready;
+    if (m_tasks[task].thread == Thread::Main)
+        m_readyMainThreadTasks.push_back(task);
+    else
+        m_readyWorkerTasks.push_back(task);
+}
+
+void TaskGraph::cancel(TaskID taskID)
+{
+    Task& task = m_tasks[taskID];
+    if (task.state != State::Waiting)
+        return;
+    task.state = State::Cancelled;
+    m_numUnfinishedTasks--;
+    for (TaskID dependent : task.dependents)
+        cancel(dependent);
+}
+
+bool TaskGraph::hasReadyMainThreadTask() const
+{
+    return !m_readyMainThreadTasks.empty();
+}
+
+// Rethrow the first error of a task on the main thread (only once).
+void TaskGraph::rethrowError()
+{
+    if (m_error) {
+        std::exception_ptr error = std::exchange(m_error, nullptr);
+        std::rethrow_exception(error);
+    }
+}
+}
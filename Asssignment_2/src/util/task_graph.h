@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// Runs a set of tasks with dependencies between them. Tasks without a (pending) dependency on each other run concurrently
+// on a small pool of worker threads. Tasks that need the OpenGL context are marked as main thread tasks and are executed
+// by the thread that owns the graph when it calls runMainThreadTasks() (once per frame) or wait().
+//
+// All tasks have to be added before start(). An exception thrown by a task cancels the tasks that depend on it and is
+// rethrown on the main thread by the next call to runMainThreadTasks() or wait().
+class TaskGraph {
+public:
+    using TaskID = size_t;
+    enum class Thread {
+        Worker,
+        Main
+    };
+
+    TaskGraph(unsigned numWorkers = defaultNumWorkers());
+    // Tasks that did not start yet are cancelled, running tasks are waited for.
+    ~TaskGraph();
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskID addTask(std::string name, Thread thread, std::vector<TaskID> dependencies, std::function<void()> func);
+    void start();
+
+    void runMainThreadTasks();
+    void wait();
+
+    bool isFinished(TaskID task) const;
+    bool isFinished() const;
+
+    static unsigned defaultNumWorkers();
+
+private:
+    enum class State {
+        Waiting,
+        Ready,
+        Running,
+        Finished,
+        Cancelled
+    };
+    struct Task {
+        std::string name;
+        Thread thread;
+        std::function<void()> func;
+        std::vector<TaskID> dependents;
+        size_t numPendingDependencies;
+        State state;
+    };
+
+    void workerLoop();
+    void execute(std::unique_lock<std::mutex>& lock, TaskID task);
+    void markReady(TaskID task);
+    void cancel(TaskID task);
+    bool hasReadyMainThreadTask() const;
+    void rethrowError();
+
+private:
+    const unsigned m_numWorkers;
+    const std::chrono::steady_clock::time_point m_creationTime;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_stateChanged;
+    std::vector<Task> m_tasks;
+    std::vector<TaskID> m_readyWorkerTasks, m_readyMainThreadTasks;
+    size_t m_numUnfinishedTasks { 0 };
+    std::exception_ptr m_error;
+    bool m_started { false };
+    bool m_stop { false };
+
+    std::vector<std::thread> m_workers;
+};
+}
@@ -0,0 +1,290 @@
+#include "compressed_volume.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <iostream>
+#include <memory>
+
+namespace volume {
+
+static std::atomic<uint64_t> s_nextInstanceID { 1 };
+
+thread_local std::unique_ptr<CompressedVolume::BrickCache> CompressedVolume::s_pBrickCache;
+
+// Integers up to 2^24 are exactly representable as floats, so offsets from the brick minimum in that range can be
+// converted back without any rounding.
+static constexpr float maxExactInteger = 16777216.0f;
+
+static bool isExactInteger(float value)
+{
+    return std::abs(value) <= maxExactInteger && value == std::floor(value);
+}
+
+// Number of bits needed to store values in [0, maxValue].
+static uint8_t bitWidth(uint32_t maxValue)
+{
+    uint8_t bits = 0;
+    while (maxValue > 0) {
+        maxValue >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+static void appendBits(std::vector<uint64_t>& words, uint64_t& bitPos, uint32_t value, uint8_t bits)
+{
+    const size_t word = bitPos >> 6;
+    const unsigned shift = unsigned(bitPos & 63);
+    if (word >= words.size())
+        words.push_back(0);
+    words[word] |= uint64_t(value) << shift;
+    // The value continues in the next word.
+    if (shift + bits > 64)
+        words.push_back(uint64_t(value) >> (64 - shift));
+    bitPos += bits;
+}
+
+static uint32_t readBits(const uint64_t* pWords, uint64_t bitPos, uint8_t bits)
+{
+    const size_t word = bitPos >> 6;
+    const unsigned shift = unsigned(bitPos & 63);
+    uint64_t value = pWords[word] >> shift;
+    if (shift + bits > 64)
+        value |= pWords[word + 1] << (64 - shift);
+    return uint32_t(value & ((uint64_t(1) << bits) - 1));
+}
+
+CompressedVolume::CompressedVolume(const Volume& volume)
+    : m_fileName(volume.fileName())
+    , m_dim(volume.dims())
+    , m_numBricks((volume.dims() + brickSize - 1) / brickSize)
+    , m_minimum(volume.minimum())
+    , m_maximum(volume.maximum())
+    , m_instanceID(s_nextInstanceID++)
+    , m_brickHeaders(size_t(m_numBricks.x) * size_t(m_numBricks.y) * size_t(m_numBricks.z))
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    // Every brick is packed into its own words first, so that the bricks can be compressed in parallel.
+    const gsl::span<const float> data = volume.getDataView();
+    const int numBricks = int(m_brickHeaders.size());
+    std::vector<std::vector<uint64_t>> brickWords(m_brickHeaders.size());
+#pragma omp parallel
+    {
+        std::vector<float> values;
+        values.reserve(voxelsPerBrick);
+
+#pragma omp for schedule(static)
+        for (int brickIndex = 0; brickIndex < numBricks; brickIndex++) {
+            const glm::ivec3 brick { brickIndex % m_numBricks.x, (brickIndex / m_numBricks.x) % m_numBricks.y, brickIndex / (m_numBricks.x * m_numBricks.y) };
+            const glm::ivec3 origin = brick * brickSize;
+            const glm::ivec3 extent = brickExtent(brick);
+
+            values.clear();
+            for (int z = 0; z < extent.z; z++) {
+                for (int y = 0; y < extent.y; y++) {
+                    const auto row = data.subspan(voxelIndex(m_dim, origin.x, origin.y + y, origin.z + z), size_t(extent.x));
+                    values.insert(std::end(values), std::begin(row), std::end(row));
+                }
+            }
+
+            const auto [pMin, pMax] = std::minmax_element(std::begin(values), std::end(values));
+            const bool integral = std::all_of(std::begin(values), std::end(values), isExactInteger) && *pMax - *pMin <= maxExactInteger;
+
+            BrickHeader& header = m_brickHeaders[size_t(brickIndex)];
+            header.raw = !integral;
+            header.base = integral ? *pMin : 0.0f;
+            header.bitsPerVoxel = integral ? bitWidth(uint32_t(int64_t(*pMax) - int64_t(*pMin))) : 32;
+
+            std::vector<uint64_t>& words = brickWords[size_t(brickIndex)];
+            if (header.bitsPerVoxel == 0)
+                continue;
+            words.reserve((values.size() * header.bitsPerVoxel + 63) / 64);
+            uint64_t bitPos = 0;
+            for (const float value : values) {
+                uint32_t bits;
+                if (integral)
+                    bits = uint32_t(int64_t(value) - int64_t(*pMin));
+                else
+                    std::memcpy(&bits, &value, sizeof(bits));
+                appendBits(words, bitPos, bits, header.bitsPerVoxel);
+            }
+        }
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < m_brickHeaders.size(); i++) {
+        m_brickHeaders[i].offset = offset;
+        offset += brickWords[i].size();
+    }
+    m_packedData.resize(offset);
+#pragma omp parallel for schedule(static)
+    for (int brickIndex = 0; brickIndex < numBricks; brickIndex++) {
+        const std::vector<uint64_t>& words = brickWords[size_t(brickIndex)];
+        std::copy(std::begin(words), std::end(words), std::begin(m_packedData) + ptrdiff_t(m_brickHeaders[size_t(brickIndex)].offset));
+    }
+
+    const auto end = clock::now();
+    std::cout << "CompressedVolume() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms, "
+              << float(voxelCount(m_dim) * sizeof(float)) / float(std::max(sizeInBytes(), size_t(1))) << "x smaller than the volume" << std::endl;
+}
+
+float CompressedVolume::minimum() const
+{
+    return m_minimum;
+}
+
+float CompressedVolume::maximum() const
+{
+    return m_maximum;
+}
+
+glm::ivec3 CompressedVolume::dims() const
+{
+    return m_dim;
+}
+
+std::string_view CompressedVolume::fileName() const
+{
+    return m_fileName;
+}
+
+// Number of bytes used to store the compressed voxels (not counting the per thread brick caches).
+size_t CompressedVolume::sizeInBytes() const
+{
+    return m_brickHeaders.size() * sizeof(BrickHeader) + m_packedData.size() * sizeof(uint64_t);
+}
+
+// This function returns a value based on the current interpolation mode. Cubic interpolation is not supported and
+// falls back to trilinear interpolation.
+float CompressedVolume::getSampleInterpolate(const glm::vec3& coord) const
+{
+    switch (interpolationMode) {
+    case InterpolationMode::NearestNeighbour: {
+        return getSampleNearestNeighbourInterpolation(coord);
+    }
+    case InterpolationMode::Linear:
+    case InterpolationMode::Cubic: {
+        return getSampleTriLinearInterpolation(coord);
+    }
+    default: {
+        throw std::exception();
+    }
+    }
+}
+
+float CompressedVolume::getVoxel(int x, int y, int z) const
+{
+    const DecompressedBrick& brick = getBrick(glm::ivec3(x, y, z) / brickSize);
+    return brick[size_t(x % brickSize) + size_t(brickSize) * (size_t(y % brickSize) + size_t(brickSize) * size_t(z % brickSize))];
+}
+
+std::vector<float> CompressedVolume::decompress() const
+{
+    std::vector<float> out(voxelCount(m_dim));
+    const int numBricks = int(m_brickHeaders.size());
+#pragma omp parallel
+    {
+        auto pBrick = std::make_unique<DecompressedBrick>();
+
+#pragma omp for schedule(static)
+        for (int brickIndex = 0; brickIndex < numBricks; brickIndex++) {
+            const glm::ivec3 brick { brickIndex % m_numBricks.x, (brickIndex / m_numBricks.x) % m_numBricks.y, brickIndex / (m_numBricks.x * m_numBricks.y) };
+            const glm::ivec3 origin = brick * brickSize;
+            const glm::ivec3 extent = brickExtent(brick);
+
+            decompressBrick(brickIndex, *pBrick);
+            for (int z = 0; z < extent.z; z++) {
+                for (int y = 0; y < extent.y; y++) {
+                    const auto pRow = std::begin(*pBrick) + brickSize * (y + brickSize * z);
+                    std::copy(pRow, pRow + extent.x, std::begin(out) + ptrdiff_t(voxelIndex(m_dim, origin.x, origin.y + y, origin.z + z)));
+                }
+            }
+        }
+    }
+    return out;
+}
+
+// This function returns the nearest neighbour value at the continuous 3D position given by coord (see Volume).
+float CompressedVolume::getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const
+{
+    if (glm::any(glm::lessThan(coord + 0.5f, glm::vec3(0))) || glm::any(glm::greaterThanEqual(coord + 0.5f, glm::vec3(m_dim))))
+        return 0.0f;
+
+    const glm::ivec3 voxel = glm::ivec3(coord + 0.5f);
+    return getVoxel(voxel.x, voxel.y, voxel.z);
+}
+
+// This function returns the trilinear interpolated value at the continuous 3D position given by coord.
+float CompressedVolume::getSampleTriLinearInterpolation(const glm::vec3& coord) const
+{
+    if (glm::any(glm::lessThan(coord, glm::vec3(0))) || glm::any(glm::greaterThan(coord, glm::vec3(m_dim - 1))))
+        return 0.0f;
+
+    const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(coord), m_dim - 2), glm::ivec3(0));
+    const glm::ivec3 p1 = glm::min(p0 + 1, m_dim - 1);
+    const glm::vec3 f = coord - glm::vec3(p0);
+
+    const float c00 = glm::mix(getVoxel(p0.x, p0.y, p0.z), getVoxel(p1.x, p0.y, p0.z), f.x);
+    const float c10 = glm::mix(getVoxel(p0.x, p1.y, p0.z), getVoxel(p1.x, p1.y, p0.z), f.x);
+    const float c01 = glm::mix(getVoxel(p0.x, p0.y, p1.z), getVoxel(p1.x, p0.y, p1.z), f.x);
+    const float c11 = glm::mix(getVoxel(p0.x, p1.y, p1.z), getVoxel(p1.x, p1.y, p1.z), f.x);
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+
+// Returns the decompressed voxels of a brick from the brick cache of the calling thread, decompressing it if needed.
+const CompressedVolume::DecompressedBrick& CompressedVolume::getBrick(const glm::ivec3& brick) const
+{
+    if (!s_pBrickCache)
+        s_pBrickCache = std::make_unique<BrickCache>();
+    BrickCache& cache = *s_pBrickCache;
+
+    const int slot = (brick.x & 3) | ((brick.y & 3) << 2) | ((brick.z & 3) << 4);
+    const int brickIndex = brick.x + m_numBricks.x * (brick.y + m_numBricks.y * brick.z);
+    if (cache.instanceIDs[size_t(slot)] != m_instanceID || cache.brickIndices[size_t(slot)] != brickIndex) {
+        decompressBrick(brickIndex, cache.bricks[size_t(slot)]);
+        cache.instanceIDs[size_t(slot)] = m_instanceID;
+        cache.brickIndices[size_t(slot)] = brickIndex;
+    }
+    return cache.bricks[size_t(slot)];
+}
+
+// Decompress a brick into a brickSize^3 array (x fastest). Voxels outside of the volume (in the bricks at the far faces) are not written.
+void CompressedVolume::decompressBrick(int brickIndex, DecompressedBrick& out) const
+{
+    const BrickHeader& header = m_brickHeaders[size_t(brickIndex)];
+    const glm::ivec3 brick { brickIndex % m_numBricks.x, (brickIndex / m_numBricks.x) % m_numBricks.y, brickIndex / (m_numBricks.x * m_numBricks.y) };
+    const glm::ivec3 extent = brickExtent(brick);
+    const uint64_t* pWords = m_packedData.data() + header.offset;
+
+    uint64_t bitPos = 0;
+    for (int z = 0; z < extent.z; z++) {
+        for (int y = 0; y < extent.y; y++) {
+            float* pRow = out.data() + brickSize * (y + brickSize * z);
+            if (header.bitsPerVoxel == 0) {
+                std::fill_n(pRow, extent.x, header.base);
+            } else if (header.raw) {
+                for (int x = 0; x < extent.x; x++, bitPos += 32) {
+                    const uint32_t bits = readBits(pWords, bitPos, 32);
+                    std::memcpy(&pRow[x], &bits, sizeof(float));
+                }
+            } else {
+                for (int x = 0; x < extent.x; x++, bitPos += header.bitsPerVoxel)
+                    pRow[x] = header.base + float(readBits(pWords, bitPos, header.bitsPerVoxel));
+            }
+        }
+    }
+}
+
+// Number of voxels of a brick in every direction; the bricks at the far faces of the volume can be smaller than brickSize.
+glm::ivec3 CompressedVolume::brickExtent(const glm::ivec3& brick) const
+{
+    return glm::min(glm::ivec3(brickSize), m_dim - brick * brickSize);
+}
+}
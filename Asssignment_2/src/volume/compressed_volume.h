@@ -0,0 +1,81 @@
+#pragma once
+#include "volume.h"
+#include "volume_sampler.h"
+#include <array>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace volume {
+
+// Losslessly compressed copy of a volume that the CPU renderer can sample instead of the volume itself.
+// The application still keeps the float volume that it was built from (the GPU volume, the gradients and the other derived
+// data read it), so rendering the compressed copy adds to the memory use instead of reducing it.
+// The volume is split into bricks of brickSize^3 voxels. The voxels of a brick are stored as offsets from the minimum of
+// the brick, bit-packed with just enough bits for the value range of the brick (so empty bricks take no space at all).
+// Bricks with values that are not integers (which is never the case for volumes loaded from a file) are stored as raw floats.
+//
+// Voxels are decompressed a brick at a time into a small cache that every thread has for itself, so sampling along a ray
+// only decompresses a brick when the ray enters it. A row of a large volume spans more bricks than fit in the cache, so
+// passes over all voxels should use decompress() instead of getVoxel(). All member functions can safely be called from
+// multiple threads.
+class CompressedVolume : public VolumeSampler {
+public:
+    static constexpr int brickSize = 8;
+
+public:
+    CompressedVolume(const Volume& volume);
+
+    float minimum() const override;
+    float maximum() const override;
+    glm::ivec3 dims() const override;
+    std::string_view fileName() const;
+
+    float getSampleInterpolate(const glm::vec3& coord) const override;
+    float getVoxel(int x, int y, int z) const override;
+    // Decompress all voxels (x fastest, then y, then z), e.g. to construct a Volume again.
+    std::vector<float> decompress() const;
+
+    size_t sizeInBytes() const;
+
+private:
+    struct BrickHeader {
+        size_t offset; // In m_packedData.
+        float base; // Minimum value of the brick.
+        uint8_t bitsPerVoxel; // 32 for raw floats.
+        bool raw;
+    };
+
+    static constexpr size_t voxelsPerBrick = size_t(brickSize) * size_t(brickSize) * size_t(brickSize);
+    using DecompressedBrick = std::array<float, voxelsPerBrick>;
+
+    // Decompressed bricks of the thread (128KB). The slot of a brick is given by its brick coordinates modulo 4, so the
+    // bricks around the current sample (e.g. the 8 bricks a trilinear sample at a brick corner needs) never evict each other.
+    struct BrickCache {
+        static constexpr int numSlots = 64;
+        std::array<uint64_t, numSlots> instanceIDs {};
+        std::array<int, numSlots> brickIndices {};
+        std::array<DecompressedBrick, numSlots> bricks;
+    };
+    static thread_local std::unique_ptr<BrickCache> s_pBrickCache; // Allocated on first use.
+
+    const DecompressedBrick& getBrick(const glm::ivec3& brick) const;
+    void decompressBrick(int brickIndex, DecompressedBrick& out) const;
+    glm::ivec3 brickExtent(const glm::ivec3& brick) const;
+
+    float getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const;
+    float getSampleTriLinearInterpolation(const glm::vec3& coord) const;
+
+private:
+    const std::string m_fileName;
+    const glm::ivec3 m_dim;
+    const glm::ivec3 m_numBricks;
+    const float m_minimum, m_maximum;
+    const uint64_t m_instanceID; // Identifies this object in the per thread brick cache.
+
+    std::vector<BrickHeader> m_brickHeaders;
+    std::vector<uint64_t> m_packedData;
+};
+}
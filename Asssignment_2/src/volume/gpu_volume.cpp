@@ -8,7 +8,7 @@
 namespace volume {
 
 GPUVolume::GPUVolume(const Volume* volume)
-    : m_volumeTexture(Texture(volume->getData(), volume->dims()))
+    : m_volumeTexture(Texture(volume->getDataView(), volume->dims()))
     , m_indexTexture(Texture(std::vector<float>(0), glm::ivec3(1)))
     , m_pVolume(volume)
     , m_minMaxValues(std::vector<glm::vec2>())
@@ -50,6 +50,24 @@ void GPUVolume::brickSizeChanged(render::RenderConfig renderConfig, std::array<f
     }
 }
 
+// Compute the min/max values per brick for the current volume config. This does not touch OpenGL so it can run on a worker
+// thread while the rest of a freshly loaded volume is being prepared. A following brickSizeChanged() with the same config
+// skips the min/max computation, so the brick cache has to be updated separately (see GPURenderer::updateVolumeBricks()).
+void GPUVolume::precomputeMinMax()
+{
+    m_brickSize = m_volumeConfig.brickSize;
+    m_useBricking = m_volumeConfig.useVolumeBricking;
+    m_volumeDims = m_pVolume->dims();
+    updateMinMax();
+}
+
+// The quantized copy of the volume that is uploaded when useQuantizedVolume is enabled. It is built on a worker thread
+// when it is first selected, so it may arrive after the first upload (see GPURenderer::updateVolumeBricks()).
+void GPUVolume::setQuantizedVolume(const QuantizedVolume* pQuantizedVolume)
+{
+    m_pQuantizedVolume = pQuantizedVolume;
+}
+
 // ======= TODO: IMPLEMENT ========
 //
 // Part of **3. Volume Bricking**
@@ -137,8 +155,19 @@ void GPUVolume::updateBrickCache(render::RenderConfig renderConfig, std::array<f
 
     // no bricking means we just add a single item and the cache becomes the volume
     if (!m_volumeConfig.useVolumeBricking) { // if volume bricking is turned off just return the entire volume
-        m_volumeTexture.update(m_pVolume->getData(), m_pVolume->dims());
-        m_indexTexture.update(std::vector<glm::vec4> { glm::vec4(0) }, glm::ivec3(1));
+        // The full volume does not depend on the transfer function, so it is only uploaded again after bricking was used
+        // or when switching between the float and quantized textures.
+        // The float volume is used until the quantized volume is available.
+        const bool useQuantizedVolume = m_volumeConfig.useQuantizedVolume && m_pQuantizedVolume;
+        if (!m_textureHoldsFullVolume || m_textureHoldsQuantizedVolume != useQuantizedVolume) {
+            if (useQuantizedVolume)
+                m_volumeTexture.update(m_pQuantizedVolume->normalizedTextureData(), m_pVolume->dims());
+            else
+                m_volumeTexture.update(m_pVolume->getDataView(), m_pVolume->dims());
+            m_indexTexture.update(std::vector<glm::vec4> { glm::vec4(0) }, glm::ivec3(1));
+            m_textureHoldsFullVolume = true;
+            m_textureHoldsQuantizedVolume = useQuantizedVolume;
+        }
         return;
     }
 
@@ -151,6 +180,7 @@ void GPUVolume::updateBrickCache(render::RenderConfig renderConfig, std::array<f
     // NOTE: this might crash as long as m_brickVolumeSize and m_indexVolumeSize are not set correctly when enabling bricking
     m_volumeTexture.update(m_brickVolume, m_brickVolumeSize);
     m_indexTexture.update(m_indexVolume, m_indexVolumeSize);
+    m_textureHoldsFullVolume = false;
 
     // stop the timer
     using clock = std::chrono::steady_clock;
@@ -182,13 +212,11 @@ glm::ivec3 GPUVolume::findOptimalDimensions(int N)
     glm::ivec3 maxSize = m_volumeTexture.getDims() / glm::ivec3(m_brickSize + 2 * m_brickPadding);
 
     // TODO: calculate the optimal dimensions for the cache volume here
-    glm::ivec3 optimalDimensions = glm::vec3(1, 1, 1);
-
     int bestEmpty = N;
     glm::ivec3 optimalDimensions = glm::ivec3(0);
     for (int x = 1; x <= maxSize.x; x++) {
         for (int y = 1; y <= maxSize.y; y++) {
-            int z = (N + x * y - 1) / x * y;
+            int z = (N + x * y - 1) / (x * y);
             if (z > maxSize.z) {
                 continue;
             }
@@ -225,6 +253,18 @@ GLuint GPUVolume::getTexId() const
     return m_volumeTexture.getTexId();
 }
 
+// Factor and offset that convert values sampled from the volume texture to voxel intensities. The quantized volume is
+// uploaded as normalized 8 bit values, which the GPU samples as fractions of the value range of the volume.
+float GPUVolume::getValueScale() const
+{
+    return m_textureHoldsFullVolume && m_textureHoldsQuantizedVolume ? m_pVolume->maximum() - m_pVolume->minimum() : 1.0f;
+}
+
+float GPUVolume::getValueOffset() const
+{
+    return m_textureHoldsFullVolume && m_textureHoldsQuantizedVolume ? m_pVolume->minimum() : 0.0f;
+}
+
 // ======= DO NOT MODIFY THIS FUNCTION ========
 // get the OpenGL id of the index texture
 GLuint GPUVolume::getIndexTexId() const
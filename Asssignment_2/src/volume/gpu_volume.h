@@ -2,6 +2,7 @@
 #define VOLUME_GPU_VOLUME_H
 
 #include "volume.h"
+#include "quantized_volume.h"
 #include "texture.h"
 #include <glm/vec3.hpp>
 #include <string>
@@ -26,9 +27,13 @@ public:
 
     void brickSizeChanged(render::RenderConfig renderConfig, std::array<float, 256>& opacitySumTable);
     void updateBrickCache(render::RenderConfig renderConfig, std::array<float, 256>& opacitySumTable);
+    void precomputeMinMax();
+    void setQuantizedVolume(const QuantizedVolume* pQuantizedVolume);
 
     GLuint getTexId() const;
     GLuint getIndexTexId() const;
+    float getValueScale() const;
+    float getValueOffset() const;
     
     void updateInterpolation();
 
@@ -49,6 +54,9 @@ private:
 
     int m_brickSize;
     bool m_useBricking;
+    bool m_textureHoldsFullVolume { true }; // Whether the volume and index textures are set up for rendering without bricking (the constructor uploads the full volume).
+    bool m_textureHoldsQuantizedVolume { false }; // Whether the full volume was uploaded from m_pQuantizedVolume.
+    const QuantizedVolume* m_pQuantizedVolume { nullptr }; // Built when it is first selected, see setQuantizedVolume().
     int m_brickPadding;
     glm::ivec3 m_volumeDims;
 
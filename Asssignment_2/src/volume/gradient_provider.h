@@ -0,0 +1,30 @@
+#pragma once
+#include "volume_sampler.h"
+#include <glm/vec3.hpp>
+
+namespace volume {
+struct GradientVoxel {
+    glm::vec3 dir;
+    float magnitude;
+};
+
+// Common interface of the precomputed (GradientVolume) and on-demand (LazyGradientVolume) gradient sources,
+// so that the renderers do not need to know whether the gradients of the whole volume have been computed up front.
+class GradientProvider {
+public:
+    // DO NOT REMOVE
+    InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
+
+public:
+    virtual ~GradientProvider() = default;
+
+    virtual GradientVoxel getGradientInterpolate(const glm::vec3& coord) const = 0;
+    virtual GradientVoxel getGradient(int x, int y, int z) const = 0;
+
+    virtual float minMagnitude() const = 0;
+    virtual float maxMagnitude() const = 0;
+    // Whether minMagnitude() and maxMagnitude() return immediately, instead of first computing the range.
+    virtual bool hasMagnitudeRange() const { return true; }
+    virtual glm::ivec3 dims() const = 0;
+};
+}
@@ -1,63 +1,129 @@
 #include "gradient_volume.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <exception>
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vector_relational.hpp>
 #include <gsl/span>
+#include <iostream>
+#include <limits>
 
 namespace volume {
 
-// Compute the maximum magnitude from all gradient voxels
-static float computeMaxMagnitude(gsl::span<const GradientVoxel> data)
+// The packed gradient voxels together with their magnitude range.
+struct ComputedGradients {
+    util::AlignedVector<PackedGradientVoxel> voxels;
+    float minMagnitude, maxMagnitude;
+};
+
+// Returns the reciprocal of the distance between the lower and upper neighbour of a voxel in one direction.
+// This is 1/2 for central differences, 1 for one-sided differences at the faces and 0 if the volume is 1 voxel thick.
+static float differenceScale(int lower, int upper)
 {
-    return std::max_element(
-        std::begin(data),
-        std::end(data),
-        [](const GradientVoxel& lhs, const GradientVoxel& rhs) {
-            return lhs.magnitude < rhs.magnitude;
-        })
-        ->magnitude;
+    return upper > lower ? 1.0f / float(upper - lower) : 0.0f;
 }
 
-// Compute the minimum magnitude from all gradient voxels
-static float computeMinMagnitude(gsl::span<const GradientVoxel> data)
+// Calls f(index, gradient) for every voxel of slice z. Central differences are used except at the faces of the volume,
+// where one of the neighbours is missing and one-sided differences are used instead.
+// Within a row the neighbours in y and z are fixed row pointers, so the loop over the interior of a row only does
+// contiguous loads.
+template <typename F>
+static void forEachGradientInSlice(const float* pData, const glm::ivec3& dim, int z, F&& f)
 {
-    return std::min_element(
-        std::begin(data),
-        std::end(data),
-        [](const GradientVoxel& lhs, const GradientVoxel& rhs) {
-            return lhs.magnitude < rhs.magnitude;
-        })
-        ->magnitude;
+    const size_t rowSize = size_t(dim.x);
+    const size_t sliceSize = rowSize * size_t(dim.y);
+    const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, dim.z - 1);
+    const float zScale = differenceScale(z0, z1);
+
+    for (int y = 0; y < dim.y; y++) {
+        const int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, dim.y - 1);
+        const float yScale = differenceScale(y0, y1);
+
+        const size_t rowOffset = size_t(y) * rowSize + size_t(z) * sliceSize;
+        const float* pRow = pData + rowOffset;
+        const float* pRowY0 = pData + size_t(y0) * rowSize + size_t(z) * sliceSize;
+        const float* pRowY1 = pData + size_t(y1) * rowSize + size_t(z) * sliceSize;
+        const float* pRowZ0 = pData + size_t(y) * rowSize + size_t(z0) * sliceSize;
+        const float* pRowZ1 = pData + size_t(y) * rowSize + size_t(z1) * sliceSize;
+
+        const auto gradient = [&](int x, float gx) {
+            return glm::vec3 { gx, (pRowY1[x] - pRowY0[x]) * yScale, (pRowZ1[x] - pRowZ0[x]) * zScale };
+        };
+
+        // Interior of the row: central differences in x.
+        for (int x = 1; x < dim.x - 1; x++)
+            f(rowOffset + size_t(x), gradient(x, (pRow[x + 1] - pRow[x - 1]) * 0.5f));
+
+        // First and last voxel of the row: one-sided differences in x.
+        const int lastX = dim.x - 1;
+        f(rowOffset, gradient(0, (pRow[std::min(1, lastX)] - pRow[0]) * differenceScale(0, std::min(1, lastX))));
+        if (lastX > 0)
+            f(rowOffset + size_t(lastX), gradient(lastX, pRow[lastX] - pRow[lastX - 1]));
+    }
 }
 
-// Compute a gradient volume from a volume
-static std::vector<GradientVoxel> computeGradientVolume(const Volume& volume)
+// Compute the packed gradient volume from a volume in two parallel passes over the z-slices.
+// The first pass only determines the magnitude range (tracked per slice because MSVC's OpenMP has no min/max reductions),
+// which the second pass needs to quantize the magnitudes. Recomputing the differences is cheaper than keeping
+// an unpacked copy of all gradients in memory.
+static ComputedGradients computeGradientVolume(const Volume& volume)
 {
-    const auto dim = volume.dims();
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    const glm::ivec3 dim = volume.dims();
+    const float* pData = volume.getDataView().data();
+
+    std::vector<glm::vec2> sliceMagnitudeRanges(size_t(dim.z));
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < dim.z; z++) {
+        glm::vec2 range { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+        forEachGradientInSlice(pData, dim, z, [&](size_t, const glm::vec3& v) {
+            const float magnitude = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+            range.x = std::min(range.x, magnitude);
+            range.y = std::max(range.y, magnitude);
+        });
+        sliceMagnitudeRanges[size_t(z)] = range;
+    }
 
-    std::vector<GradientVoxel> out(static_cast<size_t>(dim.x * dim.y * dim.z));
-    for (int z = 1; z < dim.z - 1; z++) {
-        for (int y = 1; y < dim.y - 1; y++) {
-            for (int x = 1; x < dim.x - 1; x++) {
-                const float gx = (volume.getVoxel(x + 1, y, z) - volume.getVoxel(x - 1, y, z)) / 2.0f;
-                const float gy = (volume.getVoxel(x, y + 1, z) - volume.getVoxel(x, y - 1, z)) / 2.0f;
-                const float gz = (volume.getVoxel(x, y, z + 1) - volume.getVoxel(x, y, z - 1)) / 2.0f;
+    ComputedGradients out;
+    out.minMagnitude = std::numeric_limits<float>::max();
+    out.maxMagnitude = std::numeric_limits<float>::lowest();
+    for (const glm::vec2& range : sliceMagnitudeRanges) {
+        out.minMagnitude = std::min(out.minMagnitude, range.x);
+        out.maxMagnitude = std::max(out.maxMagnitude, range.y);
+    }
 
-                const glm::vec3 v { gx, gy, gz };
-                const size_t index = static_cast<size_t>(x + dim.x * (y + dim.y * z));
-                out[index] = GradientVoxel { v, glm::length(v) };
-            }
-        }
+    // resize() leaves the voxels uninitialized, so the pages are first touched by the threads that encode the slices.
+    out.voxels.resize(voxelCount(dim));
+    PackedGradientVoxel* pOut = out.voxels.data();
+    const float maxMagnitude = out.maxMagnitude;
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < dim.z; z++) {
+        forEachGradientInSlice(pData, dim, z, [&](size_t index, const glm::vec3& v) {
+            pOut[index] = encodeGradient(v, std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z), maxMagnitude);
+        });
     }
+
+    const auto end = clock::now();
+    std::cout << "computeGradientVolume() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
     return out;
 }
 
 GradientVolume::GradientVolume(const Volume& volume)
-    : m_dim(volume.dims())
-    , m_data(computeGradientVolume(volume))
-    , m_minMagnitude(computeMinMagnitude(m_data))
-    , m_maxMagnitude(computeMaxMagnitude(m_data))
+    : GradientVolume(volume.dims(), computeGradientVolume(volume))
+{
+}
+
+GradientVolume::GradientVolume(const glm::ivec3& dim, ComputedGradients&& gradients)
+    : m_dim(dim)
+    , m_data(std::move(gradients.voxels))
+    , m_minMagnitude(gradients.minMagnitude)
+    , m_maxMagnitude(gradients.maxMagnitude)
+    , m_magnitudeScale(gradients.maxMagnitude / maxPackedGradientValue)
 {
 }
 
@@ -88,11 +154,17 @@ std::vector<glm::vec4> GradientVolume::getVec4Data() const
     vec4List.reserve(m_data.size()); // Reserve space for efficiency 
     for (const auto& voxel : m_data) 
     { 
-        vec4List.emplace_back(gradientToVec4(voxel)); 
+        vec4List.emplace_back(gradientToVec4(decodeGradient(voxel, m_magnitudeScale))); 
     } 
     return vec4List;
 }
 
+// Number of bytes used to store the gradients.
+size_t GradientVolume::sizeInBytes() const
+{
+    return m_data.size() * sizeof(PackedGradientVoxel);
+}
+
 // This function returns a gradientVoxel at coord based on the current interpolation mode.
 GradientVoxel GradientVolume::getGradientInterpolate(const glm::vec3& coord) const
 {
@@ -124,29 +196,38 @@ GradientVoxel GradientVolume::getGradientNearestNeighbor(const glm::vec3& coord)
         return static_cast<int>(f + 0.5f);
     };
 
-    return getGradient(roundToPositiveInt(coord.x), roundToPositiveInt(coord.y), roundToPositiveInt(coord.z));
+    // Coordinates in the last half voxel would round to one past the end of the volume.
+    return getGradient(std::min(roundToPositiveInt(coord.x), m_dim.x - 1), std::min(roundToPositiveInt(coord.y), m_dim.y - 1), std::min(roundToPositiveInt(coord.z), m_dim.z - 1));
 }
 
-// ======= TODO : IMPLEMENT ========
 // Returns the trilinearly interpolated gradinet at the given coordinate.
-// Use the linearInterpolate function that you implemented below.
+// The 8 surrounding voxels are decoded from the packed representation before they are interpolated.
 GradientVoxel GradientVolume::getGradientLinearInterpolate(const glm::vec3& coord) const
 {
-    return GradientVoxel {};
+    if (glm::any(glm::lessThan(coord, glm::vec3(0))) || glm::any(glm::greaterThan(coord, glm::vec3(m_dim - 1))))
+        return { glm::vec3(0.0f), 0.0f };
+
+    const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(coord), m_dim - 2), glm::ivec3(0));
+    const glm::ivec3 p1 = glm::min(p0 + 1, m_dim - 1);
+    const glm::vec3 f = coord - glm::vec3(p0);
+
+    const GradientVoxel g00 = linearInterpolate(getGradient(p0.x, p0.y, p0.z), getGradient(p1.x, p0.y, p0.z), f.x);
+    const GradientVoxel g10 = linearInterpolate(getGradient(p0.x, p1.y, p0.z), getGradient(p1.x, p1.y, p0.z), f.x);
+    const GradientVoxel g01 = linearInterpolate(getGradient(p0.x, p0.y, p1.z), getGradient(p1.x, p0.y, p1.z), f.x);
+    const GradientVoxel g11 = linearInterpolate(getGradient(p0.x, p1.y, p1.z), getGradient(p1.x, p1.y, p1.z), f.x);
+    return linearInterpolate(linearInterpolate(g00, g10, f.y), linearInterpolate(g01, g11, f.y), f.z);
 }
 
-// ======= TODO : IMPLEMENT ========
-// This function should linearly interpolates the value from g0 to g1 given the factor (t).
-// At t=0, linearInterpolate should return g0 and at t=1 it returns g1.
+// This function linearly interpolates the value from g0 to g1 given the factor (t).
+// At t=0, linearInterpolate returns g0 and at t=1 it returns g1.
 GradientVoxel GradientVolume::linearInterpolate(const GradientVoxel& g0, const GradientVoxel& g1, float factor)
 {
-    return GradientVoxel {};
+    return GradientVoxel { glm::mix(g0.dir, g1.dir, factor), glm::mix(g0.magnitude, g1.magnitude, factor) };
 }
 
 // This function returns a gradientVoxel without using interpolation
 GradientVoxel GradientVolume::getGradient(int x, int y, int z) const
 {
-    const size_t i = static_cast<size_t>(x + m_dim.x * (y + m_dim.y * z));
-    return m_data[i];
+    return decodeGradient(m_data[voxelIndex(m_dim, x, y, z)], m_magnitudeScale);
 }
 }
\ No newline at end of file
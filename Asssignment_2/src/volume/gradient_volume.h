@@ -1,41 +1,90 @@
 #pragma once
+#include "gradient_provider.h"
+#include "util/aligned_allocator.h"
 #include "volume.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <string>
 #include <vector>
 
 namespace volume {
-struct GradientVoxel {
-    glm::vec3 dir;
-    float magnitude;
+// Gradient stored in 6 instead of 16 bytes: the direction as an octahedral-mapped unit vector (2 x 16 bit) and the
+// magnitude as a 16 bit fraction of a maximum magnitude (of the volume, or of a brick of LazyGradientVolume).
+struct PackedGradientVoxel {
+    uint16_t normal[2];
+    uint16_t magnitude;
 };
 
-class GradientVolume {
-public:
-    // DO NOT REMOVE
-    InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
+// Largest value of the 16 bit components of PackedGradientVoxel.
+inline constexpr float maxPackedGradientValue = 65535.0f;
+
+// Encode a gradient as an octahedral-mapped unit vector and a magnitude relative to maxMagnitude.
+// The octahedral mapping projects the unit sphere onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half
+// onto the corners of the [-1, 1]^2 square, which distributes the 2 x 16 bits evenly over all directions.
+inline PackedGradientVoxel encodeGradient(const glm::vec3& gradient, float magnitude, float maxMagnitude)
+{
+    glm::vec2 p { 0.0f };
+    const float l1Norm = std::abs(gradient.x) + std::abs(gradient.y) + std::abs(gradient.z);
+    if (l1Norm > 0.0f) {
+        p = glm::vec2(gradient.x, gradient.y) / l1Norm;
+        if (gradient.z < 0.0f) {
+            const glm::vec2 signs { p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f };
+            p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signs;
+        }
+    }
+    const glm::vec2 normal = glm::round((p * 0.5f + 0.5f) * maxPackedGradientValue);
+    const float relativeMagnitude = maxMagnitude > 0.0f ? std::round(magnitude / maxMagnitude * maxPackedGradientValue) : 0.0f;
+    return PackedGradientVoxel { { uint16_t(normal.x), uint16_t(normal.y) }, uint16_t(relativeMagnitude) };
+}
+
+// Decode a gradient, where magnitudeScale is the maximum magnitude that it was encoded with divided by maxPackedGradientValue.
+inline GradientVoxel decodeGradient(const PackedGradientVoxel& packed, float magnitudeScale)
+{
+    const float magnitude = float(packed.magnitude) * magnitudeScale;
+    if (packed.magnitude == 0)
+        return GradientVoxel { glm::vec3(0.0f), 0.0f };
 
+    const glm::vec2 p = glm::vec2(packed.normal[0], packed.normal[1]) * (2.0f / maxPackedGradientValue) - 1.0f;
+    glm::vec3 n { p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y) };
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return GradientVoxel { glm::normalize(n) * magnitude, magnitude };
+}
+
+struct ComputedGradients;
+
+class GradientVolume : public GradientProvider {
 public:
     GradientVolume(const Volume& volume);
 
-    GradientVoxel getGradientInterpolate(const glm::vec3& coord) const;
-    GradientVoxel getGradient(int x, int y, int z) const;
+    GradientVoxel getGradientInterpolate(const glm::vec3& coord) const override;
+    GradientVoxel getGradient(int x, int y, int z) const override;
     glm::vec4 gradientToVec4(GradientVoxel voxel) const;
 
-    float minMagnitude() const;
-    float maxMagnitude() const;
-    glm::ivec3 dims() const;
+    float minMagnitude() const override;
+    float maxMagnitude() const override;
+    glm::ivec3 dims() const override;
     std::vector<glm::vec4> getVec4Data() const;
+    size_t sizeInBytes() const;
 
 protected:
+    GradientVolume(const glm::ivec3& dim, ComputedGradients&& gradients);
+
     GradientVoxel getGradientNearestNeighbor(const glm::vec3& coord) const;
     GradientVoxel getGradientLinearInterpolate(const glm::vec3& coord) const;
     static GradientVoxel linearInterpolate(const GradientVoxel& g0, const GradientVoxel& g1, float factor);
 
 protected:
     const glm::ivec3 m_dim;
-    const std::vector<GradientVoxel> m_data;
+    const util::AlignedVector<PackedGradientVoxel> m_data;
     const float m_minMagnitude, m_maxMagnitude;
+    const float m_magnitudeScale; // Converts a packed magnitude back to the original scale.
 };
 }
@@ -0,0 +1,78 @@
+#include "joint_histogram.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace volume {
+
+// Every thread counts the voxels of a range of z-slices into its own bins, which are summed at the end.
+// This avoids atomics (or false sharing) on the heavily contended bins of the (common) low gradient magnitudes.
+JointHistogram::JointHistogram(const Volume& volume, const GradientProvider& gradient, const glm::ivec2& numBins)
+    : m_numBins(glm::max(numBins, glm::ivec2(1)))
+    , m_counts(size_t(m_numBins.x) * size_t(m_numBins.y), 0)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    const glm::ivec3 dim = volume.dims();
+    const float intensityScale = float(m_numBins.x) / std::max(volume.maximum(), 1e-6f);
+    const float magnitudeScale = float(m_numBins.y) / std::max(gradient.maxMagnitude(), 1e-6f);
+
+#pragma omp parallel
+    {
+        std::vector<int64_t> localCounts(m_counts.size(), 0);
+
+#pragma omp for schedule(static)
+        for (int z = 0; z < dim.z; z++) {
+            for (int y = 0; y < dim.y; y++) {
+                for (int x = 0; x < dim.x; x++) {
+                    const int intensityBin = std::clamp(int(volume.getVoxel(x, y, z) * intensityScale), 0, m_numBins.x - 1);
+                    const int magnitudeBin = std::clamp(int(gradient.getGradient(x, y, z).magnitude * magnitudeScale), 0, m_numBins.y - 1);
+                    localCounts[size_t(intensityBin) + size_t(m_numBins.x) * size_t(magnitudeBin)]++;
+                }
+            }
+        }
+
+#pragma omp critical
+        {
+            for (size_t i = 0; i < m_counts.size(); i++)
+                m_counts[i] += localCounts[i];
+        }
+    }
+
+    m_maxCount = *std::max_element(std::begin(m_counts), std::end(m_counts));
+
+    const auto end = clock::now();
+    std::cout << "JointHistogram() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+}
+
+glm::ivec2 JointHistogram::numBins() const
+{
+    return m_numBins;
+}
+
+int64_t JointHistogram::count(int intensityBin, int magnitudeBin) const
+{
+    return m_counts[size_t(intensityBin) + size_t(m_numBins.x) * size_t(magnitudeBin)];
+}
+
+int64_t JointHistogram::maxCount() const
+{
+    return m_maxCount;
+}
+
+// Returns log(1 + count) / log(1 + maxCount) for every bin (same layout as the counts). The counts span many orders
+// of magnitude (most voxels are background with a near zero gradient), so a linear scale would hide everything else.
+std::vector<float> JointHistogram::logScaled() const
+{
+    std::vector<float> out(m_counts.size(), 0.0f);
+    if (m_maxCount == 0)
+        return out;
+
+    const float invLogMax = 1.0f / std::log1p(float(m_maxCount));
+    std::transform(std::begin(m_counts), std::end(m_counts), std::begin(out), [=](int64_t count) { return std::log1p(float(count)) * invLogMax; });
+    return out;
+}
+
+}
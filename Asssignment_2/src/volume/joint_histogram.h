@@ -0,0 +1,27 @@
+#pragma once
+#include "gradient_provider.h"
+#include "volume.h"
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace volume {
+
+// Joint histogram of voxel intensity (x) and gradient magnitude (y), used as the background of the 2D transfer function widget.
+// Intensities are binned over [0, volume.maximum()] and gradient magnitudes over [0, gradient.maxMagnitude()].
+class JointHistogram {
+public:
+    JointHistogram(const Volume& volume, const GradientProvider& gradient, const glm::ivec2& numBins = glm::ivec2(256));
+
+    glm::ivec2 numBins() const;
+    int64_t count(int intensityBin, int magnitudeBin) const;
+    int64_t maxCount() const;
+
+    std::vector<float> logScaled() const;
+
+private:
+    glm::ivec2 m_numBins;
+    std::vector<int64_t> m_counts; // Indexed by intensityBin + magnitudeBin * m_numBins.x
+    int64_t m_maxCount { 0 };
+};
+}
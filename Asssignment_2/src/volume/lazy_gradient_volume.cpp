@@ -0,0 +1,267 @@
+#include "lazy_gradient_volume.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vector_relational.hpp>
+#include <iostream>
+#include <limits>
+
+namespace volume {
+
+static std::atomic<uint64_t> s_nextInstanceID { 1 };
+
+thread_local LazyGradientVolume::LastUsedBrick LazyGradientVolume::s_lastUsedBrick;
+
+// Same as in GradientVolume: the reciprocal of the distance between the lower and upper neighbour of a voxel.
+static float differenceScale(int lower, int upper)
+{
+    return upper > lower ? 1.0f / float(upper - lower) : 0.0f;
+}
+
+static GradientVoxel linearInterpolate(const GradientVoxel& g0, const GradientVoxel& g1, float factor)
+{
+    return GradientVoxel { glm::mix(g0.dir, g1.dir, factor), glm::mix(g0.magnitude, g1.magnitude, factor) };
+}
+
+// Interpolate the gradient at coord with the given interpolation mode, where getVoxel(ivec3) returns the gradient of a voxel.
+// Samples outside of the volume return a zero gradient, matching GradientVolume.
+template <typename F>
+static GradientVoxel interpolateGradient(InterpolationMode interpolationMode, const glm::vec3& coord, const glm::ivec3& dim, F&& getVoxel)
+{
+    switch (interpolationMode) {
+    case InterpolationMode::NearestNeighbour: {
+        if (glm::any(glm::lessThan(coord, glm::vec3(0))) || glm::any(glm::greaterThanEqual(coord, glm::vec3(dim))))
+            return { glm::vec3(0.0f), 0.0f };
+        return getVoxel(glm::min(glm::ivec3(coord + 0.5f), dim - 1));
+    }
+    case InterpolationMode::Linear:
+    case InterpolationMode::Cubic: {
+        // No cubic in this case, linear is good enough for the gradient.
+        if (glm::any(glm::lessThan(coord, glm::vec3(0))) || glm::any(glm::greaterThan(coord, glm::vec3(dim - 1))))
+            return { glm::vec3(0.0f), 0.0f };
+
+        const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(coord), dim - 2), glm::ivec3(0));
+        const glm::ivec3 p1 = glm::min(p0 + 1, dim - 1);
+        const glm::vec3 f = coord - glm::vec3(p0);
+
+        const GradientVoxel g00 = linearInterpolate(getVoxel(glm::ivec3(p0.x, p0.y, p0.z)), getVoxel(glm::ivec3(p1.x, p0.y, p0.z)), f.x);
+        const GradientVoxel g10 = linearInterpolate(getVoxel(glm::ivec3(p0.x, p1.y, p0.z)), getVoxel(glm::ivec3(p1.x, p1.y, p0.z)), f.x);
+        const GradientVoxel g01 = linearInterpolate(getVoxel(glm::ivec3(p0.x, p0.y, p1.z)), getVoxel(glm::ivec3(p1.x, p0.y, p1.z)), f.x);
+        const GradientVoxel g11 = linearInterpolate(getVoxel(glm::ivec3(p0.x, p1.y, p1.z)), getVoxel(glm::ivec3(p1.x, p1.y, p1.z)), f.x);
+        return linearInterpolate(linearInterpolate(g00, g10, f.y), linearInterpolate(g01, g11, f.y), f.z);
+    }
+    default: {
+        throw std::exception();
+    }
+    };
+}
+
+LazyGradientVolume::LazyGradientVolume(const Volume& volume, size_t maxCacheSizeInBytes)
+    : m_pVolume(&volume)
+    , m_dim(volume.dims())
+    , m_numBricks((volume.dims() + brickSize - 1) / brickSize)
+    , m_maxBricksPerShard(std::max(maxCacheSizeInBytes / (size_t(brickSize + 1) * size_t(brickSize + 1) * size_t(brickSize + 1) * sizeof(PackedGradientVoxel) * numShards), size_t(1)))
+    , m_instanceID(s_nextInstanceID++)
+{
+}
+
+// This function returns a gradientVoxel at coord based on the current interpolation mode.
+// The brick containing the sample is computed if it is not in the pool yet. If another thread is already computing it,
+// the gradients are computed from the volume instead of waiting for that thread.
+GradientVoxel LazyGradientVolume::getGradientInterpolate(const glm::vec3& coord) const
+{
+    // Both interpolation modes only access voxels of the brick that contains the lower corner of the interpolation cell.
+    const glm::ivec3 cell = interpolationMode == InterpolationMode::NearestNeighbour
+        ? glm::ivec3(coord + 0.5f)
+        : glm::ivec3(glm::max(coord, glm::vec3(0.0f)));
+    const int index = brickIndex(glm::clamp(glm::min(cell, m_dim - 2), glm::ivec3(0), m_dim - 1));
+
+    LastUsedBrick& lastUsed = s_lastUsedBrick;
+    if (lastUsed.instanceID != m_instanceID || lastUsed.pBrick->index != index) {
+        BrickPtr pBrick = getBrick(index);
+        if (!pBrick)
+            return interpolateGradient(interpolationMode, coord, m_dim, [&](const glm::ivec3& voxel) { return computeGradientVoxel(voxel.x, voxel.y, voxel.z); });
+
+        lastUsed.instanceID = m_instanceID;
+        lastUsed.pBrick = std::move(pBrick);
+    }
+
+    const Brick& brick = *lastUsed.pBrick;
+    return interpolateGradient(interpolationMode, coord, m_dim, [&](const glm::ivec3& voxel) { return brickVoxel(brick, voxel); });
+}
+
+// This function returns a gradientVoxel without using interpolation.
+// Unlike getGradientInterpolate this never computes a brick: callers that visit every voxel once (histograms,
+// brick ranges) would otherwise flush the pool, so the gradient is computed directly unless this thread
+// happens to have the brick at hand.
+GradientVoxel LazyGradientVolume::getGradient(int x, int y, int z) const
+{
+    const glm::ivec3 voxel { x, y, z };
+    const LastUsedBrick& lastUsed = s_lastUsedBrick;
+    if (lastUsed.instanceID == m_instanceID) {
+        const Brick& brick = *lastUsed.pBrick;
+        const glm::ivec3 offset = voxel - brick.origin;
+        if (glm::all(glm::greaterThanEqual(offset, glm::ivec3(0))) && glm::all(glm::lessThanEqual(offset, glm::ivec3(brickSize))))
+            return brickVoxel(brick, voxel);
+    }
+    return computeGradientVoxel(x, y, z);
+}
+
+float LazyGradientVolume::minMagnitude() const
+{
+    std::call_once(m_magnitudeRangeFlag, [this]() { computeMagnitudeRange(); });
+    return m_minMagnitude;
+}
+
+float LazyGradientVolume::maxMagnitude() const
+{
+    std::call_once(m_magnitudeRangeFlag, [this]() { computeMagnitudeRange(); });
+    return m_maxMagnitude;
+}
+
+bool LazyGradientVolume::hasMagnitudeRange() const
+{
+    return m_magnitudeRangeComputed;
+}
+
+glm::ivec3 LazyGradientVolume::dims() const
+{
+    return m_dim;
+}
+
+size_t LazyGradientVolume::numCachedBricks() const
+{
+    size_t count = 0;
+    for (Shard& shard : m_shards) {
+        std::scoped_lock lock { shard.mutex };
+        count += shard.bricks.size();
+    }
+    return count;
+}
+
+// Returns the brick from the pool, computing (and inserting) it if it is not resident.
+// Returns nullptr if another thread is computing the brick at this moment.
+LazyGradientVolume::BrickPtr LazyGradientVolume::getBrick(int index) const
+{
+    Shard& shard = m_shards[size_t(index) % numShards];
+    {
+        std::scoped_lock lock { shard.mutex };
+        if (auto iter = shard.bricks.find(index); iter != std::end(shard.bricks)) {
+            shard.lru.splice(std::begin(shard.lru), shard.lru, iter->second.second);
+            return iter->second.first;
+        }
+        if (!shard.pending.insert(index).second)
+            return nullptr;
+    }
+
+    BrickPtr pBrick = computeBrick(index);
+
+    std::scoped_lock lock { shard.mutex };
+    shard.pending.erase(index);
+    shard.lru.push_front(index);
+    shard.bricks[index] = { pBrick, std::begin(shard.lru) };
+    while (shard.bricks.size() > m_maxBricksPerShard) {
+        shard.bricks.erase(shard.lru.back());
+        shard.lru.pop_back();
+    }
+    return pBrick;
+}
+
+LazyGradientVolume::BrickPtr LazyGradientVolume::computeBrick(int index) const
+{
+    auto pBrick = std::make_shared<Brick>();
+    pBrick->index = index;
+    pBrick->origin = glm::ivec3(index % m_numBricks.x, (index / m_numBricks.x) % m_numBricks.y, index / (m_numBricks.x * m_numBricks.y)) * brickSize;
+    const size_t numVoxels = size_t(brickSize + 1) * size_t(brickSize + 1) * size_t(brickSize + 1);
+
+    // The gradients are computed unpacked first, because the magnitude range of the brick is needed to pack them.
+    // Voxels outside of the volume are never read, they only keep the layout of all bricks the same.
+    std::vector<GradientVoxel> gradients(numVoxels, GradientVoxel { glm::vec3(0.0f), 0.0f });
+    float maxMagnitude = 0.0f;
+    const glm::ivec3 end = glm::min(pBrick->origin + brickSize + 1, m_dim);
+    for (int z = pBrick->origin.z; z < end.z; z++) {
+        for (int y = pBrick->origin.y; y < end.y; y++) {
+            for (int x = pBrick->origin.x; x < end.x; x++) {
+                const glm::ivec3 offset = glm::ivec3(x, y, z) - pBrick->origin;
+                GradientVoxel& gradient = gradients[size_t(offset.x + (brickSize + 1) * (offset.y + (brickSize + 1) * offset.z))];
+                gradient = computeGradientVoxel(x, y, z);
+                maxMagnitude = std::max(maxMagnitude, gradient.magnitude);
+            }
+        }
+    }
+
+    pBrick->magnitudeScale = maxMagnitude / maxPackedGradientValue;
+    pBrick->voxels.reserve(numVoxels);
+    for (const GradientVoxel& gradient : gradients)
+        pBrick->voxels.push_back(encodeGradient(gradient.dir, gradient.magnitude, maxMagnitude));
+    return pBrick;
+}
+
+// Central differences, or one-sided differences at the faces of the volume (identical to GradientVolume).
+glm::vec3 LazyGradientVolume::computeGradient(int x, int y, int z) const
+{
+    const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, m_dim.x - 1);
+    const int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, m_dim.y - 1);
+    const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, m_dim.z - 1);
+    return glm::vec3 {
+        (m_pVolume->getVoxel(x1, y, z) - m_pVolume->getVoxel(x0, y, z)) * differenceScale(x0, x1),
+        (m_pVolume->getVoxel(x, y1, z) - m_pVolume->getVoxel(x, y0, z)) * differenceScale(y0, y1),
+        (m_pVolume->getVoxel(x, y, z1) - m_pVolume->getVoxel(x, y, z0)) * differenceScale(z0, z1)
+    };
+}
+
+GradientVoxel LazyGradientVolume::computeGradientVoxel(int x, int y, int z) const
+{
+    const glm::vec3 v = computeGradient(x, y, z);
+    return GradientVoxel { v, std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z) };
+}
+
+// The magnitude range requires the gradient of every voxel, but they are not stored. This runs once, in whichever thread
+// first asks for the range (the application computes it on a worker thread after loading, see main.cpp).
+void LazyGradientVolume::computeMagnitudeRange() const
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    std::vector<glm::vec2> sliceMagnitudeRanges(size_t(m_dim.z));
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < m_dim.z; z++) {
+        glm::vec2 range { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++) {
+                const float magnitude = computeGradientVoxel(x, y, z).magnitude;
+                range.x = std::min(range.x, magnitude);
+                range.y = std::max(range.y, magnitude);
+            }
+        }
+        sliceMagnitudeRanges[size_t(z)] = range;
+    }
+
+    m_minMagnitude = std::numeric_limits<float>::max();
+    m_maxMagnitude = std::numeric_limits<float>::lowest();
+    for (const glm::vec2& range : sliceMagnitudeRanges) {
+        m_minMagnitude = std::min(m_minMagnitude, range.x);
+        m_maxMagnitude = std::max(m_maxMagnitude, range.y);
+    }
+    m_magnitudeRangeComputed = true;
+
+    const auto end = clock::now();
+    std::cout << "LazyGradientVolume::computeMagnitudeRange() executed in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+}
+
+int LazyGradientVolume::brickIndex(const glm::ivec3& voxel) const
+{
+    const glm::ivec3 brick = voxel / brickSize;
+    return brick.x + m_numBricks.x * (brick.y + m_numBricks.y * brick.z);
+}
+
+GradientVoxel LazyGradientVolume::brickVoxel(const Brick& brick, const glm::ivec3& voxel)
+{
+    const glm::ivec3 offset = voxel - brick.origin;
+    return decodeGradient(brick.voxels[size_t(offset.x + (brickSize + 1) * (offset.y + (brickSize + 1) * offset.z))], brick.magnitudeScale);
+}
+}
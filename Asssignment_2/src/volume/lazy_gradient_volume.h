@@ -0,0 +1,90 @@
+#pragma once
+#include "gradient_provider.h"
+#include "gradient_volume.h"
+#include "volume.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace volume {
+
+// Gradient source that only computes the gradients of a brick of the volume when a sample inside of it is first requested,
+// so loading a volume does not pay for (or store) the gradients of the whole volume when they are never used.
+// Computed bricks are kept in a bounded pool that evicts the least recently used brick. Gradients outside of the pool
+// (or of a brick that another thread is still computing) are computed directly from the volume with central differences.
+// All member functions can safely be called from multiple threads at the same time.
+class LazyGradientVolume : public GradientProvider {
+public:
+    static constexpr int brickSize = 16;
+
+    LazyGradientVolume(const Volume& volume, size_t maxCacheSizeInBytes = size_t(256) << 20);
+
+    GradientVoxel getGradientInterpolate(const glm::vec3& coord) const override;
+    GradientVoxel getGradient(int x, int y, int z) const override;
+
+    float minMagnitude() const override;
+    float maxMagnitude() const override;
+    bool hasMagnitudeRange() const override;
+    glm::ivec3 dims() const override;
+
+    size_t numCachedBricks() const;
+
+private:
+    // Gradients of the (brickSize + 1)^3 voxels starting at the origin of the brick. The last layer overlaps with the
+    // next brick so that all 8 voxels of a trilinear interpolation are always found in the same brick.
+    // The gradients are packed relative to the largest magnitude in the brick, like GradientVolume does for the whole volume.
+    struct Brick {
+        int index;
+        glm::ivec3 origin;
+        float magnitudeScale;
+        std::vector<PackedGradientVoxel> voxels;
+    };
+    using BrickPtr = std::shared_ptr<const Brick>;
+
+    // The brick that a thread used last. Rays march through a brick for many consecutive samples,
+    // so this avoids taking a lock of the pool for almost all samples.
+    struct LastUsedBrick {
+        uint64_t instanceID { 0 };
+        BrickPtr pBrick;
+    };
+    static thread_local LastUsedBrick s_lastUsedBrick;
+
+    // The pool is split into shards with their own lock to reduce contention between the rendering threads.
+    struct Shard {
+        std::mutex mutex;
+        std::list<int> lru; // Most recently used brick first.
+        std::unordered_map<int, std::pair<BrickPtr, std::list<int>::iterator>> bricks;
+        std::unordered_set<int> pending; // Bricks that are being computed by some thread.
+    };
+    static constexpr size_t numShards = 16;
+
+    BrickPtr getBrick(int brickIndex) const;
+    BrickPtr computeBrick(int brickIndex) const;
+    glm::vec3 computeGradient(int x, int y, int z) const;
+    GradientVoxel computeGradientVoxel(int x, int y, int z) const;
+    void computeMagnitudeRange() const;
+
+    int brickIndex(const glm::ivec3& voxel) const;
+    static GradientVoxel brickVoxel(const Brick& brick, const glm::ivec3& voxel);
+
+private:
+    const Volume* m_pVolume;
+    const glm::ivec3 m_dim;
+    const glm::ivec3 m_numBricks;
+    const size_t m_maxBricksPerShard;
+    const uint64_t m_instanceID; // Identifies this object in the per thread brick cache.
+
+    mutable std::array<Shard, numShards> m_shards;
+
+    mutable std::once_flag m_magnitudeRangeFlag;
+    mutable float m_minMagnitude { 0.0f }, m_maxMagnitude { 0.0f };
+    mutable std::atomic_bool m_magnitudeRangeComputed { false };
+};
+}
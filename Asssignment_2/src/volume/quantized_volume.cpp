@@ -0,0 +1,181 @@
+#include "quantized_volume.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <glm/common.hpp>
+#include <glm/vector_relational.hpp>
+#include <iostream>
+#include <limits>
+
+namespace volume {
+
+static constexpr float maxRangeValue = 65535.0f;
+static constexpr float maxIndex = float((1 << QuantizedVolume::bitsPerIndex) - 1);
+
+QuantizedVolume::QuantizedVolume(const Volume& volume)
+    : m_fileName(volume.fileName())
+    , m_dim(volume.dims())
+    , m_numBlocks((volume.dims() + blockSize - 1) / blockSize)
+    , m_minimum(volume.minimum())
+    , m_maximum(volume.maximum())
+    , m_rangeScale((volume.maximum() - volume.minimum()) / maxRangeValue)
+    , m_blockRanges(size_t(m_numBlocks.x) * size_t(m_numBlocks.y) * size_t(m_numBlocks.z))
+    , m_indices(m_blockRanges.size() * bytesPerBlock, 0)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    const float invRangeScale = m_rangeScale > 0.0f ? 1.0f / m_rangeScale : 0.0f;
+    const int numBlocks = int(m_blockRanges.size());
+#pragma omp parallel for schedule(static)
+    for (int blockIndex = 0; blockIndex < numBlocks; blockIndex++) {
+        const glm::ivec3 origin = glm::ivec3(blockIndex % m_numBlocks.x, (blockIndex / m_numBlocks.x) % m_numBlocks.y, blockIndex / (m_numBlocks.x * m_numBlocks.y)) * blockSize;
+        const glm::ivec3 end = glm::min(origin + blockSize, m_dim);
+
+        float blockMin = std::numeric_limits<float>::max(), blockMax = std::numeric_limits<float>::lowest();
+        for (int z = origin.z; z < end.z; z++) {
+            for (int y = origin.y; y < end.y; y++) {
+                for (int x = origin.x; x < end.x; x++) {
+                    const float value = volume.getVoxel(x, y, z);
+                    blockMin = std::min(blockMin, value);
+                    blockMax = std::max(blockMax, value);
+                }
+            }
+        }
+
+        // Round the range outwards, so that it still contains all voxels after quantization.
+        BlockRange& range = m_blockRanges[size_t(blockIndex)];
+        range.low = uint16_t(std::clamp(std::floor((blockMin - m_minimum) * invRangeScale), 0.0f, maxRangeValue));
+        range.high = uint16_t(std::clamp(std::ceil((blockMax - m_minimum) * invRangeScale), float(range.low), maxRangeValue));
+        const float low = m_minimum + float(range.low) * m_rangeScale;
+        const float step = float(range.high - range.low) * m_rangeScale / maxIndex;
+        const float invStep = step > 0.0f ? 1.0f / step : 0.0f;
+
+        uint8_t* pIndices = m_indices.data() + size_t(blockIndex) * bytesPerBlock;
+        for (int z = origin.z; z < end.z; z++) {
+            for (int y = origin.y; y < end.y; y++) {
+                for (int x = origin.x; x < end.x; x++) {
+                    const size_t local = size_t(x - origin.x) + size_t(blockSize) * (size_t(y - origin.y) + size_t(blockSize) * size_t(z - origin.z));
+                    const uint8_t index = uint8_t(std::clamp(std::round((volume.getVoxel(x, y, z) - low) * invStep), 0.0f, maxIndex));
+                    pIndices[local / 2] |= uint8_t(index << (4 * (local % 2)));
+                }
+            }
+        }
+    }
+
+    const auto stop = clock::now();
+    std::cout << "QuantizedVolume() executed in " << std::chrono::duration<double, std::milli>(stop - start).count() << "ms" << std::endl;
+}
+
+float QuantizedVolume::minimum() const
+{
+    return m_minimum;
+}
+
+float QuantizedVolume::maximum() const
+{
+    return m_maximum;
+}
+
+glm::ivec3 QuantizedVolume::dims() const
+{
+    return m_dim;
+}
+
+std::string_view QuantizedVolume::fileName() const
+{
+    return m_fileName;
+}
+
+size_t QuantizedVolume::sizeInBytes() const
+{
+    return m_blockRanges.size() * sizeof(BlockRange) + m_indices.size();
+}
+
+// This function returns a value based on the current interpolation mode. Cubic interpolation is not supported and
+// falls back to trilinear interpolation.
+float QuantizedVolume::getSampleInterpolate(const glm::vec3& coord) const
+{
+    switch (interpolationMode) {
+    case InterpolationMode::NearestNeighbour: {
+        return getSampleNearestNeighbourInterpolation(coord);
+    }
+    case InterpolationMode::Linear:
+    case InterpolationMode::Cubic: {
+        return getSampleTriLinearInterpolation(coord);
+    }
+    default: {
+        throw std::exception();
+    }
+    }
+}
+
+// Decodes a single voxel from the range of its block and its index.
+float QuantizedVolume::getVoxel(int x, int y, int z) const
+{
+    const size_t blockIndex = size_t(x / blockSize) + size_t(m_numBlocks.x) * (size_t(y / blockSize) + size_t(m_numBlocks.y) * size_t(z / blockSize));
+    const size_t local = size_t(x % blockSize) + size_t(blockSize) * (size_t(y % blockSize) + size_t(blockSize) * size_t(z % blockSize));
+    const uint8_t index = (m_indices[blockIndex * bytesPerBlock + local / 2] >> (4 * (local % 2))) & 0xF;
+
+    const BlockRange& range = m_blockRanges[blockIndex];
+    const float low = m_minimum + float(range.low) * m_rangeScale;
+    return low + float(index) * (float(range.high - range.low) * m_rangeScale / maxIndex);
+}
+
+std::vector<float> QuantizedVolume::decompress() const
+{
+    std::vector<float> out(voxelCount(m_dim));
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++)
+                out[voxelIndex(m_dim, x, y, z)] = getVoxel(x, y, z);
+        }
+    }
+    return out;
+}
+
+// The volume textures are sampled for the voxel intensity, so the GPU renderer has to map these values back to the value
+// range (see GPUVolume::getValueScale() and GPUVolume::getValueOffset()).
+std::vector<uint8_t> QuantizedVolume::normalizedTextureData() const
+{
+    std::vector<uint8_t> out(voxelCount(m_dim));
+    const float scale = m_maximum > m_minimum ? 255.0f / (m_maximum - m_minimum) : 0.0f;
+#pragma omp parallel for schedule(static)
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            for (int x = 0; x < m_dim.x; x++)
+                out[voxelIndex(m_dim, x, y, z)] = uint8_t(std::clamp(std::round((getVoxel(x, y, z) - m_minimum) * scale), 0.0f, 255.0f));
+        }
+    }
+    return out;
+}
+
+// This function returns the nearest neighbour value at the continuous 3D position given by coord (see Volume).
+float QuantizedVolume::getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const
+{
+    if (glm::any(glm::lessThan(coord + 0.5f, glm::vec3(0))) || glm::any(glm::greaterThanEqual(coord + 0.5f, glm::vec3(m_dim))))
+        return 0.0f;
+
+    const glm::ivec3 voxel = glm::ivec3(coord + 0.5f);
+    return getVoxel(voxel.x, voxel.y, voxel.z);
+}
+
+// This function returns the trilinear interpolated value at the continuous 3D position given by coord.
+float QuantizedVolume::getSampleTriLinearInterpolation(const glm::vec3& coord) const
+{
+    if (glm::any(glm::lessThan(coord, glm::vec3(0))) || glm::any(glm::greaterThan(coord, glm::vec3(m_dim - 1))))
+        return 0.0f;
+
+    const glm::ivec3 p0 = glm::max(glm::min(glm::ivec3(coord), m_dim - 2), glm::ivec3(0));
+    const glm::ivec3 p1 = glm::min(p0 + 1, m_dim - 1);
+    const glm::vec3 f = coord - glm::vec3(p0);
+
+    const float c00 = glm::mix(getVoxel(p0.x, p0.y, p0.z), getVoxel(p1.x, p0.y, p0.z), f.x);
+    const float c10 = glm::mix(getVoxel(p0.x, p1.y, p0.z), getVoxel(p1.x, p1.y, p0.z), f.x);
+    const float c01 = glm::mix(getVoxel(p0.x, p0.y, p1.z), getVoxel(p1.x, p0.y, p1.z), f.x);
+    const float c11 = glm::mix(getVoxel(p0.x, p1.y, p1.z), getVoxel(p1.x, p1.y, p1.z), f.x);
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "volume.h"
+#include "volume_sampler.h"
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <string>
+#include <vector>
+
+namespace volume {
+
+// Lossy, block-quantized copy of a volume for previews where memory and bandwidth matter more than precision.
+// Like GPU block compression, the volume is split into blocks of 4^3 voxels that each store their value range
+// (as two 16 bit fractions of the value range of the whole volume) and a 4 bit index per voxel that selects one of
+// 16 evenly spaced values in that range. This takes 4.5 bits per voxel instead of 32 and the error of a voxel is
+// at most 1/30th of the value range of its block.
+//
+// Voxels are decoded individually, so sampling (including trilinear interpolation) never decompresses the volume.
+class QuantizedVolume : public VolumeSampler {
+public:
+    static constexpr int blockSize = 4;
+    static constexpr int bitsPerIndex = 4;
+
+public:
+    QuantizedVolume(const Volume& volume);
+
+    float minimum() const override;
+    float maximum() const override;
+    glm::ivec3 dims() const override;
+    std::string_view fileName() const;
+
+    float getSampleInterpolate(const glm::vec3& coord) const override;
+    float getVoxel(int x, int y, int z) const override;
+    // Decode all voxels (x fastest, then y, then z).
+    std::vector<float> decompress() const;
+    // Decoded voxels as 8 bit fractions of the value range [minimum(), maximum()], for uploading as a GL_R8 texture.
+    std::vector<uint8_t> normalizedTextureData() const;
+
+    size_t sizeInBytes() const;
+
+private:
+    struct BlockRange {
+        uint16_t low, high;
+    };
+
+    static constexpr size_t voxelsPerBlock = size_t(blockSize) * size_t(blockSize) * size_t(blockSize);
+    static constexpr size_t bytesPerBlock = voxelsPerBlock * size_t(bitsPerIndex) / 8;
+
+    float getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const;
+    float getSampleTriLinearInterpolation(const glm::vec3& coord) const;
+
+private:
+    const std::string m_fileName;
+    const glm::ivec3 m_dim;
+    const glm::ivec3 m_numBlocks;
+    const float m_minimum, m_maximum;
+    const float m_rangeScale; // Converts a quantized block range value back to the value range of the volume.
+
+    std::vector<BlockRange> m_blockRanges;
+    std::vector<uint8_t> m_indices; // bytesPerBlock per block, two voxels (x fastest, then y, then z) per byte.
+};
+}
@@ -9,7 +9,7 @@ Texture::Texture(const Texture& other)
 }
 
 // Constructor for float textures
-Texture::Texture(const std::vector<float>& floatTexture, glm::ivec3 dims)
+Texture::Texture(gsl::span<const float> floatTexture, glm::ivec3 dims)
     : m_dims(dims)
 {
     glGenTextures(1, &m_texId);
@@ -33,8 +33,33 @@ Texture::Texture(const std::vector<float>& floatTexture, glm::ivec3 dims)
     }
 }
 
+// Constructor for 8 bit textures, which are sampled as normalized values in [0, 1]. Takes a quarter of the memory of a float texture.
+Texture::Texture(gsl::span<const uint8_t> normalizedTexture, glm::ivec3 dims)
+    : m_dims(dims)
+{
+    glGenTextures(1, &m_texId);
+    if (dims[2] == 0) {
+        glBindTexture(GL_TEXTURE_2D, m_texId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        update(normalizedTexture, dims);
+        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+    } else {
+        glBindTexture(GL_TEXTURE_3D, m_texId);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        update(normalizedTexture, dims);
+        glBindTexture(GL_TEXTURE_3D, 0); // Unbind the texture
+    }
+}
+
 // Constructor for vec3 textures
-Texture::Texture(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims)
+Texture::Texture(gsl::span<const glm::vec3> vec3Texture, glm::ivec3 dims)
     : m_dims(dims)
 {
     glGenTextures(1, &m_texId);
@@ -59,7 +84,7 @@ Texture::Texture(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims)
 }
 
 // Constructor for vec4 textures
-Texture::Texture(const std::vector<glm::vec4>& vec4Texture, glm::ivec3 dims)
+Texture::Texture(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims)
     : m_dims(dims)
 {
     glGenTextures(1, &m_texId);
@@ -134,7 +159,7 @@ void Texture::setInterpolationMode(GLint interpolationMode)
     } 
 }
 
-void Texture::update(const std::vector<float>& floatTexture, glm::ivec3 dims)
+void Texture::update(gsl::span<const float> floatTexture, glm::ivec3 dims)
 {
     m_dims = dims;
     if (dims[2] == 0) {
@@ -148,7 +173,26 @@ void Texture::update(const std::vector<float>& floatTexture, glm::ivec3 dims)
     }
 }
 
-void Texture::update(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims)
+// Rows of 8 bit textures are not a multiple of 4 bytes, so the unpack alignment has to be lowered while uploading.
+void Texture::update(gsl::span<const uint8_t> normalizedTexture, glm::ivec3 dims)
+{
+    m_dims = dims;
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (dims[2] == 0) {
+        glBindTexture(GL_TEXTURE_2D, m_texId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_dims.x, m_dims.y, 0, GL_RED, GL_UNSIGNED_BYTE, normalizedTexture.data());
+        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+    } else {
+        glBindTexture(GL_TEXTURE_3D, m_texId);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, m_dims.x, m_dims.y, m_dims.z, 0, GL_RED, GL_UNSIGNED_BYTE, normalizedTexture.data());
+        glBindTexture(GL_TEXTURE_3D, 0); // Unbind the texture
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+}
+
+void Texture::update(gsl::span<const glm::vec3> vec3Texture, glm::ivec3 dims)
 {
     m_dims = dims;
     if (dims[2] == 0) {
@@ -162,7 +206,7 @@ void Texture::update(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims)
     }
 }
 
-void Texture::update(const std::vector<glm::vec4>& vec4Texture, glm::ivec3 dims)
+void Texture::update(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims)
 {
     m_dims = dims;
     if (dims[2] == 0) {
@@ -5,9 +5,10 @@
 #else
 #include <gl/glew.h>
 #endif
+#include <cstdint>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
-#include <vector>
+#include <gsl/span>
 
 namespace volume {
 
@@ -15,9 +16,10 @@ class Texture {
 public:
     // Copy constructor needed for the textureManager
     Texture(const Texture& other);
-    Texture(const std::vector<float>& floatTexture, glm::ivec3 dims);
-    Texture(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims);
-    Texture(const std::vector<glm::vec4>& vec4Texture, glm::ivec3 dims);
+    Texture(gsl::span<const float> floatTexture, glm::ivec3 dims);
+    Texture(gsl::span<const uint8_t> normalizedTexture, glm::ivec3 dims);
+    Texture(gsl::span<const glm::vec3> vec3Texture, glm::ivec3 dims);
+    Texture(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims);
 
     ~Texture();
 
@@ -30,9 +32,10 @@ public:
 
     void setInterpolationMode(GLint interpolationMode);
 
-    void update(const std::vector<float>& floatTexture, glm::ivec3 dims);
-    void update(const std::vector<glm::vec3>& vec3Texture, glm::ivec3 dims);
-    void update(const std::vector<glm::vec4>& vec4Texture, glm::ivec3 dims);
+    void update(gsl::span<const float> floatTexture, glm::ivec3 dims);
+    void update(gsl::span<const uint8_t> normalizedTexture, glm::ivec3 dims);
+    void update(gsl::span<const glm::vec3> vec3Texture, glm::ivec3 dims);
+    void update(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims);
 
 private:
     glm::ivec3 m_dims; // dimensions of the texture
@@ -50,13 +50,13 @@ TextureManager::~TextureManager()
     }
 }
 
-int TextureManager::addTexture(const std::vector<float> floatTexture, glm::ivec3 dims)
+int TextureManager::addTexture(gsl::span<const float> floatTexture, glm::ivec3 dims)
 {
     textureList.push_back(Texture(floatTexture, dims));
     return textureList.size() - 1;
 }
 
-int TextureManager::addTexture(const std::vector<glm::vec4> vec4Texture, glm::ivec3 dims)
+int TextureManager::addTexture(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims)
 {
     textureList.push_back(Texture(vec4Texture, dims));
     return textureList.size() - 1;
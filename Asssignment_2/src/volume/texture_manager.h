@@ -12,8 +12,8 @@ public:
 
     ~TextureManager();
 
-    int addTexture(const std::vector<float> floatTexture, glm::ivec3 dims);
-    int addTexture(const std::vector<glm::vec4> vec4Texture, glm::ivec3 dims);
+    int addTexture(gsl::span<const float> floatTexture, glm::ivec3 dims);
+    int addTexture(gsl::span<const glm::vec4> vec4Texture, glm::ivec3 dims);
 
     Texture getTexture(int index);
 
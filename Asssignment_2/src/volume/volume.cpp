@@ -9,6 +9,7 @@
 #include <glm/glm.hpp>
 #include <gsl/span>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <cstring>
 #include <unordered_map>
@@ -23,37 +24,45 @@ static Header readVolumeHeader_fld(std::ifstream& ifs);
 static Header readVolumeHeader_dat(std::ifstream& ifs);
 static Header readVectorFieldHeader(std::ifstream& ifs);
 
+static float readElement(const char* pElement, size_t elementSize);
 static float computeMinimum(gsl::span<const float> data);
 static float computeMaximum(gsl::span<const float> data);
-static std::vector<int> computeHistogram(gsl::span<const float> data);
+static std::vector<int64_t> computeHistogram(gsl::span<const float> data);
 
 namespace volume {
 
-Volume::Volume(const std::filesystem::path& file)
+Volume::Volume(const std::filesystem::path& file, int stride)
+    : Volume(file, VolumeRegion {}, stride)
+{
+}
+
+Volume::Volume(const std::filesystem::path& file, const VolumeRegion& region, int stride)
     : m_fileName(file.string())
 {
     using clock = std::chrono::high_resolution_clock;
     auto start = clock::now();
-    loadFile(file);
+    loadFile(file, region, stride);
     auto end = clock::now();
     std::cout << "Time to load: " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
 
+    // The histogram is only needed by the transfer function widget, so it is computed on first use (see histogram()).
     if (m_dataType == VolumeType::Volume && m_data.size() > 0) {
         m_minimum = computeMinimum(m_data);
         m_maximum = computeMaximum(m_data);
-        m_histogram = computeHistogram(m_data);
     }
 }
 
-Volume::Volume(std::vector<float> data, const glm::ivec3& dim)
-    : m_fileName()
+Volume::Volume(const std::vector<float>& data, const glm::ivec3& dim)
+    : m_dataType(VolumeType::Volume)
+    , m_fileName()
     , m_elementSize(2)
     , m_dim(dim)
-    , m_data(std::move(data))
-    , m_minimum(computeMinimum(m_data))
-    , m_maximum(computeMaximum(m_data))
-    , m_histogram(computeHistogram(m_data))
+    , m_data(data.size())
 {
+    // The aligned allocator leaves the samples uninitialized, so copy them from all threads to place the pages.
+    util::parallelCopy<float>(data, m_data);
+    m_minimum = computeMinimum(m_data);
+    m_maximum = computeMaximum(m_data);
 }
 
 float Volume::minimum() const
@@ -66,8 +75,15 @@ float Volume::maximum() const
     return m_maximum;
 }
 
-std::vector<int> Volume::histogram() const
+// The histogram is computed by the first caller, which makes it possible to compute it on a worker thread
+// at the same time as the other preprocessing steps after loading a volume. Returns a VIEW that stays valid for the
+// lifetime of the volume.
+gsl::span<const int64_t> Volume::histogram() const
 {
+    std::call_once(m_histogramFlag, [this]() {
+        if (m_dataType == VolumeType::Volume && m_data.size() > 0)
+            m_histogram = computeHistogram(m_data);
+    });
     return m_histogram;
 }
 
@@ -83,11 +99,11 @@ std::string_view Volume::fileName() const
 
 float Volume::getVoxel(int x, int y, int z) const
 {
-    const size_t i = size_t(x + m_dim.x * (y + m_dim.y * z));
-    return static_cast<float>(m_data[i]);
+    return m_data[voxelIndex(m_dim, x, y, z)];
 }
 
-std::vector<float> Volume::getData() const
+// Return a VIEW into the voxel data (x fastest, then y, then z). This does NOT make a copy of the data.
+gsl::span<const float> Volume::getDataView() const
 {
     return m_data;
 }
@@ -97,6 +113,19 @@ VolumeType Volume::getVolumeType() const
     return m_dataType;
 }
 
+glm::ivec3 Volume::readDims(const std::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension != ".fld" && extension != ".dat")
+        return glm::ivec3(0);
+
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open())
+        return glm::ivec3(0);
+    return readHeader(ifs, VolumeType::Volume, extension == ".fld" ? FileExtension::FLD : FileExtension::DAT).dim;
+}
+
 // This function returns a value based on the current interpolation mode
 float Volume::getSampleInterpolate(const glm::vec3& coord) const
 {
@@ -187,7 +216,7 @@ float Volume::getSampleTriCubicInterpolation(const glm::vec3& coord) const
 
 // Load an fld volume data file
 // First read and parse the header, then the volume data can be directly converted from bytes to uint16_ts
-void Volume::loadFile(const std::filesystem::path& file)
+void Volume::loadFile(const std::filesystem::path& file, const VolumeRegion& region, int stride)
 {
     assert(std::filesystem::exists(file));
     std::ifstream ifs(file, std::ios::binary);
@@ -218,7 +247,10 @@ void Volume::loadFile(const std::filesystem::path& file)
 
     switch(m_dataType) {
     case VolumeType::Volume:
-        loadVolumeData(ifs);
+        if (stride == 1 && glm::all(glm::lessThanEqual(region.begin, glm::ivec3(0))) && glm::all(glm::greaterThanEqual(region.end, m_dim)))
+            loadVolumeData(ifs);
+        else
+            loadVolumeRegion(ifs, region, stride);
         break;
     default:
         return;
@@ -228,28 +260,70 @@ void Volume::loadFile(const std::filesystem::path& file)
 
 void Volume::loadVolumeData(std::ifstream& ifs)
 {
-    const size_t voxelCount = static_cast<size_t>(m_dim.x * m_dim.y * m_dim.z);
-    const size_t byteCount = voxelCount * m_elementSize;
-    std::vector<char> buffer(byteCount);
+    const size_t numVoxels = voxelCount(m_dim);
     // Data section is separated from header by two /f characters.
     if (m_fileExtension == FileExtension::FLD) ifs.seekg(2, std::ios::cur);
-    ifs.read(buffer.data(), std::streamsize(byteCount));
 
-    m_data.resize(voxelCount);
-    if (m_elementSize == 1) { // Bytes.
-        for (size_t i = 0; i < byteCount; i++) {
-            m_data[i] = static_cast<float>(buffer[i] & 0xFF);
+    // Read and convert the data in chunks, so that the raw file contents are never in memory in full next to the floats.
+    // The conversion is done by all threads: the first write to a page of m_data decides on which NUMA node it is placed.
+    // Voxels past the end of a truncated file are zero.
+    constexpr size_t chunkVoxels = size_t(1) << 24;
+    std::vector<char> buffer(std::min(numVoxels, chunkVoxels) * m_elementSize);
+    m_data.resize(numVoxels);
+    for (size_t chunkStart = 0; chunkStart < numVoxels; chunkStart += chunkVoxels) {
+        const int chunkSize = int(std::min(chunkVoxels, numVoxels - chunkStart));
+        ifs.read(buffer.data(), std::streamsize(size_t(chunkSize) * m_elementSize));
+        std::fill(std::begin(buffer) + ifs.gcount(), std::end(buffer), char(0));
+
+        float* pChunk = m_data.data() + chunkStart;
+        const char* pBuffer = buffer.data();
+        if (m_elementSize == 1) { // Bytes.
+#pragma omp parallel for schedule(static)
+            for (int i = 0; i < chunkSize; i++) {
+                pChunk[i] = static_cast<float>(pBuffer[i] & 0xFF);
+            }
+        } else if (m_elementSize == 2) { // uint16_ts.
+#pragma omp parallel for schedule(static)
+            for (int i = 0; i < chunkSize; i++) {
+                pChunk[i] = static_cast<float>((pBuffer[2 * i] & 0xFF) + (pBuffer[2 * i + 1] & 0xFF) * 256);
+            }
         }
-    } else if (m_elementSize == 2) { // uint16_ts.
-        for (size_t i = 0; i < byteCount; i += 2) {
-            m_data[i / 2] = static_cast<float>((buffer[i] & 0xFF) + (buffer[i + 1] & 0xFF) * 256);
+    }
+}
+
+// Read every stride-th voxel of every stride-th row of every stride-th slice inside the region. Only the part of a row
+// inside the region is read (the voxels within a row are too close together to skip on disk), all other rows are
+// skipped, so this reads about 1/stride^2 of the region.
+void Volume::loadVolumeRegion(std::ifstream& ifs, const VolumeRegion& region, int stride)
+{
+    const glm::ivec3 fileDim = m_dim;
+    const glm::ivec3 begin = glm::clamp(region.begin, glm::ivec3(0), fileDim);
+    const glm::ivec3 end = glm::clamp(region.end, begin, fileDim);
+    m_dim = (end - begin + stride - 1) / stride;
+    if (voxelCount(m_dim) == 0)
+        return;
+    // Data section is separated from header by two /f characters.
+    if (m_fileExtension == FileExtension::FLD) ifs.seekg(2, std::ios::cur);
+    const std::streamoff dataStart = ifs.tellg();
+
+    std::vector<char> row((size_t(m_dim.x - 1) * size_t(stride) + 1) * m_elementSize);
+    m_data.resize(voxelCount(m_dim));
+    for (int z = 0; z < m_dim.z; z++) {
+        for (int y = 0; y < m_dim.y; y++) {
+            ifs.seekg(dataStart + std::streamoff(voxelIndex(fileDim, begin.x, begin.y + y * stride, begin.z + z * stride) * m_elementSize));
+            ifs.read(row.data(), std::streamsize(row.size()));
+            std::fill(std::begin(row) + ifs.gcount(), std::end(row), char(0));
+            ifs.clear();
+            float* pRow = m_data.data() + voxelIndex(m_dim, 0, y, z);
+            for (int x = 0; x < m_dim.x; x++)
+                pRow[x] = readElement(row.data() + size_t(x) * size_t(stride) * m_elementSize, m_elementSize);
         }
     }
 }
 
 void Volume::loadVectorFieldData()
 {
-    const size_t voxelCount = static_cast<size_t>(m_dim.x * m_dim.y * m_elementSize);
+    const size_t voxelCount = size_t(m_dim.x) * size_t(m_dim.y) * m_elementSize;
     const size_t byteCount = voxelCount * sizeof(float);
 
     auto readDataFromFile = [&](const std::filesystem::path& filePath, size_t offset) {
@@ -275,8 +349,10 @@ void Volume::loadVectorFieldData()
         return true;
     };
 
+    // Slices whose file is missing or too short are left zero.
     if (m_dim.z == 1) {
         m_data.resize(voxelCount);
+        util::parallelFill<float>(m_data, 0.0f);
 
         std::filesystem::path filePath(m_fileName);
         filePath.replace_extension(".dat");
@@ -289,6 +365,7 @@ void Volume::loadVectorFieldData()
 
     } else {
         m_data.resize(voxelCount * m_dim.z);
+        util::parallelFill<float>(m_data, 0.0f);
 
         std::filesystem::path filePath(m_fileName);
         std::string fileNameWithoutExt = filePath.stem().string();
@@ -306,7 +383,7 @@ void Volume::loadVectorFieldData()
             // Combine the new file name with the ".dat" extension
             filePath.replace_filename(newFileName.str() + ".dat");
 
-            size_t index = i * voxelCount;
+            size_t index = size_t(i) * voxelCount;
             if (!readDataFromFile(filePath, index)) {
                 continue;
             }
@@ -321,7 +398,7 @@ void Volume::loadVectorFieldData()
 
 void Volume::flipXYVectorField()
 {
-    const size_t voxelCount = static_cast<size_t>(m_dim.x * m_dim.y * m_dim.z* m_elementSize);
+    const size_t voxelCount = volume::voxelCount(m_dim) * m_elementSize;
     for(size_t i = 0; i < voxelCount; i += m_elementSize)
     {
         float x = m_data[i];
@@ -447,6 +524,15 @@ Header readVectorFieldHeader(std::ifstream& file)
     return out;
 }
 
+// Convert a single byte or (little endian) uint16_t from a volume file.
+static float readElement(const char* pElement, size_t elementSize)
+{
+    if (elementSize == 1)
+        return static_cast<float>(pElement[0] & 0xFF);
+    else
+        return static_cast<float>((pElement[0] & 0xFF) + (pElement[1] & 0xFF) * 256);
+}
+
 static float computeMinimum(gsl::span<const float> data)
 {
     return float(*std::min_element(std::begin(data), std::end(data)));
@@ -457,9 +543,9 @@ static float computeMaximum(gsl::span<const float> data)
     return float(*std::max_element(std::begin(data), std::end(data)));
 }
 
-static std::vector<int> computeHistogram(gsl::span<const float> data)
+static std::vector<int64_t> computeHistogram(gsl::span<const float> data)
 {
-    std::vector<int> histogram(size_t(*std::max_element(std::begin(data), std::end(data)) + 1), 0);
+    std::vector<int64_t> histogram(size_t(*std::max_element(std::begin(data), std::end(data)) + 1), 0);
     for (const auto v : data)
         histogram[v]++;
     return histogram;
@@ -1,18 +1,18 @@
 #pragma once
+#include "util/aligned_allocator.h"
+#include "volume_sampler.h"
+#include <cstdint>
 #include <filesystem>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <gsl/span>
+#include <limits>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace volume {
 
-enum class InterpolationMode {
-    NearestNeighbour = 0,
-    Linear,
-    Cubic
-};
-
 enum class VolumeType {
     Volume = 0
 }; 
@@ -22,27 +22,49 @@ enum class FileExtension {
     DAT = 1
 }; 
 
-class Volume {
-public:
-    // DO NOT REMOVE
-    InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
+// Number of voxels of a volume and the linear index of a voxel (x fastest, then y, then z). The products are computed with
+// 64-bit integers: large volumes (e.g. 2048^3) have more voxels than fit in an int.
+inline size_t voxelCount(const glm::ivec3& dim)
+{
+    return size_t(dim.x) * size_t(dim.y) * size_t(dim.z);
+}
 
-public:
-    Volume(const std::filesystem::path& file);
-    Volume(std::vector<float> data, const glm::ivec3& dim);
+inline size_t voxelIndex(const glm::ivec3& dim, int x, int y, int z)
+{
+    return size_t(x) + size_t(dim.x) * (size_t(y) + size_t(dim.y) * size_t(z));
+}
+
+// Box of voxels [begin, end) to load from a volume file. It is clamped to the dimensions of the file.
+struct VolumeRegion {
+    glm::ivec3 begin { 0 };
+    glm::ivec3 end { std::numeric_limits<int>::max() };
+};
 
-    float minimum() const;
-    float maximum() const;
-    std::vector<int> histogram() const;
-    glm::ivec3 dims() const;
+class Volume : public VolumeSampler {
+public:
+    // Load a volume file. With a stride > 1 only every stride-th voxel in each direction is read, which gives a coarse
+    // preview of a large volume in a fraction of the time it takes to load it in full.
+    Volume(const std::filesystem::path& file, int stride = 1);
+    // Load only a region of interest of a volume file (optionally subsampled). Only the rows of voxels inside the region
+    // are read from disk.
+    Volume(const std::filesystem::path& file, const VolumeRegion& region, int stride = 1);
+    Volume(const std::vector<float>& data, const glm::ivec3& dim);
+
+    float minimum() const override;
+    float maximum() const override;
+    gsl::span<const int64_t> histogram() const;
+    glm::ivec3 dims() const override;
     std::string_view fileName() const;
 
-    float getSampleInterpolate(const glm::vec3& coord) const;
-    float getVoxel(int x, int y, int z) const;
-    std::vector<float> getData() const;
+    float getSampleInterpolate(const glm::vec3& coord) const override;
+    float getVoxel(int x, int y, int z) const override;
+    gsl::span<const float> getDataView() const;
 
     VolumeType getVolumeType() const;
 
+    // Read only the dimensions from the header of a volume file. Returns (0, 0, 0) for unsupported files.
+    static glm::ivec3 readDims(const std::filesystem::path& file);
+
 protected:
     float getSampleNearestNeighbourInterpolation(const glm::vec3& coord) const;
 
@@ -56,9 +78,10 @@ protected:
     static float weight(float x);
 
 private:
-    void loadFile(const std::filesystem::path& file);
+    void loadFile(const std::filesystem::path& file, const VolumeRegion& region, int stride);
 
     void loadVolumeData(std::ifstream& ifs);
+    void loadVolumeRegion(std::ifstream& ifs, const VolumeRegion& region, int stride);
     void loadVectorFieldData();
     void flipXYVectorField();
 
@@ -70,9 +93,10 @@ protected:
     size_t m_elementSize;
     glm::ivec3 m_dim;
 
-    std::vector<float> m_data; // technically the data is uint16_t but float is easier to work with
+    util::AlignedVector<float> m_data; // technically the data is uint16_t but float is easier to work with
 
     float m_minimum, m_maximum;
-    std::vector<int> m_histogram;
+    mutable std::once_flag m_histogramFlag;
+    mutable std::vector<int64_t> m_histogram;
 };
 }
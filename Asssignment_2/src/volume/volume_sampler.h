@@ -0,0 +1,29 @@
+#pragma once
+#include <glm/vec3.hpp>
+
+namespace volume {
+
+enum class InterpolationMode {
+    NearestNeighbour = 0,
+    Linear,
+    Cubic
+};
+
+// Common interface of the representations of a volume that the CPU renderer samples: the Volume itself and its compressed
+// (CompressedVolume) and quantized (QuantizedVolume) copies, in the same way as GradientProvider for the gradients.
+class VolumeSampler {
+public:
+    // DO NOT REMOVE
+    InterpolationMode interpolationMode { InterpolationMode::NearestNeighbour };
+
+public:
+    virtual ~VolumeSampler() = default;
+
+    virtual float getSampleInterpolate(const glm::vec3& coord) const = 0;
+    virtual float getVoxel(int x, int y, int z) const = 0;
+
+    virtual float minimum() const = 0;
+    virtual float maximum() const = 0;
+    virtual glm::ivec3 dims() const = 0;
+};
+}